@@ -43,6 +43,16 @@ echo 1 | sudo tee "$DIR/clear" >/dev/null
 empty="$(cat "$DIR/is_empty" | tr -d '\n')"
 [[ "$empty" == "1" ]] || { echo "ERROR: is_empty expected 1 got $empty"; exit 7; }
 
+# события вместо printk: stack_push видно в tracefs, если он смонтирован
+TRC=/sys/kernel/tracing
+if sudo test -d "$TRC/events/kernel_stack"; then
+  echo | sudo tee "$TRC/trace" >/dev/null
+  echo 1 | sudo tee "$TRC/events/kernel_stack/stack_push/enable" >/dev/null
+  echo 40 | sudo tee "$DIR/push" >/dev/null
+  echo 0 | sudo tee "$TRC/events/kernel_stack/stack_push/enable" >/dev/null
+  sudo grep -q "stack_push: value=40 size=1 ret=0 " "$TRC/trace" || { echo "ERROR: stack_push event missing"; exit 8; }
+fi
+
 sudo rmmod kernel_stack
 
 echo "OK"
@@ -0,0 +1,75 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kernel_stack
+
+#if !defined(STACK_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define STACK_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * События операций стека (events/kernel_stack/ в tracefs).
+ * ret — код STACK_*, size — размер после операции, ns — время вызова.
+ */
+DECLARE_EVENT_CLASS(stack_op,
+
+    TP_PROTO(int value, int size, int ret, u64 ns),
+
+    TP_ARGS(value, size, ret, ns),
+
+    TP_STRUCT__entry(
+        __field(int, value)
+        __field(int, size)
+        __field(int, ret)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->value = value;
+        __entry->size = size;
+        __entry->ret = ret;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("value=%d size=%d ret=%d ns=%llu",
+              __entry->value, __entry->size, __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(stack_op, stack_push,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+DEFINE_EVENT(stack_op, stack_pop,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+DEFINE_EVENT(stack_op, stack_peek,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+TRACE_EVENT(stack_clear,
+
+    TP_PROTO(int dropped, u64 ns),
+
+    TP_ARGS(dropped, ns),
+
+    TP_STRUCT__entry(
+        __field(int, dropped)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->dropped = dropped;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("dropped=%d ns=%llu", __entry->dropped, __entry->ns)
+);
+
+#endif
+
+/* заголовок лежит в lib/inc, он уже в путях поиска (см. Kbuild) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE stack_trace
+#include <trace/define_trace.h>
@@ -3,10 +3,22 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/timekeeping.h>
 
 #include "stack.h"
 #include "stack_ops.h"
 
+#define CREATE_TRACE_POINTS
+#include "stack_trace.h"
+
+/*
+ * Время берём только при включённом событии: выключенный tracepoint — один
+ * nop. Событие могли включить между start и trace_*, тогда t0 == 0 и
+ * задержка пишется нулём, а не временем с загрузки.
+ */
+#define stack_trace_start(ev) (trace_##ev##_enabled() ? ktime_get_ns() : 0)
+#define stack_trace_ns(t0)    ((t0) ? ktime_get_ns() - (t0) : 0)
+
 void stack_init(struct stack *s)
 {
     INIT_LIST_HEAD(&s->elements);
@@ -15,55 +27,68 @@ void stack_init(struct stack *s)
 
 int stack_push(struct stack *s, int value)
 {
+    u64 t0 = stack_trace_start(stack_push);
     struct stack_entry *e = kmalloc(sizeof(*e), GFP_KERNEL);
+    int ret = STACK_OK;
+
+    if (e) {
+        e->data = value;
+        list_add(&e->list, &s->elements); /* push на вершину: в голову */
+        s->size++;
+    } else {
+        ret = STACK_NOMEM;
+    }
 
-    if (!e)
-        return STACK_NOMEM;
-
-    e->data = value;
-    list_add(&e->list, &s->elements); /* push на вершину: в голову */
-    s->size++;
-
-    pr_info("push %d (size=%d)\n", value, s->size);
-    return STACK_OK;
+    trace_stack_push(value, s->size, ret, stack_trace_ns(t0));
+    return ret;
 }
 
 int stack_pop(struct stack *s, int *out)
 {
+    u64 t0 = stack_trace_start(stack_pop);
     struct stack_entry *e;
+    int value = 0, ret = STACK_OK;
 
     if (!out)
         return STACK_INVALID;
 
-    if (list_empty(&s->elements))
-        return STACK_EMPTY;
+    if (list_empty(&s->elements)) {
+        ret = STACK_EMPTY;
+        goto out;
+    }
 
     e = list_first_entry(&s->elements, struct stack_entry, list);
-    *out = e->data;
+    value = e->data;
+    *out = value;
 
     list_del(&e->list);
     kfree(e);
     s->size--;
 
-    pr_info("pop -> %d (size=%d)\n", *out, s->size);
-    return STACK_OK;
+out:
+    trace_stack_pop(value, s->size, ret, stack_trace_ns(t0));
+    return ret;
 }
 
 int stack_peek(struct stack *s, int *out)
 {
+    u64 t0 = stack_trace_start(stack_peek);
     struct stack_entry *e;
+    int value = 0, ret = STACK_OK;
 
     if (!out)
         return STACK_INVALID;
 
-    if (list_empty(&s->elements))
-        return STACK_EMPTY;
-
-    e = list_first_entry(&s->elements, struct stack_entry, list);
-    *out = e->data;
+    if (list_empty(&s->elements)) {
+        ret = STACK_EMPTY;
+    } else {
+        e = list_first_entry(&s->elements, struct stack_entry, list);
+        value = e->data;
+        *out = value;
+    }
 
-    pr_info("peek -> %d (size=%d)\n", *out, s->size);
-    return STACK_OK;
+    trace_stack_peek(value, s->size, ret, stack_trace_ns(t0));
+    return ret;
 }
 
 int stack_is_empty(struct stack *s)
@@ -78,7 +103,9 @@ int stack_size(struct stack *s)
 
 void stack_clear(struct stack *s)
 {
+    u64 t0 = stack_trace_start(stack_clear);
     struct stack_entry *e, *tmp;
+    int dropped = s->size;
 
     list_for_each_entry_safe(e, tmp, &s->elements, list) {
         list_del(&e->list);
@@ -86,5 +113,5 @@ void stack_clear(struct stack *s)
     }
     s->size = 0;
 
-    pr_info("clear (size=%d)\n", s->size);
+    trace_stack_clear(dropped, stack_trace_ns(t0));
 }
@@ -0,0 +1,232 @@
+// test/stack_kunit.c
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
+#include <linux/timekeeping.h>
+
+#include "stack.h"
+#include "stack_ops.h"
+
+/*
+ * Наборы KUnit для lib/stack_ops.c. Собираются в модуль только с
+ * make kunit и выполняются при insmod, отчёт — KTAP в dmesg.
+ */
+
+/* сам стек освобождает KUnit, элементы — stack_clear/stack_pop в тесте */
+static struct stack *stack_new(struct kunit *test)
+{
+    struct stack *s = kunit_kzalloc(test, sizeof(*s), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, s);
+    stack_init(s);
+    return s;
+}
+
+static void stack_test_lifo(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    int i, v;
+
+    for (i = 0; i < 10; i++)
+        KUNIT_EXPECT_EQ(test, stack_push(s, i), STACK_OK);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 10);
+
+    for (i = 9; i >= 0; i--) {
+        KUNIT_EXPECT_EQ(test, stack_pop(s, &v), STACK_OK);
+        KUNIT_EXPECT_EQ(test, v, i);
+        KUNIT_EXPECT_EQ(test, stack_size(s), i);
+    }
+    KUNIT_EXPECT_EQ(test, stack_is_empty(s), 1);
+}
+
+static void stack_test_empty(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    int v = 42;
+
+    KUNIT_EXPECT_EQ(test, stack_is_empty(s), 1);
+    KUNIT_EXPECT_EQ(test, stack_pop(s, &v), STACK_EMPTY);
+    KUNIT_EXPECT_EQ(test, stack_peek(s, &v), STACK_EMPTY);
+    /* при ошибке out не трогается */
+    KUNIT_EXPECT_EQ(test, v, 42);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 0);
+}
+
+static void stack_test_null_out(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+
+    KUNIT_EXPECT_EQ(test, stack_pop(s, NULL), STACK_INVALID);
+    KUNIT_EXPECT_EQ(test, stack_push(s, 1), STACK_OK);
+    KUNIT_EXPECT_EQ(test, stack_pop(s, NULL), STACK_INVALID);
+    KUNIT_EXPECT_EQ(test, stack_peek(s, NULL), STACK_INVALID);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 1);
+    stack_clear(s);
+}
+
+static void stack_test_peek_keeps(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    int v;
+
+    stack_push(s, 7);
+    stack_push(s, 8);
+    KUNIT_EXPECT_EQ(test, stack_peek(s, &v), STACK_OK);
+    KUNIT_EXPECT_EQ(test, v, 8);
+    KUNIT_EXPECT_EQ(test, stack_peek(s, &v), STACK_OK);
+    KUNIT_EXPECT_EQ(test, v, 8);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 2);
+    stack_clear(s);
+}
+
+static void stack_test_extremes(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    int v;
+
+    stack_push(s, INT_MIN);
+    stack_push(s, INT_MAX);
+    stack_push(s, 0);
+
+    stack_pop(s, &v);
+    KUNIT_EXPECT_EQ(test, v, 0);
+    stack_pop(s, &v);
+    KUNIT_EXPECT_EQ(test, v, INT_MAX);
+    stack_pop(s, &v);
+    KUNIT_EXPECT_EQ(test, v, INT_MIN);
+}
+
+static void stack_test_clear_reuse(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    int i, v;
+
+    for (i = 0; i < 1000; i++)
+        stack_push(s, i);
+    stack_clear(s);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 0);
+    KUNIT_EXPECT_EQ(test, stack_is_empty(s), 1);
+
+    /* пустой clear безопасен, после clear стек работает как новый */
+    stack_clear(s);
+    KUNIT_EXPECT_EQ(test, stack_push(s, 5), STACK_OK);
+    KUNIT_EXPECT_EQ(test, stack_pop(s, &v), STACK_OK);
+    KUNIT_EXPECT_EQ(test, v, 5);
+}
+
+/* замеры: ns/op в одном потоке и под конкуренцией за мьютекс, как в sysfs.c */
+#define STACK_BENCH_OPS     200000
+#define STACK_BENCH_THREADS 8
+
+static void stack_bench_single(struct kunit *test)
+{
+    struct stack *s = stack_new(test);
+    u64 t0, push_ns, pop_ns;
+    int i, v;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < STACK_BENCH_OPS; i++)
+        stack_push(s, i);
+    push_ns = ktime_get_ns() - t0;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < STACK_BENCH_OPS; i++)
+        stack_pop(s, &v);
+    pop_ns = ktime_get_ns() - t0;
+
+    KUNIT_EXPECT_EQ(test, stack_size(s), 0);
+    kunit_info(test, "push %llu ns/op, pop %llu ns/op\n",
+               div_u64(push_ns, STACK_BENCH_OPS),
+               div_u64(pop_ns, STACK_BENCH_OPS));
+}
+
+struct stack_bench_ctx {
+    struct stack *s;
+    struct mutex *lock;
+    struct completion *go;
+    struct completion done;
+    unsigned int ops;
+    unsigned int fails;
+};
+
+static int stack_bench_fn(void *arg)
+{
+    struct stack_bench_ctx *c = arg;
+    unsigned int i;
+    int v;
+
+    wait_for_completion(c->go);
+    for (i = 0; i < c->ops; i++) {
+        mutex_lock(c->lock);
+        if (stack_push(c->s, i) != STACK_OK || stack_pop(c->s, &v) != STACK_OK)
+            c->fails++;
+        mutex_unlock(c->lock);
+    }
+    complete(&c->done);
+    return 0;
+}
+
+static void stack_bench_contended(struct kunit *test)
+{
+    unsigned int nr = clamp_t(unsigned int, num_online_cpus(), 2,
+                              STACK_BENCH_THREADS);
+    unsigned int per = STACK_BENCH_OPS / nr, i, started, fails = 0;
+    struct stack_bench_ctx *ctx;
+    struct stack *s = stack_new(test);
+    DECLARE_COMPLETION_ONSTACK(go);
+    struct mutex lock;
+    u64 t0, ns;
+
+    ctx = kunit_kcalloc(test, nr, sizeof(*ctx), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+    mutex_init(&lock);
+
+    for (started = 0; started < nr; started++) {
+        struct stack_bench_ctx *c = &ctx[started];
+
+        c->s = s;
+        c->lock = &lock;
+        c->go = &go;
+        c->ops = per;
+        init_completion(&c->done);
+        if (IS_ERR(kthread_run(stack_bench_fn, c, "stack_bench/%u", started)))
+            break;
+    }
+
+    /* go и lock на стеке: запущенные потоки дожидаемся при любом исходе */
+    t0 = ktime_get_ns();
+    complete_all(&go);
+    for (i = 0; i < started; i++) {
+        wait_for_completion(&ctx[i].done);
+        fails += ctx[i].fails;
+    }
+    ns = ktime_get_ns() - t0;
+
+    KUNIT_ASSERT_EQ(test, started, nr);
+    KUNIT_EXPECT_EQ(test, fails, 0u);
+    KUNIT_EXPECT_EQ(test, stack_size(s), 0);
+    kunit_info(test, "%u threads: %llu ns per push+pop pair (wall / total)\n",
+               nr, div_u64(ns, per * nr));
+}
+
+static struct kunit_case stack_test_cases[] = {
+    KUNIT_CASE(stack_test_lifo),
+    KUNIT_CASE(stack_test_empty),
+    KUNIT_CASE(stack_test_null_out),
+    KUNIT_CASE(stack_test_peek_keeps),
+    KUNIT_CASE(stack_test_extremes),
+    KUNIT_CASE(stack_test_clear_reuse),
+    KUNIT_CASE(stack_bench_single),
+    KUNIT_CASE(stack_bench_contended),
+    {}
+};
+
+static struct kunit_suite stack_test_suite = {
+    .name = "kernel_stack",
+    .test_cases = stack_test_cases,
+};
+
+kunit_test_suite(stack_test_suite);
@@ -13,23 +13,28 @@ trap cleanup EXIT
 sudo rmmod "$MOD" >/dev/null 2>&1 || true
 sudo dmesg -C >/dev/null 2>&1 || true
 
-sudo insmod "$KO"
+# numa=0: one arena regardless of host topology, so arena counts below are exact
+sudo insmod "$KO" max_pool_size=$((20 * 1024 * 1024)) numa=0
 
-for f in alloc free stats bitmap_info; do
+for f in alloc free grow stats bitmap_info; do
   [[ -e "$DIR/$f" ]] || { echo "ERROR: missing $DIR/$f"; exit 2; }
 done
 
-# 1) stats initial
+[[ -c /dev/kernel_alloc ]] || { echo "ERROR: missing /dev/kernel_alloc"; exit 2; }
+
+# 1) stats initial; free blocks get zeroed in the background
 cat "$DIR/stats" >/dev/null
+grep -q "^Zeroing: prezero=on " "$DIR/stats" || { echo "ERROR: prezero not reported"; exit 2; }
+
+# адрес последней выдачи читается из того же параметра, лог не нужен
+last_alloc() { sudo cat "$DIR/alloc"; }
 
 # 2) allocate 8KiB and 16KiB
 echo 8192  | sudo tee "$DIR/alloc" >/dev/null
+ADDR1="$(last_alloc)"
+[[ "$ADDR1" != "0x0" ]] || { echo "ERROR: no address for the first alloc"; exit 3; }
 echo 16384 | sudo tee "$DIR/alloc" >/dev/null
 
-# взять адрес первого выделения из dmesg
-ADDR1="$(sudo dmesg | grep -F "${MOD}: allocated 8192 bytes" | tail -n 1 | sed -n 's/.* at \(0x[0-9a-fA-F]\+\)$/\1/p')"
-[[ -n "$ADDR1" ]] || { echo "ERROR: cannot parse first alloc addr"; exit 3; }
-
 # 3) stats after alloc
 cat "$DIR/stats" >/dev/null
 
@@ -39,8 +44,108 @@ echo "$ADDR1" | sudo tee "$DIR/free" >/dev/null
 # 5) stats after free
 cat "$DIR/stats" >/dev/null
 
-# 6) bitmap info exists
+# 6) small object from a size class: shares a block, freed by unaligned address
+echo 64 | sudo tee "$DIR/alloc" >/dev/null
+ADDR2="$(last_alloc)"
+[[ "$ADDR2" != "0x0" ]] || { echo "ERROR: no address for the small alloc"; exit 4; }
+grep -q "objects=1 " "$DIR/stats" || { echo "ERROR: small object not accounted"; exit 5; }
+echo "$ADDR2" | sudo tee "$DIR/free" >/dev/null
+
+# 6b) aligned allocation: 64 KiB alignment, address must be a multiple of it
+echo "8192 65536" | sudo tee "$DIR/alloc" >/dev/null
+ADDR4="$(last_alloc)"
+(( ADDR4 % 65536 == 0 )) || { echo "ERROR: $ADDR4 not 64 KiB aligned"; exit 5; }
+echo "$ADDR4" | sudo tee "$DIR/free" >/dev/null
+if echo "8192 3000" | sudo tee "$DIR/alloc" >/dev/null 2>&1; then
+  echo "ERROR: non power-of-two alignment accepted"; exit 5
+fi
+
+# 6c) realloc: shrink and grow back in place, address unchanged
+echo 16384 | sudo tee "$DIR/alloc" >/dev/null
+ADDR5="$(last_alloc)"
+echo "$ADDR5 4096" | sudo tee "$DIR/realloc" >/dev/null
+echo "$ADDR5 12288" | sudo tee "$DIR/realloc" >/dev/null
+[[ "$(sudo cat "$DIR/realloc")" == "$ADDR5" ]] || { echo "ERROR: realloc moved the extent"; exit 5; }
+grep -q "^Realloc: in_place=2 moved=0$" "$DIR/stats" || { echo "ERROR: realloc was not in place"; exit 5; }
+echo "$ADDR5" | sudo tee "$DIR/free" >/dev/null
+
+# 6d) movable extents: free the first of three handles, compaction slides the rest down
+echo 8192 | sudo tee "$DIR/halloc" >/dev/null
+H1="$(sudo cat "$DIR/halloc")"
+for i in 2 3; do echo 8192 | sudo tee "$DIR/halloc" >/dev/null; done
+echo "$H1" | sudo tee "$DIR/hfree" >/dev/null
+echo 0 | sudo tee "$DIR/compact" >/dev/null
+grep -q "^Compact: passes=1 moved=[1-9]" "$DIR/stats" || { echo "ERROR: compaction moved nothing"; exit 5; }
+
+# 7) grow: second arena up to max_pool_size, third one must be refused
+echo 0 | sudo tee "$DIR/grow" >/dev/null
+grep -q "^Arenas: 2 " "$DIR/stats" || { echo "ERROR: grow did not add an arena"; exit 6; }
+if echo 0 | sudo tee "$DIR/grow" >/dev/null 2>&1; then
+  echo "ERROR: grow past max_pool_size succeeded"; exit 7
+fi
+
+# 8) bitmap info exists
 cat "$DIR/bitmap_info" >/dev/null
 
+# 8b) debugfs map: extents of every arena, binary form is header + 32-byte records
+DBG=/sys/kernel/debug/$MOD
+if sudo test -d "$DBG"; then
+  sudo grep -q "^ *1 .* free$" "$DBG/map" || { echo "ERROR: map lacks the grown arena"; exit 8; }
+  sudo grep -q " handle [0-9]\+$" "$DBG/map" || { echo "ERROR: map lacks handle extents"; exit 8; }
+  RECS=$(( $(sudo grep -c . "$DBG/map") - 1 ))
+  [ "$(sudo cat "$DBG/map.bin" | wc -c)" -eq $((16 + 32 * RECS)) ] || { echo "ERROR: map.bin size mismatch"; exit 8; }
+
+  # histograms: off by default, a fresh alloc lands in the size histogram once enabled
+  echo 1 | sudo tee "$DBG/hist_enable" >/dev/null
+  echo 8192 | sudo tee "$DIR/alloc" >/dev/null
+  sudo grep -A1 "^size_bytes:" "$DBG/hist" | grep -q " 8192 " || { echo "ERROR: size histogram empty"; exit 8; }
+  echo 0 | sudo tee "$DBG/hist_enable" >/dev/null
+fi
+
+# 8c) tracepoints: kalloc_alloc carries the same address the alloc parameter reports
+TRC=/sys/kernel/tracing
+if sudo test -d "$TRC/events/$MOD"; then
+  echo | sudo tee "$TRC/trace" >/dev/null
+  echo 1 | sudo tee "$TRC/events/$MOD/kalloc_alloc/enable" >/dev/null
+  echo 4096 | sudo tee "$DIR/alloc" >/dev/null
+  echo 0 | sudo tee "$TRC/events/$MOD/kalloc_alloc/enable" >/dev/null
+  sudo grep -q "kalloc_alloc: addr=$(last_alloc) bytes=4096 " "$TRC/trace" || { echo "ERROR: kalloc_alloc event missing"; exit 8; }
+fi
+
+# 9) benchmarks live in debugfs: a run there does not hold the module's param lock
+if sudo test -d "$DBG"; then
+  # replay: one trace through both policies
+  echo "20000 1024" | sudo tee "$DBG/replay" >/dev/null
+  sudo grep -q "^best_fit " "$DBG/replay" || { echo "ERROR: replay report missing best_fit"; exit 8; }
+
+  # 9b) stress: two pinned kthreads for a short run, bitmap must match the live allocations
+  echo "2 200 64 16384" | sudo tee "$DBG/stress" >/dev/null
+  sudo grep -q "^verify: ok " "$DBG/stress" || { echo "ERROR: stress verification failed"; exit 8; }
+fi
+
+sudo rmmod "$MOD"
+
+# 10) best_fit policy: the extent tree tracks free space
+sudo insmod "$KO" policy=best_fit
+grep -q "policy=best_fit free_extents=[0-9]*$" "$DIR/stats" || { echo "ERROR: best_fit not active"; exit 9; }
+grep -q "^Node [0-9]*: arenas=1 " "$DIR/stats" || { echo "ERROR: per-node arenas missing"; exit 9; }
+echo 8192 | sudo tee "$DIR/alloc" >/dev/null
+ADDR3="$(last_alloc)"
+echo "$ADDR3" | sudo tee "$DIR/free" >/dev/null
+grep -q "free_extents=$(awk '/^Node/ { n++ } END { print n }' "$DIR/stats")$" "$DIR/stats" || { echo "ERROR: extents not merged on free"; exit 10; }
+if sudo insmod "$KO" policy=worst_fit 2>/dev/null; then
+  echo "ERROR: unknown policy accepted"; exit 11
+fi
+
+sudo rmmod "$MOD"
+
+# 11) contig backing: a 4 MiB arena fits one high-order allocation, or falls back
+sudo insmod "$KO" pool_size=$((4 * 1024 * 1024)) backing=contig
+grep -q "^Backing: contig " "$DIR/stats" || { echo "ERROR: backing not reported"; exit 12; }
+if sudo test -d "$DBG"; then
+  echo "8192 100000" | sudo tee "$DBG/access_bench" >/dev/null
+  sudo grep -q "^contig " "$DBG/access_bench" || { echo "ERROR: access_bench report missing"; exit 13; }
+fi
+
 sudo rmmod "$MOD"
 echo "OK"
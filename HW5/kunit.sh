@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+# KUnit-наборы модуля (собран через make kunit): выполняются при insmod,
+# KTAP читается из dmesg. Если рядом исходники ядра с tools/testing/kunit,
+# отчёт разбирает kunit.py parse — так же, как после kunit.py run под
+# UML/QEMU, где тот же модуль грузится в гостевой системе.
+set -euo pipefail
+
+KO=./kernel_alloc.ko
+MOD=kernel_alloc
+KDIR="${KDIR:-/lib/modules/$(uname -r)/build}"
+KUNIT_PY="$KDIR/tools/testing/kunit/kunit.py"
+
+cleanup() { sudo rmmod "$MOD" >/dev/null 2>&1 || true; }
+trap cleanup EXIT
+
+[[ -f "$KO" ]] || { echo "ERROR: $KO not found. Run make kunit." >&2; exit 1; }
+readelf -S "$KO" | grep -q kunit_test_suites || { echo "ERROR: $KO built without KUnit suites (make kunit)" >&2; exit 1; }
+
+sudo rmmod "$MOD" >/dev/null 2>&1 || true
+sudo dmesg -C
+# пул по умолчанию; наборы выполняются после init модуля
+sudo insmod "$KO"
+sudo rmmod "$MOD"
+
+LOG="$(sudo dmesg)"
+if [[ -x "$KUNIT_PY" ]]; then
+  echo "$LOG" | "$KUNIT_PY" parse
+else
+  # без kunit.py: строки KTAP (в том числе замеры "# ... ns/op") и итог по "not ok"
+  echo "$LOG" | sed -n 's/^\[[^]]*\] *//p' | grep -E "^ *(KTAP|# |ok |not ok |1\.\.)"
+  ! echo "$LOG" | grep -q "not ok "
+fi
@@ -0,0 +1,121 @@
+// src/access_bench.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/timekeeping.h>
+
+#include "allocator.h"
+#include "arena.h"
+
+/* между порциями отдаём CPU; время cond_resched в замер не входит */
+#define BENCH_CHUNK 65536
+
+struct bench_result {
+    u64 rand_ns;                /* на случайные обращения */
+    u64 seq_ns;                 /* на последовательный проход */
+    u64 sum;                    /* чтобы проход не выбросил компилятор */
+};
+
+/*
+ * Случайные обращения по одному слову на страницу: каждое почти наверняка
+ * промахивается мимо TLB, если арена отображена 4 KiB страницами.
+ */
+static void bench_random(u64 *pool, size_t words, unsigned int accesses,
+                         struct bench_result *r)
+{
+    size_t stride = PAGE_SIZE / sizeof(u64);
+    size_t pages = words / stride;
+    u32 x = 0x2545f491;
+    unsigned int done = 0;
+
+    while (done < accesses) {
+        unsigned int n = min_t(unsigned int, BENCH_CHUNK, accesses - done);
+        u64 t0 = ktime_get_ns();
+
+        for (unsigned int i = 0; i < n; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            pool[(x % pages) * stride + (x >> 24) % stride]++;
+        }
+
+        r->rand_ns += ktime_get_ns() - t0;
+        done += n;
+        cond_resched();
+    }
+}
+
+static void bench_seq(u64 *pool, size_t words, struct bench_result *r)
+{
+    size_t i = 0;
+
+    while (i < words) {
+        size_t end = min(words, i + BENCH_CHUNK);
+        u64 t0 = ktime_get_ns();
+
+        for (; i < end; i++)
+            r->sum += READ_ONCE(pool[i]);
+
+        r->seq_ns += ktime_get_ns() - t0;
+        cond_resched();
+    }
+}
+
+int allocator_access_bench(size_t bytes, unsigned int accesses,
+                           char *out, size_t out_sz)
+{
+    static const enum alloc_backing backings[] = {
+        ALLOC_BACKING_VMALLOC, ALLOC_BACKING_HUGE, ALLOC_BACKING_CONTIG,
+    };
+    size_t pos = 0;
+    unsigned int i;
+
+    bytes = round_up(bytes, PAGE_SIZE);
+    if (bytes < 16 * PAGE_SIZE || !accesses)
+        return ALLOC_INVALID;
+
+    pos += scnprintf(out + pos, out_sz - pos,
+                     "bench: pool=%zu KB accesses=%u\n"
+                     "requested  actual    rand_ns/op  seq_MB/s\n",
+                     bytes / 1024, accesses);
+
+    for (i = 0; i < ARRAY_SIZE(backings); i++) {
+        struct memory_allocator *a;
+        struct bench_result r = { 0 };
+        size_t words;
+
+        /* временная арена вне пула: id за пределами ALLOC_MAX_ARENAS */
+        a = arena_create(ALLOC_MAX_ARENAS, bytes, PAGE_SIZE,
+                         ALLOC_POLICY_FIRST_FIT, backings[i], NUMA_NO_NODE);
+        if (!a)
+            return ALLOC_NOMEM;
+
+        words = a->pool_bytes / sizeof(u64);
+
+        /* пул приходит необнулённым; заодно страницы уже отображены */
+        memset(a->memory_pool, 0, a->pool_bytes);
+
+        /* первый проход прогревает кэши, в отчёт идёт второй */
+        bench_seq(a->memory_pool, words, &r);
+        r.seq_ns = 0;
+        bench_seq(a->memory_pool, words, &r);
+        bench_random(a->memory_pool, words, accesses, &r);
+
+        pos += scnprintf(out + pos, out_sz - pos,
+                         "%-10s %-9s %10llu %9llu\n",
+                         allocator_backing_name(backings[i]),
+                         allocator_backing_name(a->backing),
+                         div64_u64(r.rand_ns, accesses),
+                         r.seq_ns ? div64_u64((u64)a->pool_bytes * 1000,
+                                              r.seq_ns) : 0);
+
+        /* сумма нигде не нужна, но без неё проход можно было бы выбросить */
+        OPTIMIZER_HIDE_VAR(r.sum);
+        arena_destroy(a);
+    }
+
+    return pos;
+}
@@ -0,0 +1,148 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kernel_alloc
+
+#if !defined(KERNEL_ALLOC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define KERNEL_ALLOC_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * События аллокатора (events/kernel_alloc/ в tracefs). Адрес пишем числом,
+ * как его принимает параметр free: %p хешируется и для сверки не годится.
+ */
+TRACE_EVENT(kalloc_alloc,
+
+    TP_PROTO(const void *ptr, size_t bytes, size_t align, bool owned, u64 ns),
+
+    TP_ARGS(ptr, bytes, align, owned, ns),
+
+    TP_STRUCT__entry(
+        __field(u64, addr)
+        __field(size_t, bytes)
+        __field(size_t, align)
+        __field(bool, owned)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->addr = (u64)(uintptr_t)ptr;
+        __entry->bytes = bytes;
+        __entry->align = align;
+        __entry->owned = owned;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("addr=0x%llx bytes=%zu align=%zu dev=%d ns=%llu",
+              __entry->addr, __entry->bytes, __entry->align,
+              __entry->owned, __entry->ns)
+);
+
+TRACE_EVENT(kalloc_free,
+
+    TP_PROTO(const void *ptr, int ret, u64 ns),
+
+    TP_ARGS(ptr, ret, ns),
+
+    TP_STRUCT__entry(
+        __field(u64, addr)
+        __field(int, ret)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->addr = (u64)(uintptr_t)ptr;
+        __entry->ret = ret;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("addr=0x%llx ret=%d ns=%llu",
+              __entry->addr, __entry->ret, __entry->ns)
+);
+
+TRACE_EVENT(kalloc_realloc,
+
+    TP_PROTO(const void *old, const void *new, size_t bytes, bool in_place),
+
+    TP_ARGS(old, new, bytes, in_place),
+
+    TP_STRUCT__entry(
+        __field(u64, old_addr)
+        __field(u64, new_addr)
+        __field(size_t, bytes)
+        __field(bool, in_place)
+    ),
+
+    TP_fast_assign(
+        __entry->old_addr = (u64)(uintptr_t)old;
+        __entry->new_addr = (u64)(uintptr_t)new;
+        __entry->bytes = bytes;
+        __entry->in_place = in_place;
+    ),
+
+    TP_printk("old=0x%llx new=0x%llx bytes=%zu %s",
+              __entry->old_addr, __entry->new_addr, __entry->bytes,
+              __entry->in_place ? "in_place" : "moved")
+);
+
+DECLARE_EVENT_CLASS(kalloc_handle,
+
+    TP_PROTO(u32 handle, size_t blocks),
+
+    TP_ARGS(handle, blocks),
+
+    TP_STRUCT__entry(
+        __field(u32, handle)
+        __field(size_t, blocks)
+    ),
+
+    TP_fast_assign(
+        __entry->handle = handle;
+        __entry->blocks = blocks;
+    ),
+
+    TP_printk("handle=%u blocks=%zu", __entry->handle, __entry->blocks)
+);
+
+DEFINE_EVENT(kalloc_handle, kalloc_handle_alloc,
+    TP_PROTO(u32 handle, size_t blocks),
+    TP_ARGS(handle, blocks));
+
+DEFINE_EVENT(kalloc_handle, kalloc_handle_free,
+    TP_PROTO(u32 handle, size_t blocks),
+    TP_ARGS(handle, blocks));
+
+/* проход уплотнения: ручной (параметр compact) или фоновый по порогу */
+TRACE_EVENT(kalloc_compact,
+
+    TP_PROTO(size_t extents, size_t bytes, size_t frag_before,
+             size_t frag_after),
+
+    TP_ARGS(extents, bytes, frag_before, frag_after),
+
+    TP_STRUCT__entry(
+        __field(size_t, extents)
+        __field(size_t, bytes)
+        __field(size_t, frag_before)
+        __field(size_t, frag_after)
+    ),
+
+    TP_fast_assign(
+        __entry->extents = extents;
+        __entry->bytes = bytes;
+        __entry->frag_before = frag_before;
+        __entry->frag_after = frag_after;
+    ),
+
+    TP_printk("moved=%zu bytes=%zu frag=%zu%%->%zu%%",
+              __entry->extents, __entry->bytes,
+              __entry->frag_before, __entry->frag_after)
+);
+
+#endif
+
+/* заголовок лежит в src, он уже в путях поиска (см. Kbuild) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE alloc_trace
+#include <trace/define_trace.h>
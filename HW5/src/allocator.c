@@ -2,290 +2,1943 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/kernel.h>
+#include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
 #include <linux/list.h>
+#include <linux/hashtable.h>
+#include <linux/xarray.h>
+#include <linux/bitmap.h>
+#include <linux/workqueue.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/log2.h>
 #include <linux/string.h>
+#include <linux/timekeeping.h>
+#include <linux/jiffies.h>
+#include <linux/rcupdate.h>
 
 #include "allocator.h"
+#include "arena.h"
+#include "bitmap.h"
+#include "hist.h"
+#include "size_class.h"
 
-#define POOL_SIZE_BYTES (10u * 1024u * 1024u)  /* 10 MiB */   /* :contentReference[oaicite:6]{index=6} */
-#define BLOCK_SIZE      4096u                  /* 4 KiB */    /* :contentReference[oaicite:7]{index=7} */
-#define TOTAL_BLOCKS    (POOL_SIZE_BYTES / BLOCK_SIZE)        /* 2560 */ /* :contentReference[oaicite:8]{index=8} */
-#define BITMAP_BYTES    ((TOTAL_BLOCKS + 7) / 8)              /* 320 */  /* :contentReference[oaicite:9]{index=9} */
+#define CREATE_TRACE_POINTS
+#include "alloc_trace.h"
 
-struct memory_allocator {
-    unsigned char *bitmap;
-    void *memory_pool;
-    size_t total_blocks;
+/*
+ * Набор арен. Арены только добавляются (до allocator_cleanup), поэтому
+ * обход идёт без общего лока: nr_arenas публикуется после заполнения слота.
+ */
+static struct {
+    struct memory_allocator *arenas[ALLOC_MAX_ARENAS];
+    unsigned int nr_arenas;
     size_t block_size;
-    spinlock_t lock;
-};
+    size_t arena_bytes;         /* размер арены по умолчанию */
+    enum alloc_policy policy;
+    enum alloc_backing backing;
+    bool prezero;
+    bool numa;
+    struct work_struct zero_work;
+    atomic_long_t realloc_in_place;
+    atomic_long_t realloc_moved;
 
-struct alloc_node {
-    struct list_head list;
-    void *ptr;
-    size_t start_block;
-    size_t num_blocks;
-};
+    /* перемещаемые экстенты: handle -> alloc_node */
+    struct xarray handles;
+    struct mutex compact_lock;  /* один проход уплотнения за раз */
+    struct work_struct compact_work;
+    unsigned int compact_threshold;
+    unsigned long compact_retry; /* jiffies: раньше фон не будить, см. pool_compact_work */
+    spinlock_t compact_stats_lock; /* итоги публикуются в конце прохода */
+    struct compact_stats compact;
+    size_t max_pool_bytes;      /* потолок суммарного пула */
+    size_t pool_bytes;          /* текущий суммарный пул */
+    struct mutex grow_lock;
+    struct xarray index;        /* номер страницы -> арена */
+} g_pool;
 
-static struct memory_allocator g_alloc;
-static LIST_HEAD(g_alloc_list);
+static inline unsigned int nr_arenas(void)
+{
+    return smp_load_acquire(&g_pool.nr_arenas);
+}
 
-/* bitmap helpers (из bitmap.c) */
-int bitmap_first_fit(const unsigned char *bm, size_t total_blocks,
-                     size_t need, size_t *start_out);
-size_t bitmap_count_free(const unsigned char *bm, size_t total_blocks);
-size_t bitmap_largest_free_run(const unsigned char *bm, size_t total_blocks);
-int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
-                     char *out, size_t out_sz);
+static inline int pool_local_node(void)
+{
+    return g_pool.numa ? numa_node_id() : NUMA_NO_NODE;
+}
 
-/* локальные бит-операции для пометки диапазонов */
-static inline int bm_test(const unsigned char *bm, size_t idx)
+static inline bool arena_is_local(struct memory_allocator *a, int nid)
 {
-    size_t byte = idx / 8, bit = idx % 8;
-    return (bm[byte] >> bit) & 1;
+    return a->nid == nid || a->nid == NUMA_NO_NODE;
 }
-static inline void bm_set(unsigned char *bm, size_t idx)
+
+/*
+ * Обход первых n арен в порядке предпочтения: сначала узла nid, затем
+ * остальных. *pos — состояние обхода, начинать с 0.
+ */
+static struct memory_allocator *pool_next_arena(int nid, unsigned int n,
+                                                unsigned int *pos)
 {
-    size_t byte = idx / 8, bit = idx % 8;
-    bm[byte] |= (unsigned char)(1u << bit);
+    while (*pos < 2 * n) {
+        struct memory_allocator *a = g_pool.arenas[*pos % n];
+        bool local_pass = *pos < n;
+
+        (*pos)++;
+        if (arena_is_local(a, nid) == local_pass)
+            return a;
+    }
+
+    return NULL;
 }
-static inline void bm_clear(unsigned char *bm, size_t idx)
+
+static void arena_count_alloc(struct memory_allocator *a, int nid)
 {
-    size_t byte = idx / 8, bit = idx % 8;
-    bm[byte] &= (unsigned char)~(1u << bit);
+    if (arena_is_local(a, nid))
+        atomic_long_inc(&a->local_allocs);
+    else
+        atomic_long_inc(&a->remote_allocs);
 }
 
 static size_t bytes_to_blocks(size_t bytes)
 {
-    size_t blocks = bytes / BLOCK_SIZE;
-    if (bytes % BLOCK_SIZE)
+    size_t blocks = bytes / g_pool.block_size;
+    if (bytes % g_pool.block_size)
         blocks++;
     return blocks;
 }
 
-static int ptr_to_block(void *ptr, size_t *block_out)
+/*
+ * Арена и номер блока, в который попадает ptr. Поиск арены идёт по xarray
+ * с ключом "номер страницы", поэтому не зависит от числа арен.
+ * Невыровненные адреса допустимы: объекты размерных классов лежат внутри
+ * блока, выравнивание для обычных аллокаций проверяет allocator_free.
+ */
+static int ptr_to_block(void *ptr, struct memory_allocator **arena_out,
+                        size_t *block_out)
 {
-    uintptr_t base = (uintptr_t)g_alloc.memory_pool;
+    struct memory_allocator *a;
     uintptr_t p = (uintptr_t)ptr;
+    uintptr_t base;
 
-    if (!g_alloc.memory_pool || !block_out)
-        return ALLOC_INVALID;
-
-    if (p < base || p >= base + POOL_SIZE_BYTES)
+    if (!arena_out || !block_out)
         return ALLOC_INVALID;
 
-    if ((p - base) % BLOCK_SIZE != 0)
+    a = xa_load(&g_pool.index, p >> PAGE_SHIFT);
+    if (!a)
         return ALLOC_INVALID;
 
-    *block_out = (p - base) / BLOCK_SIZE;
-    if (*block_out >= TOTAL_BLOCKS)
+    base = (uintptr_t)a->memory_pool;
+    if (p < base || p >= base + a->pool_bytes)
         return ALLOC_INVALID;
 
+    *arena_out = a;
+    *block_out = (p - base) / a->block_size;
     return ALLOC_OK;
 }
 
-int allocator_init(void)
+/* пометить блоки [start, start + len) занятыми/свободными (под локом арены) */
+static void arena_mark(struct memory_allocator *a, size_t start, size_t len,
+                       bool used)
 {
-    g_alloc.total_blocks = TOTAL_BLOCKS;
-    g_alloc.block_size = BLOCK_SIZE;
-    spin_lock_init(&g_alloc.lock);
+    size_t i, seg;
 
-    g_alloc.bitmap = kzalloc(BITMAP_BYTES, GFP_KERNEL);
-    if (!g_alloc.bitmap)
-        return ALLOC_NOMEM;
+    for (i = start; i < start + len; i++) {
+        if (used)
+            bm_set(a->bitmap, i);
+        else
+            bm_clear(a->bitmap, i);
+    }
 
-    /* 10 MiB лучше через vzalloc/vmalloc (kmalloc может не дать большой contiguous) */
-    g_alloc.memory_pool = vzalloc(POOL_SIZE_BYTES);
-    if (!g_alloc.memory_pool) {
-        kfree(g_alloc.bitmap);
-        g_alloc.bitmap = NULL;
-        return ALLOC_NOMEM;
+    if (used)
+        a->free_blocks -= len;
+    else
+        a->free_blocks += len;
+
+    /* блок, который фон обнулял по частям, занят: обнулит тот, кто занял */
+    if (used && a->zeroing >= start && a->zeroing < start + len)
+        a->zeroing = SIZE_MAX;
+
+    if (a->free_tree) {
+        if (used)
+            extent_tree_reserve(a->free_tree, start, len);
+        else
+            extent_tree_release(a->free_tree, start, len);
     }
 
-    pr_info("init: pool=%u bytes, block=%u, blocks=%zu, bitmap=%u bytes\n",
-            POOL_SIZE_BYTES, BLOCK_SIZE, g_alloc.total_blocks, BITMAP_BYTES);
-    return ALLOC_OK;
+    for (seg = start / BITMAP_SEG_BLOCKS;
+         seg <= (start + len - 1) / BITMAP_SEG_BLOCKS; seg++)
+        bm_set(a->seg_dirty, seg);
+    a->runs_dirty = true;
 }
 
-void allocator_cleanup(void)
+/* самый длинный свободный отрезок арены (под локом арены) */
+size_t arena_largest_free(struct memory_allocator *a)
 {
-    struct alloc_node *n, *tmp;
-    unsigned long flags;
+    size_t seg, nr = bitmap_nr_segs(a->total_blocks);
 
-    /* освободим все активные аллокации */
-    spin_lock_irqsave(&g_alloc.lock, flags);
-    list_for_each_entry_safe(n, tmp, &g_alloc_list, list) {
-        list_del(&n->list);
-        /* сбрасываем биты */
-        for (size_t i = 0; i < n->num_blocks; i++)
-            bm_clear(g_alloc.bitmap, n->start_block + i);
-        spin_unlock_irqrestore(&g_alloc.lock, flags);
+    if (!a->runs_dirty)
+        return a->largest_free;
 
-        kfree(n);
+    for (seg = 0; seg < nr; seg++) {
+        if (!bm_test(a->seg_dirty, seg))
+            continue;
+        bitmap_seg_compute(a->bitmap, a->total_blocks, seg, &a->segs[seg]);
+        bm_clear(a->seg_dirty, seg);
+    }
+
+    a->largest_free = bitmap_seg_longest(a->segs, a->total_blocks);
+    a->runs_dirty = false;
+    return a->largest_free;
+}
+
+/*
+ * Фоновое обнуление идёт под локом арены, но порциями: не больше
+ * PREZERO_CHUNK байт memset и PREZERO_SCAN блоков за один захват. Блок
+ * до 2 MiB чистится за несколько шагов, недочищенный помнит a->zeroing;
+ * если его между шагами заняли, arena_mark сбрасывает a->zeroing, и
+ * следующий шаг просто идёт дальше. Свободным блок остаётся всё время,
+ * поэтому статистика и allocator_verify его видят как обычно.
+ */
+#define PREZERO_CHUNK   (64 * 1024)
+#define PREZERO_SCAN    4096
+
+bool arena_prezero_step(struct memory_allocator *a, size_t *pos)
+{
+    size_t i = *pos, end = min(a->total_blocks, *pos + PREZERO_SCAN);
+    size_t len;
+    unsigned long flags;
+
+    spin_lock_irqsave(&a->lock, flags);
+    if (a->zeroing != i) {
+        while (i < end && (bm_test(a->bitmap, i) || test_bit(i, a->zeroed)))
+            i++;
+        if (i == end) {
+            spin_unlock_irqrestore(&a->lock, flags);
+            *pos = i;
+            return i < a->total_blocks;
+        }
+        a->zeroing = i;
+        a->zeroing_off = 0;
+    }
 
-        spin_lock_irqsave(&g_alloc.lock, flags);
+    len = min_t(size_t, a->block_size - a->zeroing_off, PREZERO_CHUNK);
+    memset((char *)a->memory_pool + i * a->block_size + a->zeroing_off, 0,
+           len);
+    a->zeroing_off += len;
+    if (a->zeroing_off == a->block_size) {
+        a->zeroing = SIZE_MAX;
+        set_bit(i, a->zeroed);
+        atomic_long_inc(&a->zeroed_blocks);
+        i++;
     }
-    spin_unlock_irqrestore(&g_alloc.lock, flags);
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    *pos = i;
+    return i < a->total_blocks;
+}
+
+static void pool_zero_work(struct work_struct *work)
+{
+    unsigned int i, n = nr_arenas();
+
+    for (i = 0; i < n; i++) {
+        size_t pos = 0;
 
-    if (g_alloc.memory_pool) {
-        vfree(g_alloc.memory_pool);
-        g_alloc.memory_pool = NULL;
+        while (arena_prezero_step(g_pool.arenas[i], &pos))
+            cond_resched();
     }
+}
 
-    kfree(g_alloc.bitmap);
-    g_alloc.bitmap = NULL;
+/* после free и роста пула: свободные грязные блоки дочистит фоновая работа */
+static void pool_kick_zero(void)
+{
+    if (g_pool.prezero)
+        queue_work(system_unbound_wq, &g_pool.zero_work);
+}
 
-    pr_info("cleanup\n");
+/* доля свободного, не вошедшая в самый длинный отрезок, в процентах */
+static inline size_t frag_percent(size_t largest, size_t free_blocks)
+{
+    return free_blocks ? 100 - largest * 100 / free_blocks : 0;
 }
 
-void *allocator_alloc(size_t bytes)
+/* фрагментация арены в процентах (под локом арены) */
+static size_t arena_frag_locked(struct memory_allocator *a)
 {
-    size_t need, start;
-    void *ptr = NULL;
-    struct alloc_node *node;
+    return frag_percent(arena_largest_free(a), a->free_blocks);
+}
+
+/*
+ * Фрагментация пула, как в allocator_get_stats, но без остальной
+ * статистики: проходу уплотнения до и после нужна только она.
+ */
+static size_t pool_frag(void)
+{
+    size_t free_blocks = 0, largest_run = 0;
+    unsigned int i, n = nr_arenas();
     unsigned long flags;
+
+    for (i = 0; i < n; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        spin_lock_irqsave(&a->lock, flags);
+        free_blocks += a->free_blocks;
+        largest_run = max(largest_run, arena_largest_free(a));
+        spin_unlock_irqrestore(&a->lock, flags);
+    }
+
+    return frag_percent(largest_run, free_blocks);
+}
+
+/* после free: не пора ли уплотнять (под локом арены) */
+static bool arena_over_threshold(struct memory_allocator *a)
+{
+    return g_pool.compact_threshold &&
+           arena_frag_locked(a) >= g_pool.compact_threshold;
+}
+
+/* проход уплотнения, см. allocator_compact */
+static void pool_compact_work(struct work_struct *work);
+
+/*
+ * Фоновый проход ограничен COMPACT_BG_STEPS шагами. Если он ничего не
+ * сдвинул или фрагментация не упала (всё закреплено или отображено),
+ * порог на free снова сработает не раньше чем через COMPACT_BACKOFF.
+ */
+#define COMPACT_BG_STEPS    1024
+#define COMPACT_BACKOFF     (5 * HZ)
+
+static void pool_kick_compact(void)
+{
+    if (time_before(jiffies, READ_ONCE(g_pool.compact_retry)))
+        return;
+    queue_work(system_unbound_wq, &g_pool.compact_work);
+}
+
+/*
+ * Выровненный поиск: блоки с адресом, кратным align, идут с шагом
+ * align / block_size от первого такого блока. База арены выровнена на
+ * блок (см. arena_pool_alloc), поэтому сетка всегда ложится на границы
+ * блоков. Проверяется только bitmap, поэтому одинаково для обеих политик.
+ */
+static int arena_find_aligned(struct memory_allocator *a, size_t need,
+                              size_t align, size_t *start)
+{
+    uintptr_t base = (uintptr_t)a->memory_pool;
+    size_t head = round_up(base, align) - base;
+
+    if (WARN_ON_ONCE(head % a->block_size))
+        return -EINVAL;
+
+    return bitmap_aligned_fit(a->bitmap, a->total_blocks, need,
+                              head / a->block_size,
+                              max_t(size_t, align / a->block_size, 1), start);
+}
+
+/* временные арены replay и access_bench в гистограммы не попадают */
+static inline bool arena_hist_on(struct memory_allocator *a)
+{
+    return alloc_hist_on() && a->id < ALLOC_MAX_ARENAS;
+}
+
+/* начало свободного отрезка из need блоков по политике арены (под локом) */
+static int arena_find_free(struct memory_allocator *a, size_t need,
+                           size_t align, size_t *start)
+{
+    bool by_tree = false;
     int ret;
 
-    if (bytes == 0)
-        return NULL;
+    /* база арены выровнена на страницу, мельче выравнивать нечего */
+    if (align > PAGE_SIZE) {
+        ret = arena_find_aligned(a, need, align, start);
+    } else if (a->free_tree) {
+        ret = extent_tree_best_fit(a->free_tree, need, start);
+        by_tree = true;
+    } else {
+        ret = bitmap_first_fit(a->bitmap, a->total_blocks, need, start);
+    }
 
-    need = bytes_to_blocks(bytes);
-    if (need > TOTAL_BLOCKS)
-        return NULL;
+    /* проход по bitmap идёт с начала арены до конца найденного отрезка */
+    if (arena_hist_on(a))
+        alloc_hist_add(ALLOC_HIST_SCANNED,
+                       by_tree ? 0 : ret ? a->total_blocks : *start + need);
+    return ret;
+}
 
-    /* нельзя аллоцировать под spinlock (GFP_KERNEL может спать) */
-    node = kmalloc(sizeof(*node), GFP_KERNEL);
-    if (!node)
-        return NULL;
+/*
+ * Выдача need блоков не удалась: не хватило места вообще или только
+ * непрерывного; nomem — не выделились служебные структуры.
+ */
+static void pool_note_fail(size_t need, bool nomem)
+{
+    unsigned int i, n = nr_arenas();
+    size_t free_blocks = 0;
 
-    spin_lock_irqsave(&g_alloc.lock, flags);
+    if (!alloc_hist_on())
+        return;
 
-    ret = bitmap_first_fit(g_alloc.bitmap, g_alloc.total_blocks, need, &start);
-    if (ret) {
-        spin_unlock_irqrestore(&g_alloc.lock, flags);
-        kfree(node);
+    if (nomem) {
+        alloc_hist_fail(ALLOC_FAIL_NO_MEM);
+        return;
+    }
+
+    for (i = 0; i < n; i++)
+        free_blocks += READ_ONCE(g_pool.arenas[i]->free_blocks);
+
+    alloc_hist_fail(free_blocks >= need ? ALLOC_FAIL_NO_RUN :
+                                          ALLOC_FAIL_NO_FREE);
+}
+
+static struct alloc_node *arena_find_locked(struct memory_allocator *a,
+                                            size_t start)
+{
+    struct alloc_node *n;
+
+    hash_for_each_possible(a->allocs, n, hash, start) {
+        if (n->start_block == start)
+            return n;
+    }
+
+    return NULL;
+}
+
+/*
+ * vmalloc_huge молча откатывается на 4 KiB страницы, поэтому проверяем
+ * результат: при PMD-отображении каждое 2 MiB окно лежит на физически
+ * непрерывных страницах, выровненных на 2 MiB.
+ */
+static bool pool_is_pmd_mapped(void *pool, size_t bytes)
+{
+    size_t off, i, nr = PMD_SIZE >> PAGE_SHIFT;
+
+    if (bytes < PMD_SIZE || !IS_ALIGNED((unsigned long)pool, PMD_SIZE))
+        return false;
+
+    for (off = 0; off + PMD_SIZE <= bytes; off += PMD_SIZE) {
+        unsigned long pfn = vmalloc_to_pfn((char *)pool + off);
+
+        if (!IS_ALIGNED(pfn, nr))
+            return false;
+        for (i = 1; i < nr; i++) {
+            if (vmalloc_to_pfn((char *)pool + off + i * PAGE_SIZE) != pfn + i)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Память пула по запрошенной подложке с откатом contig -> huge -> vmalloc.
+ * Без обнуления: это делает alloc или фоновая работа (см. arena->zeroed).
+ * База пула выровнена на блок, иначе при блоке больше страницы выровненный
+ * поиск не нашёл бы ни одного подходящего адреса.
+ */
+static void *arena_pool_alloc(struct memory_allocator *a,
+                              enum alloc_backing want)
+{
+    void *pool;
+
+    /* alloc_pages_exact ограничен MAX_ORDER: на 4 KiB страницах это 4 MiB */
+    if (want == ALLOC_BACKING_CONTIG && get_order(a->pool_bytes) < MAX_ORDER) {
+        pool = alloc_pages_exact_nid(a->nid, a->pool_bytes,
+                                     GFP_KERNEL | __GFP_NOWARN);
+        /* страницы порядка order выровнены на свой размер, а он не меньше блока */
+        if (pool) {
+            a->backing = ALLOC_BACKING_CONTIG;
+            a->pool_base = pool;
+            return pool;
+        }
+    }
+
+    /* у vmalloc_huge нет варианта с узлом: страницы берутся по политике текущей задачи */
+    if (want != ALLOC_BACKING_VMALLOC && a->pool_bytes >= PMD_SIZE) {
+        pool = vmalloc_huge(a->pool_bytes, GFP_KERNEL);
+        /* откатившись на 4 KiB страницы, vmalloc_huge выравнивает лишь на страницу */
+        if (pool && IS_ALIGNED((unsigned long)pool, a->block_size)) {
+            a->backing = pool_is_pmd_mapped(pool, a->pool_bytes) ?
+                         ALLOC_BACKING_HUGE : ALLOC_BACKING_VMALLOC;
+            a->pool_base = pool;
+            return pool;
+        }
+        vfree(pool);
+    }
+
+    /*
+     * Большой пул через vmalloc (kmalloc может не дать большой contiguous).
+     * Адрес выровнен только на страницу: берём запас до границы блока.
+     */
+    a->backing = ALLOC_BACKING_VMALLOC;
+    a->pool_base = vmalloc_node(a->pool_bytes + a->block_size - PAGE_SIZE,
+                                a->nid);
+    return a->pool_base ? PTR_ALIGN(a->pool_base, a->block_size) : NULL;
+}
+
+static void arena_pool_free(struct memory_allocator *a)
+{
+    if (a->backing == ALLOC_BACKING_CONTIG)
+        free_pages_exact(a->pool_base, a->pool_bytes);
+    else
+        vfree(a->pool_base);
+}
+
+struct memory_allocator *arena_create(unsigned int id, size_t bytes,
+                                      size_t block_size,
+                                      enum alloc_policy policy,
+                                      enum alloc_backing backing, int nid)
+{
+    struct memory_allocator *a;
+    size_t bitmap_bytes, nr_segs;
+
+    a = kzalloc_node(sizeof(*a), GFP_KERNEL, nid);
+    if (!a)
         return NULL;
+
+    a->id = id;
+    a->nid = nid;
+    a->block_size = block_size;
+    a->total_blocks = bytes / a->block_size;
+    a->pool_bytes = a->total_blocks * a->block_size;
+    spin_lock_init(&a->lock);
+    hash_init(a->allocs);
+    a->zeroing = SIZE_MAX;
+
+    for (int c = 0; c < SC_NR_CLASSES; c++)
+        INIT_LIST_HEAD(&a->classes[c].partial);
+
+    /* на пулах в гигабайты bitmap уже не помещается в kmalloc */
+    bitmap_bytes = (a->total_blocks + 7) / 8;
+    a->bitmap = kvzalloc(bitmap_bytes, GFP_KERNEL);
+    if (!a->bitmap)
+        goto err;
+
+    /* пустая арена: все сегменты свободны целиком, сводки считаем сразу */
+    nr_segs = bitmap_nr_segs(a->total_blocks);
+    a->segs = kvcalloc(nr_segs, sizeof(*a->segs), GFP_KERNEL);
+    a->seg_dirty = kvzalloc((nr_segs + 7) / 8, GFP_KERNEL);
+    a->zeroed = kvcalloc(BITS_TO_LONGS(a->total_blocks), sizeof(long),
+                         GFP_KERNEL);
+    if (!a->segs || !a->seg_dirty || !a->zeroed)
+        goto err;
+    for (size_t seg = 0; seg < nr_segs; seg++)
+        bitmap_seg_compute(a->bitmap, a->total_blocks, seg, &a->segs[seg]);
+    a->free_blocks = a->total_blocks;
+    a->largest_free = a->total_blocks;
+
+    a->policy = policy;
+    if (policy == ALLOC_POLICY_BEST_FIT) {
+        a->free_tree = kzalloc(sizeof(*a->free_tree), GFP_KERNEL);
+        if (!a->free_tree)
+            goto err;
+        if (extent_tree_init(a->free_tree, a->total_blocks) != ALLOC_OK) {
+            kfree(a->free_tree);
+            a->free_tree = NULL;
+            goto err;
+        }
     }
 
-    /* помечаем блоки занятыми */
-    for (size_t i = 0; i < need; i++)
-        bm_set(g_alloc.bitmap, start + i);
+    a->memory_pool = arena_pool_alloc(a, backing);
+    if (!a->memory_pool)
+        goto err;
 
-    ptr = (void *)((char *)g_alloc.memory_pool + start * BLOCK_SIZE);
+    pr_info("arena %u: node=%d pool=%zu bytes, block=%zu, blocks=%zu, bitmap=%zu bytes, backing=%s%s\n",
+            a->id, a->nid, a->pool_bytes, a->block_size, a->total_blocks,
+            bitmap_bytes,
+            allocator_backing_name(a->backing),
+            a->backing != backing ? " (fallback)" : "");
+    return a;
 
-    node->ptr = ptr;
-    node->start_block = start;
-    node->num_blocks = need;
-    list_add(&node->list, &g_alloc_list);
+err:
+    if (a->free_tree) {
+        extent_tree_destroy(a->free_tree);
+        kfree(a->free_tree);
+    }
+    kvfree(a->zeroed);
+    kvfree(a->seg_dirty);
+    kvfree(a->segs);
+    kvfree(a->bitmap);
+    kfree(a);
+    return NULL;
+}
 
-    spin_unlock_irqrestore(&g_alloc.lock, flags);
+void arena_destroy(struct memory_allocator *a)
+{
+    struct alloc_node *n;
+    struct hlist_node *tmp;
+    int bkt;
 
-    /* печатаем адрес как число, чтобы не зависеть от %p/%px и kptr_restrict */
-    pr_info("allocated %zu bytes (%zu blocks) at 0x%llx\n",
-            bytes, need, (unsigned long long)(uintptr_t)ptr);
+    /* к этому моменту арена уже не видна аллокатору, лок не нужен */
+    hash_for_each_safe(a->allocs, bkt, tmp, n, hash) {
+        hash_del(&n->hash);
+        kfree(n->page);
+        kfree(n);
+    }
 
-    return ptr;
+    arena_pool_free(a);
+    if (a->free_tree) {
+        extent_tree_destroy(a->free_tree);
+        kfree(a->free_tree);
+    }
+    kvfree(a->zeroed);
+    kvfree(a->seg_dirty);
+    kvfree(a->segs);
+    kvfree(a->bitmap);
+    kfree(a);
 }
 
-int allocator_free(void *ptr)
+/* добавить арену размером bytes (округляется до блока) на узле nid; под grow_lock */
+static int pool_add_arena_locked(size_t bytes, int nid)
 {
-    struct alloc_node *n, *found = NULL;
-    size_t start;
-    unsigned long flags;
+    struct memory_allocator *a;
+    unsigned int id = g_pool.nr_arenas;
+    uintptr_t base;
+    void *old;
 
-    if (!ptr)
-        return ALLOC_INVALID;
+    bytes = round_up(bytes, g_pool.block_size);
+    if (id >= ALLOC_MAX_ARENAS)
+        return ALLOC_NOMEM;
+    if (g_pool.pool_bytes + bytes > g_pool.max_pool_bytes)
+        return ALLOC_NOMEM;
+
+    a = arena_create(id, bytes, g_pool.block_size, g_pool.policy,
+                     g_pool.backing, nid);
+    if (!a)
+        return ALLOC_NOMEM;
+
+    base = (uintptr_t)a->memory_pool;
+    old = xa_store_range(&g_pool.index, base >> PAGE_SHIFT,
+                         (base + a->pool_bytes - 1) >> PAGE_SHIFT,
+                         a, GFP_KERNEL);
+    if (xa_is_err(old)) {
+        arena_destroy(a);
+        return ALLOC_NOMEM;
+    }
+
+    /* арены идут в адресах устройства подряд, в порядке добавления */
+    a->dev_offset = g_pool.pool_bytes;
+
+    g_pool.arenas[id] = a;
+    g_pool.pool_bytes += a->pool_bytes;
+    smp_store_release(&g_pool.nr_arenas, id + 1);
+    pool_kick_zero();
+    return ALLOC_OK;
+}
+
+int allocator_grow(size_t bytes)
+{
+    int ret;
+
+    if (!bytes)
+        bytes = g_pool.arena_bytes;
+
+    mutex_lock(&g_pool.grow_lock);
+    ret = pool_add_arena_locked(bytes, pool_local_node());
+    mutex_unlock(&g_pool.grow_lock);
+
+    return ret;
+}
+
+/*
+ * Пул кончился: добавить арену не меньше need блоков на узле вызывающего,
+ * если позволяет max_pool_size. seen — сколько арен видел вызывающий;
+ * если за это время арену уже добавил кто-то другой, повторяем поиск без роста.
+ */
+static int pool_grow_for(size_t need, unsigned int seen)
+{
+    size_t bytes = max(g_pool.arena_bytes, need * g_pool.block_size);
+    int ret = ALLOC_OK;
+
+    mutex_lock(&g_pool.grow_lock);
+    if (g_pool.nr_arenas == seen) {
+        /* у потолка пула арена может быть и меньше обычной */
+        bytes = min(bytes, g_pool.max_pool_bytes - g_pool.pool_bytes);
+        if (bytes < need * g_pool.block_size)
+            ret = ALLOC_NOMEM;
+        else
+            ret = pool_add_arena_locked(bytes, pool_local_node());
+    }
+    mutex_unlock(&g_pool.grow_lock);
+
+    return ret;
+}
+
+int allocator_init(const struct allocator_config *cfg)
+{
+    size_t bs = cfg->block_size;
+    unsigned int nr_nodes;
+    int nid, ret = ALLOC_OK;
 
-    if (ptr_to_block(ptr, &start) != ALLOC_OK)
+    /* блок — степень двойки не меньше страницы: иначе не нарезать size-классы */
+    if (!is_power_of_2(bs) || bs < PAGE_SIZE || bs > ALLOC_MAX_BLOCK_SIZE)
+        return ALLOC_INVALID;
+    if (cfg->pool_size < bs)
+        return ALLOC_INVALID;
+    if (cfg->policy != ALLOC_POLICY_FIRST_FIT &&
+        cfg->policy != ALLOC_POLICY_BEST_FIT)
+        return ALLOC_INVALID;
+    if (cfg->backing > ALLOC_BACKING_CONTIG)
+        return ALLOC_INVALID;
+    if (cfg->compact_threshold > 100)
         return ALLOC_INVALID;
 
-    spin_lock_irqsave(&g_alloc.lock, flags);
+    memset(&g_pool, 0, sizeof(g_pool));
+    mutex_init(&g_pool.grow_lock);
+    xa_init(&g_pool.index);
 
-    /* ищем именно этот указатель в списке активных аллокаций */
-    list_for_each_entry(n, &g_alloc_list, list) {
-        if (n->ptr == ptr) {
-            found = n;
-            break;
+    g_pool.block_size = bs;
+    g_pool.arena_bytes = round_up(cfg->pool_size, bs);
+    g_pool.numa = cfg->numa;
+    nr_nodes = g_pool.numa ? num_online_nodes() : 1;
+    g_pool.max_pool_bytes = max(g_pool.arena_bytes * nr_nodes,
+                                cfg->max_pool_size);
+    g_pool.policy = cfg->policy;
+    g_pool.backing = cfg->backing;
+    g_pool.prezero = cfg->prezero;
+    INIT_WORK(&g_pool.zero_work, pool_zero_work);
+    g_pool.compact_threshold = cfg->compact_threshold;
+    mutex_init(&g_pool.compact_lock);
+    spin_lock_init(&g_pool.compact_stats_lock);
+    g_pool.compact_retry = jiffies;
+    xa_init_flags(&g_pool.handles, XA_FLAGS_ALLOC1);
+    INIT_WORK(&g_pool.compact_work, pool_compact_work);
+
+    /* начальная арена на каждом узле, чтобы память была рядом с потребителем */
+    mutex_lock(&g_pool.grow_lock);
+    if (!g_pool.numa) {
+        ret = pool_add_arena_locked(g_pool.arena_bytes, NUMA_NO_NODE);
+    } else {
+        for_each_online_node(nid) {
+            ret = pool_add_arena_locked(g_pool.arena_bytes, nid);
+            if (ret != ALLOC_OK)
+                break;
         }
     }
+    mutex_unlock(&g_pool.grow_lock);
 
-    if (!found) {
-        spin_unlock_irqrestore(&g_alloc.lock, flags);
-        return ALLOC_NOT_FOUND;
+    if (ret != ALLOC_OK) {
+        allocator_cleanup();
+        return ALLOC_NOMEM;
     }
 
-    /* защита от "битых" состояний */
-    if (found->start_block != start) {
-        spin_unlock_irqrestore(&g_alloc.lock, flags);
-        return ALLOC_INVALID;
+    pr_info("init: pool=%zu bytes (max %zu), block=%zu, policy=%s, backing=%s, prezero=%d, arenas=%u\n",
+            g_pool.pool_bytes, g_pool.max_pool_bytes, g_pool.block_size,
+            allocator_policy_name(g_pool.policy),
+            allocator_backing_name(g_pool.backing), g_pool.prezero,
+            g_pool.nr_arenas);
+    return ALLOC_OK;
+}
+
+void allocator_cleanup(void)
+{
+    unsigned int i, n = g_pool.nr_arenas;
+
+    /* освободим все арены вместе с активными аллокациями */
+    WRITE_ONCE(g_pool.nr_arenas, 0);
+    cancel_work_sync(&g_pool.zero_work);
+    cancel_work_sync(&g_pool.compact_work);
+    xa_destroy(&g_pool.index);
+    xa_destroy(&g_pool.handles);
+
+    for (i = 0; i < n; i++) {
+        arena_destroy(g_pool.arenas[i]);
+        g_pool.arenas[i] = NULL;
     }
 
-    /* сбрасываем биты */
-    for (size_t i = 0; i < found->num_blocks; i++) {
-        /* двойное освобождение: если бит уже 0 — состояние неверное */
-        if (!bm_test(g_alloc.bitmap, found->start_block + i)) {
-            spin_unlock_irqrestore(&g_alloc.lock, flags);
-            return ALLOC_INVALID;
+    g_pool.pool_bytes = 0;
+    pr_info("cleanup\n");
+}
+
+/* снять объект с первой частично занятой страницы класса (под локом арены) */
+static void *sc_alloc_locked(struct memory_allocator *a, int cls)
+{
+    struct size_class *sc = &a->classes[cls];
+    struct sc_page *sp;
+    void *obj;
+
+    if (list_empty(&sc->partial))
+        return NULL;
+
+    sp = list_first_entry(&sc->partial, struct sc_page, partial);
+    obj = sc_obj_alloc(sp);
+    if (sc_page_full(sp))
+        list_del_init(&sp->partial);
+
+    sc->objects++;
+    a->sc_bytes += sp->obj_size;
+    return obj;
+}
+
+/* нарезать новый блок арены под класс cls и выдать из него объект */
+static void *sc_new_page_locked(struct memory_allocator *a, int cls,
+                                struct alloc_node *node, struct sc_page *sp)
+{
+    size_t start;
+
+    if (arena_find_free(a, 1, 0, &start))
+        return NULL;
+
+    arena_mark(a, start, 1, true);
+    /* объекты обнуляются при выдаче, сам блок целиком не чистим */
+    if (test_and_clear_bit(start, a->zeroed))
+        atomic_long_dec(&a->zeroed_blocks);
+    sc_page_init(sp, (char *)a->memory_pool + start * a->block_size,
+                 cls, a->block_size);
+
+    node->ptr = sp->base;
+    node->start_block = start;
+    node->num_blocks = 1;
+    node->page = sp;
+    node->arena = a;
+    node->owner = NULL;
+    node->map_count = 0;
+    node->handle = 0;
+    node->pin_count = 0;
+    hash_add(a->allocs, &node->hash, start);
+
+    list_add(&sp->partial, &a->classes[cls].partial);
+    a->classes[cls].pages++;
+    a->sc_blocks++;
+
+    return sc_alloc_locked(a, cls);
+}
+
+/*
+ * Мелкие запросы (<= SC_MAX_SIZE) обслуживаются из блоков, нарезанных на
+ * объекты одного размерного класса. Новый блок берётся из bitmap арены
+ * только когда ни у одной арены нет частично занятых страниц класса.
+ */
+static void *sc_alloc(size_t bytes, int cls, unsigned int alloc_flags)
+{
+    struct memory_allocator *a;
+    struct sc_page *sp;
+    struct alloc_node *node;
+    unsigned long flags;
+    unsigned int pos = 0, n;
+    int nid = pool_local_node();
+    void *obj = NULL;
+
+    /* частично занятые страницы только своего узла: чужой узел — после нового блока */
+    n = nr_arenas();
+    while (!obj && (a = pool_next_arena(nid, n, &pos)) &&
+           arena_is_local(a, nid)) {
+        spin_lock_irqsave(&a->lock, flags);
+        obj = sc_alloc_locked(a, cls);
+        spin_unlock_irqrestore(&a->lock, flags);
+    }
+    if (obj)
+        goto out;
+
+    /* свободных объектов нет: готовим новую страницу вне лока */
+    node = kmalloc(sizeof(*node), GFP_KERNEL);
+    sp = kmalloc(sc_page_bytes(g_pool.block_size, cls), GFP_KERNEL);
+    if (!node || !sp)
+        goto out_free;
+
+retry:
+    pos = 0;
+    while (!obj && (a = pool_next_arena(nid, n, &pos))) {
+        spin_lock_irqsave(&a->lock, flags);
+        /* пока лок был отпущен, страницу мог добавить кто-то другой */
+        obj = sc_alloc_locked(a, cls);
+        if (!obj) {
+            obj = sc_new_page_locked(a, cls, node, sp);
+            if (obj)
+                node = NULL, sp = NULL; /* заготовки теперь принадлежат арене */
         }
-        bm_clear(g_alloc.bitmap, found->start_block + i);
+        spin_unlock_irqrestore(&a->lock, flags);
     }
 
-    list_del(&found->list);
-    spin_unlock_irqrestore(&g_alloc.lock, flags);
+    if (!obj && pool_grow_for(1, n) == ALLOC_OK) {
+        n = nr_arenas();
+        goto retry;
+    }
+
+out_free:
+    if (!obj)
+        pool_note_fail(1, !node || !sp);
+    kfree(node);
+    kfree(sp);
+    if (!obj)
+        return NULL;
 
-    pr_info("freed memory at 0x%llx (%zu blocks)\n",
-            (unsigned long long)(uintptr_t)ptr, found->num_blocks);
+out:
+    arena_count_alloc(a, nid);
+    if (!(alloc_flags & ALLOC_F_NOZERO))
+        memset(obj, 0, 1u << (SC_MIN_SHIFT + cls));
+
+    return obj;
+}
+
+/* вернуть объект в его страницу; пустая страница отдаёт блок арене (под локом) */
+static int sc_free_locked(struct memory_allocator *a, struct alloc_node *node,
+                          void *ptr, struct alloc_node **release)
+{
+    struct sc_page *sp = node->page;
+    struct size_class *sc = &a->classes[sp->cls];
+    bool was_full = sc_page_full(sp);
+    int ret;
+
+    ret = sc_obj_free(sp, ptr);
+    if (ret != ALLOC_OK)
+        return ret;
+
+    sc->objects--;
+    a->sc_bytes -= sp->obj_size;
+
+    if (sc_page_empty(sp)) {
+        list_del(&sp->partial);
+        hash_del(&node->hash);
+        arena_mark(a, node->start_block, 1, false);
+        sc->pages--;
+        a->sc_blocks--;
+        *release = node;
+    } else if (was_full) {
+        list_add(&sp->partial, &sc->partial);
+    }
 
-    kfree(found);
     return ALLOC_OK;
 }
 
-struct stats_info allocator_get_stats(void)
+/*
+ * Блоки [start, start + len) уже заняты вызывающим: снять с них отметку
+ * "обнулён" и дочистить те, что фоновая работа ещё не успела. Лок не
+ * нужен, фоновая работа трогает только свободные блоки.
+ */
+static void arena_zero_blocks(struct memory_allocator *a, size_t start,
+                              size_t len, bool zero)
 {
-    struct stats_info s;
-    unsigned char snapshot[BITMAP_BYTES];
-    unsigned long flags;
-    size_t free_blocks, largest_run;
+    size_t i;
 
-    memset(&s, 0, sizeof(s));
+    for (i = start; i < start + len; i++) {
+        if (test_and_clear_bit(i, a->zeroed)) {
+            atomic_long_dec(&a->zeroed_blocks);
+            continue;
+        }
+        if (!zero)
+            continue;
+        memset((char *)a->memory_pool + i * a->block_size, 0, a->block_size);
+    }
+}
+
+/* поиск по политике арены; при успехе node регистрируется в арене */
+void *arena_alloc_blocks(struct memory_allocator *a, size_t need,
+                         size_t align, struct alloc_node *node,
+                         const void *owner, unsigned int flags)
+{
+    unsigned long irq_flags;
+    size_t start;
+    void *ptr;
+    u64 t0 = 0;
 
-    s.total_blocks = TOTAL_BLOCKS;
-    s.total_memory = POOL_SIZE_BYTES;
+    if (need > a->total_blocks)
+        return NULL;
 
-    /* снимем bitmap под локом, а считать будем без лока */
-    spin_lock_irqsave(&g_alloc.lock, flags);
-    memcpy(snapshot, g_alloc.bitmap, BITMAP_BYTES);
-    spin_unlock_irqrestore(&g_alloc.lock, flags);
+    spin_lock_irqsave(&a->lock, irq_flags);
+    if (arena_hist_on(a))
+        t0 = ktime_get_ns();
 
-    free_blocks = bitmap_count_free(snapshot, TOTAL_BLOCKS);
-    largest_run = bitmap_largest_free_run(snapshot, TOTAL_BLOCKS);
+    if (arena_find_free(a, need, align, &start)) {
+        if (t0)
+            alloc_hist_add(ALLOC_HIST_LOCK_NS, ktime_get_ns() - t0);
+        spin_unlock_irqrestore(&a->lock, irq_flags);
+        return NULL;
+    }
 
-    s.free_blocks = free_blocks;
-    s.allocated_blocks = TOTAL_BLOCKS - free_blocks;
+    /* помечаем блоки занятыми */
+    arena_mark(a, start, need, true);
 
-    s.free_memory = free_blocks * BLOCK_SIZE;
-    s.allocated_memory = s.allocated_blocks * BLOCK_SIZE;
+    ptr = (void *)((char *)a->memory_pool + start * a->block_size);
 
-    if (free_blocks == 0)
-        s.fragmentation_percent = 0;
-    else
-        s.fragmentation_percent =
-        100 - (largest_run * 100 / free_blocks);
+    node->ptr = ptr;
+    node->start_block = start;
+    node->num_blocks = need;
+    node->page = NULL;
+    node->arena = a;
+    node->owner = owner;
+    node->map_count = 0;
+    node->handle = 0;
+    node->pin_count = 0;
+    hash_add(a->allocs, &node->hash, start);
 
-    return s;
+    if (t0)
+        alloc_hist_add(ALLOC_HIST_LOCK_NS, ktime_get_ns() - t0);
+    spin_unlock_irqrestore(&a->lock, irq_flags);
+
+    arena_zero_blocks(a, start, need, !(flags & ALLOC_F_NOZERO));
+    return ptr;
 }
 
-int allocator_bitmap_string(char *out, size_t out_sz)
+/* снять аллокацию целыми блоками; память узла остаётся за вызывающим */
+void arena_free_node(struct memory_allocator *a, struct alloc_node *node)
 {
-    unsigned char snapshot[BITMAP_BYTES];
     unsigned long flags;
 
-    spin_lock_irqsave(&g_alloc.lock, flags);
-    memcpy(snapshot, g_alloc.bitmap, BITMAP_BYTES);
-    spin_unlock_irqrestore(&g_alloc.lock, flags);
+    spin_lock_irqsave(&a->lock, flags);
+    arena_mark(a, node->start_block, node->num_blocks, false);
+    hash_del(&node->hash);
+    spin_unlock_irqrestore(&a->lock, flags);
+}
+
+/*
+ * Найти need блоков для node: сначала арены своего узла, чужие — только
+ * когда свои заполнены, затем рост пула. node регистрируется в арене.
+ */
+static void *pool_alloc_blocks(size_t need, size_t align,
+                               struct alloc_node *node, const void *owner,
+                               unsigned int flags)
+{
+    struct memory_allocator *a;
+    size_t slack = 0;
+    void *ptr = NULL;
+    unsigned int i, n, pos = 0;
+    int nid = pool_local_node();
+
+    if (need > g_pool.max_pool_bytes / g_pool.block_size)
+        return NULL;
+
+    /* новой арене может понадобиться запас до первой выровненной границы */
+    if (align > g_pool.block_size)
+        slack = align / g_pool.block_size - 1;
+
+    n = nr_arenas();
+    while (!ptr && (a = pool_next_arena(nid, n, &pos)))
+        ptr = arena_alloc_blocks(a, need, align, node, owner, flags);
+
+    /* места нет ни в одной арене: пробуем нарастить пул */
+    while (!ptr && pool_grow_for(need + slack, n) == ALLOC_OK) {
+        unsigned int from = n;
+
+        n = nr_arenas();
+        for (i = from; i < n && !ptr; i++)
+            ptr = arena_alloc_blocks(g_pool.arenas[i], need, align, node,
+                                     owner, flags);
+    }
+
+    if (ptr)
+        arena_count_alloc(node->arena, nid);
+    return ptr;
+}
+
+static void *pool_alloc_owned(size_t bytes, size_t align, unsigned int flags,
+                              const void *owner)
+{
+    size_t need;
+    void *ptr;
+    struct alloc_node *node;
+    int cls;
+
+    if (bytes == 0 || (align && !is_power_of_2(align)))
+        return NULL;
+
+    /*
+     * Объекты size-классов делят блок между владельцами, поэтому только для
+     * ядра. Объект лежит на границе своего размера: для выравнивания
+     * достаточно взять класс не меньше align.
+     */
+    cls = sc_class_of(max(bytes, align));
+    if (cls >= 0 && !owner && !(flags & ALLOC_F_BLOCKS))
+        return sc_alloc(bytes, cls, flags);
+
+    need = bytes_to_blocks(bytes);
+
+    /* нельзя аллоцировать под spinlock (GFP_KERNEL может спать) */
+    node = kmalloc(sizeof(*node), GFP_KERNEL);
+    if (!node) {
+        pool_note_fail(need, true);
+        return NULL;
+    }
+
+    ptr = pool_alloc_blocks(need, align, node, owner, flags);
+    if (!ptr) {
+        pool_note_fail(need, false);
+        kfree(node);
+        return NULL;
+    }
+
+    return ptr;
+}
+
+/*
+ * Время вызова нужно и гистограммам, и событию kalloc_alloc; когда оба
+ * выключены, остаются два пустых перехода по static key.
+ */
+void *allocator_alloc_owned(size_t bytes, size_t align, unsigned int flags,
+                            const void *owner)
+{
+    bool hist = alloc_hist_on();
+    void *ptr;
+    u64 t0, dt;
+
+    if (!hist && !trace_kalloc_alloc_enabled())
+        return pool_alloc_owned(bytes, align, flags, owner);
+
+    t0 = ktime_get_ns();
+    ptr = pool_alloc_owned(bytes, align, flags, owner);
+    dt = ktime_get_ns() - t0;
+
+    if (hist) {
+        alloc_hist_add(ALLOC_HIST_ALLOC_NS, dt);
+        alloc_hist_add(ALLOC_HIST_SIZE, bytes);
+    }
+    trace_kalloc_alloc(ptr, bytes, align, owner != NULL, dt);
+    return ptr;
+}
+
+void *allocator_alloc(size_t bytes)
+{
+    return allocator_alloc_owned(bytes, 0, 0, NULL);
+}
+
+void *allocator_alloc_aligned(size_t bytes, size_t align)
+{
+    return allocator_alloc_owned(bytes, align, 0, NULL);
+}
+
+static int pool_free_owned(void *ptr, const void *owner)
+{
+    struct memory_allocator *a;
+    struct alloc_node *found, *release = NULL;
+    size_t start;
+    unsigned long flags;
+    bool fragmented;
+    int ret;
+
+    if (!ptr)
+        return ALLOC_INVALID;
+
+    if (ptr_to_block(ptr, &a, &start) != ALLOC_OK)
+        return ALLOC_INVALID;
+
+    spin_lock_irqsave(&a->lock, flags);
+
+    /* ищем аллокацию (или slab-страницу), которой принадлежит блок */
+    found = arena_find_locked(a, start);
+    if (!found) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return ALLOC_NOT_FOUND;
+    }
+
+    /* чужие аллокации (ядра или другого файла) освобождать нельзя */
+    if (found->owner != owner) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return ALLOC_INVALID;
+    }
+
+    if (found->page) {
+        ret = sc_free_locked(a, found, ptr, &release);
+        spin_unlock_irqrestore(&a->lock, flags);
+        if (ret != ALLOC_OK)
+            return ret;
+
+        if (release) {
+            kfree(release->page);
+            kfree(release);
+            pool_kick_zero();
+        }
+        return ALLOC_OK;
+    }
+
+    /* обычная аллокация: указатель должен совпадать с началом */
+    if (found->ptr != ptr || found->handle) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return ALLOC_INVALID;
+    }
+
+    /* экстент отображён в userspace: освобождать можно только после munmap */
+    if (found->map_count) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return ALLOC_BUSY;
+    }
+
+    /* двойное освобождение: если бит уже 0 — состояние неверное */
+    for (size_t i = 0; i < found->num_blocks; i++) {
+        if (!bm_test(a->bitmap, found->start_block + i)) {
+            spin_unlock_irqrestore(&a->lock, flags);
+            return ALLOC_INVALID;
+        }
+    }
+
+    /* сбрасываем биты */
+    arena_mark(a, found->start_block, found->num_blocks, false);
+
+    hash_del(&found->hash);
+    fragmented = arena_over_threshold(a);
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    kfree(found);
+    pool_kick_zero();
+    if (fragmented)
+        pool_kick_compact();
+    return ALLOC_OK;
+}
+
+int allocator_free_owned(void *ptr, const void *owner)
+{
+    bool hist = alloc_hist_on();
+    u64 t0, dt;
+    int ret;
+
+    if (!hist && !trace_kalloc_free_enabled())
+        return pool_free_owned(ptr, owner);
+
+    t0 = ktime_get_ns();
+    ret = pool_free_owned(ptr, owner);
+    dt = ktime_get_ns() - t0;
+
+    if (hist)
+        alloc_hist_add(ALLOC_HIST_FREE_NS, dt);
+    trace_kalloc_free(ptr, ret, dt);
+    return ret;
+}
+
+int allocator_free(void *ptr)
+{
+    return allocator_free_owned(ptr, NULL);
+}
+
+/* перенос в новую аллокацию: последний вариант realloc */
+static void *realloc_move(void *ptr, size_t old_bytes, size_t new_bytes)
+{
+    void *p = allocator_alloc(new_bytes);
+
+    if (!p)
+        return NULL;
+
+    memcpy(p, ptr, min(old_bytes, new_bytes));
+    allocator_free(ptr);
+    atomic_long_inc(&g_pool.realloc_moved);
+
+    trace_kalloc_realloc(ptr, p, new_bytes, false);
+    return p;
+}
+
+/*
+ * Изменить размер аллокации ядра. Экстент блоков уменьшается на месте,
+ * растёт на месте, если следующие блоки свободны; иначе — перенос.
+ * Объект size-класса остаётся на месте, пока новый размер влезает в класс.
+ * NULL при неудаче, старая аллокация тогда не тронута.
+ */
+void *allocator_realloc(void *ptr, size_t new_bytes)
+{
+    struct memory_allocator *a;
+    struct alloc_node *found;
+    size_t start, old_blocks, need, i;
+    unsigned long flags;
+
+    if (!ptr)
+        return allocator_alloc(new_bytes);
+    if (!new_bytes) {
+        allocator_free(ptr);
+        return NULL;
+    }
+
+    if (ptr_to_block(ptr, &a, &start) != ALLOC_OK)
+        return NULL;
+
+    spin_lock_irqsave(&a->lock, flags);
+
+    found = arena_find_locked(a, start);
+    if (!found || found->owner || found->map_count || found->handle ||
+        (!found->page && found->ptr != ptr)) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return NULL;
+    }
+
+    if (found->page) {
+        unsigned int obj_size = found->page->obj_size;
+
+        spin_unlock_irqrestore(&a->lock, flags);
+        if (new_bytes <= obj_size) {
+            atomic_long_inc(&g_pool.realloc_in_place);
+            trace_kalloc_realloc(ptr, ptr, new_bytes, true);
+            return ptr;
+        }
+        return realloc_move(ptr, obj_size, new_bytes);
+    }
+
+    old_blocks = found->num_blocks;
+    need = bytes_to_blocks(new_bytes);
+
+    if (need <= old_blocks) {
+        /* хвост возвращается арене, узел меняется под тем же локом */
+        if (need < old_blocks) {
+            arena_mark(a, start + need, old_blocks - need, false);
+            found->num_blocks = need;
+        }
+        spin_unlock_irqrestore(&a->lock, flags);
+
+        if (need < old_blocks)
+            pool_kick_zero();
+        goto in_place;
+    }
+
+    /* рост: нужны свободные блоки сразу за экстентом */
+    for (i = start + old_blocks; i < start + need; i++) {
+        if (i >= a->total_blocks || bm_test(a->bitmap, i))
+            break;
+    }
+
+    if (i < start + need) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return realloc_move(ptr, old_blocks * a->block_size, new_bytes);
+    }
+
+    arena_mark(a, start + old_blocks, need - old_blocks, true);
+    found->num_blocks = need;
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    /* новые блоки теперь наши: дочищаем, как при обычной выдаче */
+    arena_zero_blocks(a, start + old_blocks, need - old_blocks, true);
+
+in_place:
+    atomic_long_inc(&g_pool.realloc_in_place);
+    trace_kalloc_realloc(ptr, ptr, new_bytes, true);
+    return ptr;
+}
+
+int allocator_handle_alloc(size_t bytes, u32 *handle_out)
+{
+    struct alloc_node *node;
+    unsigned long flags;
+    u32 id;
+
+    if (!bytes || !handle_out)
+        return ALLOC_INVALID;
+
+    node = kmalloc(sizeof(*node), GFP_KERNEL);
+    if (!node)
+        return ALLOC_NOMEM;
+
+    /* номер занимаем заранее, узел станет виден по нему после выдачи блоков */
+    if (xa_alloc(&g_pool.handles, &id, NULL, xa_limit_31b, GFP_KERNEL)) {
+        kfree(node);
+        return ALLOC_NOMEM;
+    }
+
+    if (!pool_alloc_blocks(bytes_to_blocks(bytes), 0, node, NULL, 0)) {
+        xa_erase(&g_pool.handles, id);
+        kfree(node);
+        return ALLOC_NOMEM;
+    }
+
+    /* перемещаемым экстент становится под локом арены */
+    spin_lock_irqsave(&node->arena->lock, flags);
+    node->handle = id;
+    spin_unlock_irqrestore(&node->arena->lock, flags);
+    xa_store(&g_pool.handles, id, node, GFP_KERNEL);
+
+    trace_kalloc_handle_alloc(id, node->num_blocks);
+
+    *handle_out = id;
+    return ALLOC_OK;
+}
+
+/*
+ * Узел по handle ищется без ссылки: под rcu_read_lock он не освободится,
+ * а живым остаётся, пока под локом арены n->handle == handle. Освобождение
+ * обнуляет n->handle под тем же локом, поэтому проигравший гонку free,
+ * pin или unpin видит уже мёртвый узел. Лок арены на выходе взят.
+ */
+static struct alloc_node *handle_lock(u32 handle, unsigned long *flags)
+{
+    struct alloc_node *n = xa_load(&g_pool.handles, handle);
+
+    if (!n)
+        return NULL;
+
+    spin_lock_irqsave(&n->arena->lock, *flags);
+    if (n->handle != handle) {
+        spin_unlock_irqrestore(&n->arena->lock, *flags);
+        return NULL;
+    }
+    return n;
+}
+
+void *allocator_handle_pin(u32 handle)
+{
+    struct alloc_node *n;
+    unsigned long flags;
+    void *ptr = NULL;
+
+    rcu_read_lock();
+    n = handle_lock(handle, &flags);
+    if (n) {
+        n->pin_count++;
+        ptr = n->ptr;
+        spin_unlock_irqrestore(&n->arena->lock, flags);
+    }
+    rcu_read_unlock();
+
+    return ptr;
+}
+
+void allocator_handle_unpin(u32 handle)
+{
+    struct alloc_node *n;
+    unsigned long flags;
+
+    rcu_read_lock();
+    n = handle_lock(handle, &flags);
+    if (n) {
+        if (!WARN_ON_ONCE(!n->pin_count))
+            n->pin_count--;
+        spin_unlock_irqrestore(&n->arena->lock, flags);
+    }
+    rcu_read_unlock();
+}
+
+int allocator_handle_free(u32 handle)
+{
+    struct alloc_node *n;
+    struct memory_allocator *a;
+    unsigned long flags;
+    bool fragmented;
+
+    rcu_read_lock();
+    n = handle_lock(handle, &flags);
+    if (!n) {
+        rcu_read_unlock();
+        return ALLOC_NOT_FOUND;
+    }
+
+    a = n->arena;
+    if (n->pin_count) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        rcu_read_unlock();
+        return ALLOC_BUSY;
+    }
+    n->handle = 0;
+    arena_mark(a, n->start_block, n->num_blocks, false);
+    hash_del(&n->hash);
+    fragmented = arena_over_threshold(a);
+    spin_unlock_irqrestore(&a->lock, flags);
+    rcu_read_unlock();
+
+    xa_erase(&g_pool.handles, handle);
+    trace_kalloc_handle_free(handle, n->num_blocks);
+    kfree_rcu(n, rcu);
+
+    pool_kick_zero();
+    if (fragmented)
+        pool_kick_compact();
+    return ALLOC_OK;
+}
+
+/*
+ * Границы одного шага уплотнения под локом арены: сколько блоков
+ * просмотреть в поисках дыры и сколько байт перенести за раз. Экстенты
+ * крупнее COMPACT_MOVE_BYTES не двигаются вовсе.
+ */
+#define COMPACT_SCAN_BLOCKS 4096
+#define COMPACT_MOVE_BYTES  (256 * 1024)
+
+/*
+ * Шаг с позиции *pos: найти первую дыру и экстент сразу за ней. Если он
+ * перемещаемый и не закреплён, сдвинуть его в начало дыры, иначе
+ * перешагнуть. false — арена пройдена до конца.
+ */
+static bool arena_compact_step(struct memory_allocator *a, size_t *pos,
+                               struct compact_stats *cs)
+{
+    size_t hole = *pos, used, end, len, i;
+    struct alloc_node *n;
+    unsigned long flags;
+
+    spin_lock_irqsave(&a->lock, flags);
+
+    end = min(a->total_blocks, hole + COMPACT_SCAN_BLOCKS);
+    while (hole < end && bm_test(a->bitmap, hole))
+        hole++;
+    if (hole == end) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        *pos = hole;
+        return hole < a->total_blocks;
+    }
+
+    /* длинную дыру проходим по частям: её начало просто сдвинется вперёд */
+    end = min(a->total_blocks, hole + COMPACT_SCAN_BLOCKS);
+    used = hole;
+    while (used < end && !bm_test(a->bitmap, used))
+        used++;
+    if (used == end) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        *pos = used;
+        return used < a->total_blocks;
+    }
+
+    /* перед used свободный блок, значит с него начинается экстент */
+    n = arena_find_locked(a, used);
+    if (!n || !n->handle || n->pin_count || n->map_count || n->page ||
+        n->num_blocks * a->block_size > COMPACT_MOVE_BYTES) {
+        *pos = used + (n ? n->num_blocks : 1);
+        spin_unlock_irqrestore(&a->lock, flags);
+        return *pos < a->total_blocks;
+    }
+
+    len = n->num_blocks;
+    memmove((char *)a->memory_pool + hole * a->block_size, n->ptr,
+            len * a->block_size);
+
+    /* отрезки могут перекрываться: сначала освобождаем старый, потом занимаем новый */
+    hash_del(&n->hash);
+    arena_mark(a, used, len, false);
+    arena_mark(a, hole, len, true);
+    for (i = hole; i < hole + len; i++)
+        if (test_and_clear_bit(i, a->zeroed))
+            atomic_long_dec(&a->zeroed_blocks);
+
+    n->start_block = hole;
+    n->ptr = (char *)a->memory_pool + hole * a->block_size;
+    hash_add(a->allocs, &n->hash, hole);
+
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    cs->moved_extents++;
+    cs->moved_bytes += len * a->block_size;
+    *pos = hole + len;
+    return true;
+}
+
+/* один проход; в cs — итоги именно этого прохода */
+static void pool_compact(unsigned int max_steps, struct compact_stats *cs)
+{
+    unsigned int i, n = nr_arenas(), steps = 0;
+
+    mutex_lock(&g_pool.compact_lock);
+    cs->frag_before = pool_frag();
+
+    for (i = 0; i < n; i++) {
+        size_t pos = 0;
+
+        while (arena_compact_step(g_pool.arenas[i], &pos, cs)) {
+            if (max_steps && ++steps >= max_steps)
+                goto out;
+            cond_resched();
+        }
+    }
+
+out:
+    cs->frag_after = pool_frag();
+    spin_lock(&g_pool.compact_stats_lock);
+    g_pool.compact.passes++;
+    g_pool.compact.moved_extents += cs->moved_extents;
+    g_pool.compact.moved_bytes += cs->moved_bytes;
+    g_pool.compact.frag_before = cs->frag_before;
+    g_pool.compact.frag_after = cs->frag_after;
+    spin_unlock(&g_pool.compact_stats_lock);
+    mutex_unlock(&g_pool.compact_lock);
+
+    if (cs->moved_bytes)
+        pool_kick_zero();
+
+    trace_kalloc_compact(cs->moved_extents, cs->moved_bytes,
+                         cs->frag_before, cs->frag_after);
+}
+
+int allocator_compact(unsigned int max_steps)
+{
+    struct compact_stats cs = { 0 };
+
+    pool_compact(max_steps, &cs);
+    return cs.moved_extents;
+}
+
+static void pool_compact_work(struct work_struct *work)
+{
+    struct compact_stats cs = { 0 };
+
+    pool_compact(COMPACT_BG_STEPS, &cs);
+
+    /* проход помог: дальше двигаем сразу, иначе ждём COMPACT_BACKOFF */
+    if (cs.moved_extents && cs.frag_after < cs.frag_before) {
+        if (cs.frag_after >= g_pool.compact_threshold)
+            queue_work(system_unbound_wq, &g_pool.compact_work);
+    } else {
+        WRITE_ONCE(g_pool.compact_retry, jiffies + COMPACT_BACKOFF);
+    }
+}
+
+/* освободить всё, что выделено от имени owner (закрытие файла устройства) */
+void allocator_free_all_owned(const void *owner)
+{
+    struct alloc_node *n;
+    struct hlist_node *tmp;
+    HLIST_HEAD(dead);
+    unsigned long flags;
+    unsigned int i, nr = nr_arenas();
+    int bkt;
+
+    /* у ядра (owner == NULL) общий учёт, его чистит только allocator_cleanup */
+    if (!owner)
+        return;
+
+    for (i = 0; i < nr; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        spin_lock_irqsave(&a->lock, flags);
+        hash_for_each_safe(a->allocs, bkt, tmp, n, hash) {
+            if (n->owner != owner)
+                continue;
+            arena_mark(a, n->start_block, n->num_blocks, false);
+            hash_del(&n->hash);
+            hlist_add_head(&n->hash, &dead);
+        }
+        spin_unlock_irqrestore(&a->lock, flags);
+    }
+
+    if (hlist_empty(&dead))
+        return;
+
+    hlist_for_each_entry_safe(n, tmp, &dead, hash)
+        kfree(n);
+    pool_kick_zero();
+}
+
+static struct memory_allocator *offset_to_arena(u64 off)
+{
+    unsigned int i, n = nr_arenas();
+
+    for (i = 0; i < n; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        if (off >= a->dev_offset && off < a->dev_offset + a->pool_bytes)
+            return a;
+    }
+
+    return NULL;
+}
+
+int allocator_ptr_to_offset(const void *ptr, u64 *off_out)
+{
+    struct memory_allocator *a;
+    size_t block;
+
+    if (!off_out || ptr_to_block((void *)ptr, &a, &block) != ALLOC_OK)
+        return ALLOC_INVALID;
+
+    *off_out = a->dev_offset + ((uintptr_t)ptr - (uintptr_t)a->memory_pool);
+    return ALLOC_OK;
+}
+
+/* адрес в ядре по смещению устройства: так экстент видят потребители в ядре */
+void *allocator_offset_to_ptr(u64 off)
+{
+    struct memory_allocator *a = offset_to_arena(off);
+
+    if (!a)
+        return NULL;
+
+    return (char *)a->memory_pool + (off - a->dev_offset);
+}
+
+struct page *allocator_offset_to_page(u64 off)
+{
+    void *p = allocator_offset_to_ptr(off);
+
+    if (!p)
+        return NULL;
+
+    /* непрерывная арена лежит в линейном отображении, а не в vmalloc */
+    return is_vmalloc_addr(p) ? vmalloc_to_page(p) : virt_to_page(p);
+}
+
+/*
+ * Разрешить mmap экстента, который начинается ровно с off и принадлежит
+ * owner. Возвращает cookie для allocator_map_hold/put: пока счётчик
+ * отображений не ноль, экстент нельзя освободить.
+ */
+void *allocator_map_get(u64 off, size_t len, const void *owner)
+{
+    struct memory_allocator *a = offset_to_arena(off);
+    struct alloc_node *n;
+    unsigned long flags;
+    u64 rel;
+
+    if (!a || !len)
+        return NULL;
+
+    rel = off - a->dev_offset;
+    if (rel % a->block_size)
+        return NULL;
+
+    spin_lock_irqsave(&a->lock, flags);
+    n = arena_find_locked(a, rel / a->block_size);
+    if (!n || n->page || n->owner != owner ||
+        len > n->num_blocks * a->block_size) {
+        spin_unlock_irqrestore(&a->lock, flags);
+        return NULL;
+    }
+    n->map_count++;
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    return n;
+}
+
+void allocator_map_hold(void *cookie)
+{
+    struct alloc_node *n = cookie;
+    unsigned long flags;
+
+    spin_lock_irqsave(&n->arena->lock, flags);
+    n->map_count++;
+    spin_unlock_irqrestore(&n->arena->lock, flags);
+}
+
+void allocator_map_put(void *cookie)
+{
+    struct alloc_node *n = cookie;
+    unsigned long flags;
+
+    spin_lock_irqsave(&n->arena->lock, flags);
+    n->map_count--;
+    spin_unlock_irqrestore(&n->arena->lock, flags);
+}
+
+int allocator_node_stats(int nid, struct node_stats *out)
+{
+    unsigned long flags;
+    unsigned int i, n = nr_arenas();
+
+    if (!out)
+        return ALLOC_INVALID;
+
+    memset(out, 0, sizeof(*out));
+
+    /* арены без узла (numa=0) ни к одному узлу не относятся */
+    for (i = 0; i < n; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        if (a->nid != nid)
+            continue;
+
+        spin_lock_irqsave(&a->lock, flags);
+        out->free_blocks += a->free_blocks;
+        spin_unlock_irqrestore(&a->lock, flags);
+
+        out->nr_arenas++;
+        out->total_blocks += a->total_blocks;
+        out->local_allocs += atomic_long_read(&a->local_allocs);
+        out->remote_allocs += atomic_long_read(&a->remote_allocs);
+    }
+
+    return ALLOC_OK;
+}
+
+struct stats_info allocator_get_stats(void)
+{
+    struct stats_info s;
+    unsigned long flags;
+    size_t free_blocks = 0, largest_run = 0;
+    unsigned int i, n = nr_arenas();
+
+    memset(&s, 0, sizeof(s));
+
+    s.nr_arenas = n;
+    s.block_size = g_pool.block_size;
+    s.policy = g_pool.policy;
+    s.backing = g_pool.backing;
+    s.prezero = g_pool.prezero;
+    s.realloc_in_place = atomic_long_read(&g_pool.realloc_in_place);
+    s.realloc_moved = atomic_long_read(&g_pool.realloc_moved);
+    s.compact_threshold = g_pool.compact_threshold;
+
+    /* compact_lock держит весь проход, итоги — под отдельным коротким локом */
+    spin_lock(&g_pool.compact_stats_lock);
+    s.compact = g_pool.compact;
+    spin_unlock(&g_pool.compact_stats_lock);
+
+    /*
+     * Счётчики арен ведутся в alloc/free, поэтому здесь только их сумма;
+     * самый длинный отрезок пересчитывается лишь по изменённым сегментам.
+     */
+    for (i = 0; i < n; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        spin_lock_irqsave(&a->lock, flags);
+        free_blocks += a->free_blocks;
+        largest_run = max(largest_run, arena_largest_free(a));
+        if (a->free_tree)
+            s.free_extents += a->free_tree->nr_extents;
+        s.zeroed_blocks += atomic_long_read(&a->zeroed_blocks);
+        s.small_blocks += a->sc_blocks;
+        s.small_bytes += a->sc_bytes;
+        for (int c = 0; c < SC_NR_CLASSES; c++)
+            s.small_objects += a->classes[c].objects;
+        spin_unlock_irqrestore(&a->lock, flags);
+
+        s.total_blocks += a->total_blocks;
+
+        if (a->backing == ALLOC_BACKING_CONTIG)
+            s.nr_contig++;
+        else if (a->backing == ALLOC_BACKING_HUGE)
+            s.nr_huge++;
+        else
+            s.nr_vmalloc++;
+    }
+
+    s.total_memory = s.total_blocks * g_pool.block_size;
+    s.free_blocks = free_blocks;
+    s.allocated_blocks = s.total_blocks - free_blocks;
+
+    s.free_memory = free_blocks * g_pool.block_size;
+    s.allocated_memory = s.allocated_blocks * g_pool.block_size;
+
+    /* свободные отрезки разных арен не сливаются, берём самый длинный */
+    s.fragmentation_percent = frag_percent(largest_run, free_blocks);
+
+    return s;
+}
+
+size_t allocator_block_size(void)
+{
+    return g_pool.block_size;
+}
+
+const char *allocator_policy_name(enum alloc_policy policy)
+{
+    return policy == ALLOC_POLICY_BEST_FIT ? "best_fit" : "first_fit";
+}
+
+const char *allocator_backing_name(enum alloc_backing backing)
+{
+    switch (backing) {
+    case ALLOC_BACKING_CONTIG:
+        return "contig";
+    case ALLOC_BACKING_HUGE:
+        return "huge";
+    default:
+        return "vmalloc";
+    }
+}
+
+/* сверить одну арену; shadow — нулевой bitmap на total_blocks бит */
+static size_t arena_verify(struct memory_allocator *a, unsigned long *shadow)
+{
+    struct alloc_node *n;
+    unsigned long flags;
+    size_t i, free_blocks = 0, bad = 0;
+    int bkt;
+
+    spin_lock_irqsave(&a->lock, flags);
+
+    /* каждая аллокация (и slab-страница) занимает свои блоки, без наложений */
+    hash_for_each(a->allocs, bkt, n, hash) {
+        if (n->start_block + n->num_blocks > a->total_blocks) {
+            bad++;
+            continue;
+        }
+        for (i = n->start_block; i < n->start_block + n->num_blocks; i++)
+            if (__test_and_set_bit(i, shadow))
+                bad++;
+    }
+
+    for (i = 0; i < a->total_blocks; i++) {
+        if (bm_test(a->bitmap, i) != test_bit(i, shadow))
+            bad++;
+        if (!bm_test(a->bitmap, i))
+            free_blocks++;
+    }
+
+    if (free_blocks != a->free_blocks)
+        bad++;
+
+    spin_unlock_irqrestore(&a->lock, flags);
+    return bad;
+}
+
+int allocator_verify(void)
+{
+    unsigned int i, n = nr_arenas();
+    size_t bad = 0;
+
+    for (i = 0; i < n; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+        unsigned long *shadow = bitmap_zalloc(a->total_blocks, GFP_KERNEL);
+
+        if (!shadow)
+            return ALLOC_NOMEM;
+
+        bad += arena_verify(a, shadow);
+        bitmap_free(shadow);
+    }
+
+    if (bad)
+        pr_err("verify: %zu mismatches between bitmap and allocations\n", bad);
+    return min_t(size_t, bad, INT_MAX);
+}
+
+int allocator_map_extent(unsigned int arena, size_t block,
+                         struct alloc_map_extent *out)
+{
+    struct memory_allocator *a;
+    struct alloc_node *n;
+    unsigned long flags;
+    size_t end;
+
+    for (;; arena++, block = 0) {
+        if (arena >= nr_arenas())
+            return ALLOC_NOT_FOUND;
+        a = g_pool.arenas[arena];
+        if (block < a->total_blocks)
+            break;
+    }
+
+    out->arena = arena;
+    out->nid = a->nid;
+    out->start = block;
+    out->handle = 0;
+
+    spin_lock_irqsave(&a->lock, flags);
+
+    end = bitmap_next_change(a->bitmap, a->total_blocks, block);
+
+    if (!bm_test(a->bitmap, block)) {
+        out->owner = ALLOC_MAP_FREE;
+    } else if ((n = arena_find_locked(a, block))) {
+        end = min(end, block + n->num_blocks);
+        if (n->page)
+            out->owner = ALLOC_MAP_SLAB;
+        else if (n->handle)
+            out->owner = ALLOC_MAP_HANDLE;
+        else if (n->owner)
+            out->owner = ALLOC_MAP_DEV;
+        else
+            out->owner = ALLOC_MAP_KERNEL;
+        out->handle = n->handle;
+    } else {
+        /* чтение попало в середину аллокации, сдвинутой между шагами обхода */
+        out->owner = ALLOC_MAP_KERNEL;
+    }
+
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    out->blocks = end - block;
+    return ALLOC_OK;
+}
+
+/* по строке на арену; bitmap_to_string сам обрезает вывод под out_sz */
+int allocator_bitmap_string(char *out, size_t out_sz)
+{
+    unsigned long flags;
+    unsigned int i, n = nr_arenas();
+    size_t pos = 0;
+    int ret;
+
+    for (i = 0; i < n && out_sz - pos >= 4; i++) {
+        struct memory_allocator *a = g_pool.arenas[i];
+
+        spin_lock_irqsave(&a->lock, flags);
+        ret = bitmap_to_string(a->bitmap, a->total_blocks,
+                               out + pos, out_sz - pos);
+        spin_unlock_irqrestore(&a->lock, flags);
+
+        if (ret < 0)
+            return ret;
+        pos += ret;
+    }
 
-    return bitmap_to_string(snapshot, TOTAL_BLOCKS, out, out_sz);
+    return (int)pos;
 }
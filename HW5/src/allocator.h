@@ -7,6 +7,51 @@
 #define ALLOC_NOMEM     -1
 #define ALLOC_INVALID   -2
 #define ALLOC_NOT_FOUND -3
+#define ALLOC_BUSY      -4      /* экстент отображён в userspace */
+
+/* флаги allocator_alloc_owned */
+#define ALLOC_F_BLOCKS  0x1     /* целыми блоками, даже если влезает в size-класс */
+#define ALLOC_F_NOZERO  0x2     /* не обнулять: вызывающий сам перезапишет всё */
+
+#define ALLOC_MAX_ARENAS      64
+#define ALLOC_MAX_BLOCK_SIZE  (2u * 1024u * 1024u)  /* 2 MiB */
+
+/* как искать свободный отрезок в арене */
+enum alloc_policy {
+    ALLOC_POLICY_FIRST_FIT,     /* первый подходящий по bitmap */
+    ALLOC_POLICY_BEST_FIT,      /* наименьший подходящий по дереву экстентов */
+};
+
+/*
+ * Чем подкреплена арена. Запрошенный вариант может не получиться:
+ * contig -> huge -> vmalloc, фактический виден в stats.
+ */
+enum alloc_backing {
+    ALLOC_BACKING_VMALLOC,      /* vmalloc без обнуления, страницы по 4 KiB */
+    ALLOC_BACKING_HUGE,         /* vmalloc_huge, отображение по 2 MiB */
+    ALLOC_BACKING_CONTIG,       /* физически непрерывно, линейное отображение */
+};
+
+/* параметры загрузки (см. main.c) */
+struct allocator_config {
+    size_t pool_size;           /* размер начальной арены и шаг роста */
+    size_t block_size;          /* степень двойки, PAGE_SIZE..2 MiB */
+    size_t max_pool_size;       /* потолок пула с учётом роста (0 = без роста) */
+    enum alloc_policy policy;
+    enum alloc_backing backing;
+    bool prezero;               /* обнулять свободные блоки в фоне */
+    bool numa;                  /* по арене на каждый online-узел */
+    unsigned int compact_threshold; /* % фрагментации для фонового уплотнения, 0 = выкл */
+};
+
+/* итоги уплотнения: сколько перенесено за всё время и последний проход */
+struct compact_stats {
+    unsigned int passes;
+    size_t moved_extents;
+    size_t moved_bytes;
+    size_t frag_before;         /* фрагментация пула до и после последнего прохода */
+    size_t frag_after;
+};
 
 struct stats_info {
     size_t total_blocks;
@@ -16,17 +61,183 @@ struct stats_info {
     size_t free_memory;
     size_t allocated_memory;
     size_t fragmentation_percent;
+
+    unsigned int nr_arenas;
+    size_t block_size;
+    enum alloc_policy policy;
+    size_t free_extents;        /* узлов в дереве best-fit (0 при first-fit) */
+
+    /* запрошенная подложка и сколько арен что получили на деле */
+    enum alloc_backing backing;
+    unsigned int nr_contig;
+    unsigned int nr_huge;
+    unsigned int nr_vmalloc;
+
+    /* свободные блоки, уже обнулённые заранее: их alloc отдаёт без memset */
+    bool prezero;
+    size_t zeroed_blocks;
+
+    /* allocator_realloc: сколько раз обошлось без переноса */
+    size_t realloc_in_place;
+    size_t realloc_moved;
+
+    unsigned int compact_threshold;
+    struct compact_stats compact;
+
+    /* мелкие объекты размерных классов */
+    size_t small_blocks;        /* блоков отдано под slab-страницы */
+    size_t small_objects;       /* живых объектов */
+    size_t small_bytes;         /* байт в живых объектах (по размеру класса) */
 };
 
-int allocator_init(void);
+/*
+ * Память пула при загрузке не обнуляется. allocator_alloc* отдают
+ * обнулённую память (если нет ALLOC_F_NOZERO): блок чистится при первой
+ * выдаче, если его ещё не обнулила фоновая работа.
+ */
+int allocator_init(const struct allocator_config *cfg);
 void allocator_cleanup(void);
 
+/* добавить арену в bytes байт (0 = размер pool_size) */
+int allocator_grow(size_t bytes);
+
 void *allocator_alloc(size_t bytes);
 int allocator_free(void *ptr);
 
+/*
+ * Начало выделенной памяти кратно align (степень двойки, 0 = как обычно).
+ * Блоки выдаются с границы страницы, мелкие объекты — по размеру класса.
+ */
+void *allocator_alloc_aligned(size_t bytes, size_t align);
+
+/*
+ * Новый размер аллокации ядра: на месте, если возможно, иначе перенос с
+ * копированием. NULL — не вышло, ptr остаётся действительным.
+ */
+void *allocator_realloc(void *ptr, size_t new_bytes);
+
+/*
+ * Аллокации от имени владельца (для /dev/kernel_alloc владелец — struct file).
+ * Освободить экстент может только его владелец; allocator_alloc/free
+ * работают с владельцем NULL.
+ */
+void *allocator_alloc_owned(size_t bytes, size_t align, unsigned int flags,
+                            const void *owner);
+int allocator_free_owned(void *ptr, const void *owner);
+void allocator_free_all_owned(const void *owner);
+
+/*
+ * Перемещаемые экстенты (только для ядра). Уплотнение может сдвинуть такой
+ * экстент, поэтому адрес берётся через pin и действителен до unpin;
+ * закреплённый экстент не двигается. Освобождается только по handle.
+ */
+int allocator_handle_alloc(size_t bytes, u32 *handle_out);
+void *allocator_handle_pin(u32 handle);
+void allocator_handle_unpin(u32 handle);
+int allocator_handle_free(u32 handle);
+
+/*
+ * Сдвинуть перемещаемые экстенты к началу арен. Каждый шаг ограничен
+ * (просмотр и перенос под локом арены), между шагами лок отпускается.
+ * max_steps = 0 — до конца прохода. Возвращает число перенесённых экстентов.
+ */
+int allocator_compact(unsigned int max_steps);
+
+/* смещения устройства: арены лежат подряд, смещение = handle для userspace */
+struct page;
+int allocator_ptr_to_offset(const void *ptr, u64 *off_out);
+void *allocator_offset_to_ptr(u64 off);
+struct page *allocator_offset_to_page(u64 off);
+
+void *allocator_map_get(u64 off, size_t len, const void *owner);
+void allocator_map_hold(void *cookie);
+void allocator_map_put(void *cookie);
+
 struct stats_info allocator_get_stats(void);
 
+/* размер блока, общий для всех арен пула: без обхода арен, как в stats */
+size_t allocator_block_size(void);
+
+/* сводка по аренам NUMA-узла; remote — выдачи из них вызывающим с других узлов */
+struct node_stats {
+    unsigned int nr_arenas;
+    size_t total_blocks;
+    size_t free_blocks;
+    size_t local_allocs;
+    size_t remote_allocs;
+};
+
+int allocator_node_stats(int nid, struct node_stats *out);
+
+/* кто держит экстент карты пула */
+enum alloc_map_owner {
+    ALLOC_MAP_FREE,
+    ALLOC_MAP_KERNEL,
+    ALLOC_MAP_DEV,              /* экстент открытого /dev/kernel_alloc */
+    ALLOC_MAP_SLAB,             /* страница мелких объектов */
+    ALLOC_MAP_HANDLE,           /* перемещаемый экстент */
+};
+
+struct alloc_map_extent {
+    unsigned int arena;
+    int nid;
+    size_t start;               /* в блоках от начала арены */
+    size_t blocks;
+    enum alloc_map_owner owner;
+    u32 handle;                 /* для ALLOC_MAP_HANDLE */
+};
+
+/*
+ * Экстент карты, начинающийся с блока block арены arena (или первый
+ * экстент следующей арены, если block за концом). Свободные блоки идут
+ * одним отрезком, занятые — по аллокациям. Лок арены берётся на один
+ * экстент, поэтому обход целиком не атомарен. ALLOC_NOT_FOUND — арены кончились.
+ */
+int allocator_map_extent(unsigned int arena, size_t block,
+                         struct alloc_map_extent *out);
+
+/*
+ * Проверка согласованности: bitmap каждой арены совпадает с блоками живых
+ * аллокаций, аллокации не перекрываются, счётчик свободных блоков верен.
+ * Возвращает число расхождений (0 — всё сходится) или ALLOC_NOMEM.
+ */
+int allocator_verify(void);
+
 /* для params.c */
 int allocator_bitmap_string(char *out, size_t out_sz);
+const char *allocator_policy_name(enum alloc_policy policy);
+const char *allocator_backing_name(enum alloc_backing backing);
+
+/*
+ * Прогнать одну и ту же синтетическую трассу alloc/free через временные
+ * арены first-fit и best-fit и описать фрагментацию и задержки в out.
+ */
+int allocator_replay(unsigned int ops, size_t blocks, char *out, size_t out_sz);
+
+/*
+ * Случайный и последовательный проход по временным аренам в bytes байт
+ * с каждой подложкой; пропускная способность и фактическая подложка в out.
+ */
+int allocator_access_bench(size_t bytes, unsigned int accesses,
+                           char *out, size_t out_sz);
+
+/*
+ * Нагрузка из threads потоков, привязанных к CPU по кругу: duration_ms
+ * каждый выделяет и освобождает в slots ячейках через allocator_alloc/free.
+ * Размеры лог-равномерно до max_bytes, hot_percent операций идёт на
+ * короткоживущую восьмую часть ячеек. В out — пропускная способность,
+ * хвосты задержек, фрагментация и итог allocator_verify.
+ */
+#define STRESS_MAX_THREADS 64
+
+struct stress_config {
+    unsigned int threads;
+    unsigned int duration_ms;
+    unsigned int slots;
+    size_t max_bytes;
+    unsigned int hot_percent;
+};
+
+int allocator_stress(const struct stress_config *cfg, char *out, size_t out_sz);
 
 #endif
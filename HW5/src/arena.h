@@ -0,0 +1,106 @@
+#ifndef KERNEL_ALLOC_ARENA_H
+#define KERNEL_ALLOC_ARENA_H
+
+/* внутреннее устройство арены: allocator.c и служебные модули (replay.c) */
+
+#include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/hashtable.h>
+#include <linux/atomic.h>
+
+#include "allocator.h"
+#include "bitmap.h"
+#include "extent_tree.h"
+#include "size_class.h"
+
+#define ALLOC_HASH_BITS 10
+
+/* одна арена: собственный пул, bitmap и лок */
+struct memory_allocator {
+    unsigned char *bitmap;
+    void *memory_pool;          /* выровнен на блок */
+    void *pool_base;            /* как выделен: vmalloc-пул бывает сдвинут */
+    size_t total_blocks;
+    size_t block_size;
+    spinlock_t lock;
+
+    unsigned int id;
+    size_t pool_bytes;
+    enum alloc_backing backing; /* фактическая, после отката */
+    int nid;                    /* узел памяти пула, NUMA_NO_NODE — любой */
+    u64 dev_offset;             /* начало арены в адресах /dev/kernel_alloc */
+
+    /* живые аллокации и slab-страницы по номеру первого блока */
+    DECLARE_HASHTABLE(allocs, ALLOC_HASH_BITS);
+
+    /* мелкие запросы: частично занятые slab-страницы по классам */
+    struct size_class classes[SC_NR_CLASSES];
+    size_t sc_blocks;
+    size_t sc_bytes;
+
+    /*
+     * Статистика ведётся на лету под тем же локом: счётчик свободных блоков
+     * точный, самый длинный свободный отрезок пересчитывается лениво и
+     * только по сегментам, которые менялись с прошлого чтения.
+     */
+    size_t free_blocks;
+    struct bitmap_seg *segs;
+    unsigned char *seg_dirty;   /* 1 бит на сегмент */
+    bool runs_dirty;
+    size_t largest_free;
+
+    /*
+     * 1 = блок свободен и уже обнулён. Биты атомарные: выдающий их снимает
+     * уже после отпускания лока, когда обнуляет свои блоки. Счётчик
+     * меняется вместе с битом, чтобы статистика не обходила весь bitmap.
+     */
+    unsigned long *zeroed;
+    atomic_long_t zeroed_blocks;
+    size_t zeroing;             /* фон дочищает этот блок, SIZE_MAX — нет */
+    size_t zeroing_off;         /* сколько байт блока уже обнулено */
+
+    /* выдачи вызывающим с того же узла и с чужих (без лока) */
+    atomic_long_t local_allocs;
+    atomic_long_t remote_allocs;
+
+    /* best-fit: индекс свободных экстентов (NULL при first-fit) */
+    enum alloc_policy policy;
+    struct extent_tree *free_tree;
+};
+
+struct alloc_node {
+    struct hlist_node hash;
+    void *ptr;
+    size_t start_block;
+    size_t num_blocks;
+    struct sc_page *page;       /* != NULL: блок нарезан под объекты класса */
+    struct memory_allocator *arena;
+    const void *owner;          /* NULL = ядро, иначе открытый файл устройства */
+    unsigned int map_count;     /* сколько vma отображают экстент в userspace */
+    u32 handle;                 /* != 0: перемещаемый экстент, адрес — через pin */
+    unsigned int pin_count;     /* закреплён: уплотнение его не двигает */
+    struct rcu_head rcu;        /* handle-узлы освобождаются через kfree_rcu */
+};
+
+struct memory_allocator *arena_create(unsigned int id, size_t bytes,
+                                      size_t block_size,
+                                      enum alloc_policy policy,
+                                      enum alloc_backing backing, int nid);
+void arena_destroy(struct memory_allocator *a);
+
+/* лок арены берут сами */
+void *arena_alloc_blocks(struct memory_allocator *a, size_t need,
+                         size_t align, struct alloc_node *node,
+                         const void *owner, unsigned int flags);
+void arena_free_node(struct memory_allocator *a, struct alloc_node *node);
+
+/* под локом арены */
+size_t arena_largest_free(struct memory_allocator *a);
+
+/*
+ * Обнулить очередную порцию грязного свободного блока с *pos; false —
+ * дошли до конца арены. Лок берёт сама.
+ */
+bool arena_prezero_step(struct memory_allocator *a, size_t *pos);
+
+#endif
@@ -1,29 +1,10 @@
 // src/bitmap.c
 #include <linux/kernel.h>
 #include <linux/string.h>
+#include <linux/bitops.h>
+#include <asm/unaligned.h>
 #include "allocator.h"
-
-/* 0 = free, 1 = used */
-static inline int bm_test(const unsigned char *bm, size_t idx)
-{
-    size_t byte = idx / 8;
-    size_t bit = idx % 8;
-    return (bm[byte] >> bit) & 1;
-}
-
-static inline void bm_set(unsigned char *bm, size_t idx)
-{
-    size_t byte = idx / 8;
-    size_t bit = idx % 8;
-    bm[byte] |= (unsigned char)(1u << bit);
-}
-
-static inline void bm_clear(unsigned char *bm, size_t idx)
-{
-    size_t byte = idx / 8;
-    size_t bit = idx % 8;
-    bm[byte] &= (unsigned char)~(1u << bit);
-}
+#include "bitmap.h"
 
 /* first-fit: найти первую цепочку need свободных блоков */
 int bitmap_first_fit(const unsigned char *bm, size_t total_blocks,
@@ -60,6 +41,40 @@ int bitmap_first_fit(const unsigned char *bm, size_t total_blocks,
     return -ENOSPC;
 }
 
+/*
+ * Как first-fit, но отрезок может начинаться только с first + k * stride.
+ * Кандидат проверяется с конца: найденный занятый блок сразу отбрасывает
+ * все позиции сетки до него.
+ */
+int bitmap_aligned_fit(const unsigned char *bm, size_t total_blocks,
+                       size_t need, size_t first, size_t stride,
+                       size_t *start_out)
+{
+    size_t i = first;
+
+    if (!start_out || need == 0 || stride == 0 || need > total_blocks)
+        return -EINVAL;
+
+    while (i + need <= total_blocks) {
+        size_t j;
+
+        for (j = need; j > 0; j--) {
+            if (bm_test(bm, i + j - 1))
+                break;
+        }
+
+        if (j == 0) {
+            *start_out = i;
+            return 0;
+        }
+
+        /* занят блок i + j - 1: следующая позиция сетки за ним */
+        i = first + round_up(i + j - first, stride);
+    }
+
+    return -ENOSPC;
+}
+
 size_t bitmap_count_free(const unsigned char *bm, size_t total_blocks)
 {
     size_t i, free = 0;
@@ -94,6 +109,105 @@ size_t bitmap_largest_free_run(const unsigned char *bm, size_t total_blocks)
     return best;
 }
 
+/* пересчитать сводку одного сегмента; целые байты 0x00/0xff без разбора битов */
+void bitmap_seg_compute(const unsigned char *bm, size_t total_blocks,
+                        size_t seg, struct bitmap_seg *out)
+{
+    size_t i = seg * BITMAP_SEG_BLOCKS;
+    size_t end = min(i + BITMAP_SEG_BLOCKS, total_blocks);
+    unsigned int run = 0, longest = 0, prefix = 0;
+    bool in_prefix = true;
+
+    while (i < end) {
+        unsigned int step = 1, free_bits = 0;
+
+        if (i % 8 == 0 && i + 8 <= end &&
+            (bm[i / 8] == 0x00 || bm[i / 8] == 0xff)) {
+            step = 8;
+            free_bits = bm[i / 8] == 0x00 ? 8 : 0;
+        } else if (!bm_test(bm, i)) {
+            free_bits = 1;
+        }
+
+        if (free_bits) {
+            run += free_bits;
+        } else {
+            if (in_prefix) {
+                prefix = run;
+                in_prefix = false;
+            }
+            if (run > longest)
+                longest = run;
+            run = 0;
+        }
+        i += step;
+    }
+
+    if (run > longest)
+        longest = run;
+    out->prefix = in_prefix ? run : prefix;
+    out->suffix = run;
+    out->longest = longest;
+}
+
+/* самый длинный свободный отрезок по сводкам сегментов: O(число сегментов) */
+size_t bitmap_seg_longest(const struct bitmap_seg *segs, size_t total_blocks)
+{
+    size_t seg, nr = bitmap_nr_segs(total_blocks);
+    size_t run = 0, best = 0;
+
+    for (seg = 0; seg < nr; seg++) {
+        size_t len = min_t(size_t, BITMAP_SEG_BLOCKS,
+                           total_blocks - seg * BITMAP_SEG_BLOCKS);
+
+        /* целиком свободный сегмент продолжает текущий отрезок */
+        if (segs[seg].longest == len) {
+            run += len;
+            continue;
+        }
+
+        best = max(best, run + segs[seg].prefix);
+        best = max(best, (size_t)segs[seg].longest);
+        run = segs[seg].suffix;
+    }
+
+    return max(best, run);
+}
+
+/*
+ * Конец отрезка блоков в том же состоянии, что и блок start. Биты идут
+ * от младших к старшим внутри байта, поэтому 8 байт, прочитанные как
+ * little-endian слово, дают блоки подряд на любой архитектуре.
+ */
+size_t bitmap_next_change(const unsigned char *bm, size_t total_blocks,
+                          size_t start)
+{
+    bool used = bm_test(bm, start);
+    u64 fill = used ? ~0ull : 0;
+    size_t i = start + 1;
+
+    /* до границы байта по битам */
+    while (i < total_blocks && i % 8) {
+        if (bm_test(bm, i) != used)
+            return i;
+        i++;
+    }
+
+    /* дальше по 64 блока за раз */
+    while (i + 64 <= total_blocks) {
+        u64 diff = get_unaligned_le64(bm + i / 8) ^ fill;
+
+        if (diff)
+            return i + __ffs64(diff);
+        i += 64;
+    }
+
+    while (i < total_blocks && bm_test(bm, i) == used)
+        i++;
+
+    return min(i, total_blocks);
+}
+
 /* визуализация: [X..XX....] где X=занято .=свободно */
 int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
                      char *out, size_t out_sz)
@@ -106,19 +220,16 @@ int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
     out[pos++] = '[';
 
     for (i = 0; i < total_blocks; i++) {
-        if (pos + 2 >= out_sz) /* место под ']' и '\n' */
+        if (pos + 3 >= out_sz) /* место под ']', '\n' и '\0' */
             break;
 
         out[pos++] = bm_test(bm, i) ? 'X' : '.';
 
         /* небольшая группировка для читаемости */
-        if ((i + 1) % 32 == 0 && pos + 2 < out_sz)
+        if ((i + 1) % 32 == 0 && pos + 3 < out_sz)
             out[pos++] = ' ';
     }
 
-    if (pos + 2 >= out_sz)
-        pos = out_sz - 2;
-
     out[pos++] = ']';
     out[pos++] = '\n';
     out[pos] = '\0';
@@ -126,10 +237,3 @@ int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
     return (int)pos;
 }
 
-/* экспортируем символы для allocator.c */
-int bitmap_first_fit(const unsigned char *bm, size_t total_blocks,
-                     size_t need, size_t *start_out);
-size_t bitmap_count_free(const unsigned char *bm, size_t total_blocks);
-size_t bitmap_largest_free_run(const unsigned char *bm, size_t total_blocks);
-int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
-                     char *out, size_t out_sz);
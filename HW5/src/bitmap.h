@@ -0,0 +1,59 @@
+#ifndef KERNEL_ALLOC_BITMAP_H
+#define KERNEL_ALLOC_BITMAP_H
+
+#include <linux/types.h>
+
+/* 0 = free, 1 = used; бит idx лежит в байте idx / 8 */
+static inline int bm_test(const unsigned char *bm, size_t idx)
+{
+    size_t byte = idx / 8, bit = idx % 8;
+    return (bm[byte] >> bit) & 1;
+}
+
+static inline void bm_set(unsigned char *bm, size_t idx)
+{
+    size_t byte = idx / 8, bit = idx % 8;
+    bm[byte] |= (unsigned char)(1u << bit);
+}
+
+static inline void bm_clear(unsigned char *bm, size_t idx)
+{
+    size_t byte = idx / 8, bit = idx % 8;
+    bm[byte] &= (unsigned char)~(1u << bit);
+}
+
+/*
+ * Сводка по сегменту из BITMAP_SEG_BLOCKS блоков: свободные блоки в начале,
+ * в конце и самый длинный свободный отрезок внутри. По сводкам всех
+ * сегментов самый длинный отрезок bitmap собирается без прохода по битам.
+ */
+#define BITMAP_SEG_BLOCKS 512
+
+struct bitmap_seg {
+    unsigned int prefix;
+    unsigned int suffix;
+    unsigned int longest;
+};
+
+static inline size_t bitmap_nr_segs(size_t total_blocks)
+{
+    return (total_blocks + BITMAP_SEG_BLOCKS - 1) / BITMAP_SEG_BLOCKS;
+}
+
+/* функции из bitmap.c */
+int bitmap_first_fit(const unsigned char *bm, size_t total_blocks,
+                     size_t need, size_t *start_out);
+int bitmap_aligned_fit(const unsigned char *bm, size_t total_blocks,
+                       size_t need, size_t first, size_t stride,
+                       size_t *start_out);
+size_t bitmap_count_free(const unsigned char *bm, size_t total_blocks);
+size_t bitmap_largest_free_run(const unsigned char *bm, size_t total_blocks);
+void bitmap_seg_compute(const unsigned char *bm, size_t total_blocks,
+                        size_t seg, struct bitmap_seg *out);
+size_t bitmap_seg_longest(const struct bitmap_seg *segs, size_t total_blocks);
+size_t bitmap_next_change(const unsigned char *bm, size_t total_blocks,
+                          size_t start);
+int bitmap_to_string(const unsigned char *bm, size_t total_blocks,
+                     char *out, size_t out_sz);
+
+#endif
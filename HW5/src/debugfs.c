@@ -0,0 +1,359 @@
+// src/debugfs.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/cpumask.h>
+#include <linux/uaccess.h>
+
+#include "allocator.h"
+#include "debugfs.h"
+#include "hist.h"
+#include "kernel_alloc_uapi.h"
+
+/*
+ * Карта пула потоком экстентов: seq_file сам делит вывод на порции, а
+ * очередной экстент берётся под локом своей арены, без снимка bitmap.
+ * Позиция seq_file — номер экстента; курсор помнит, где остановились,
+ * чтобы продолжение чтения не проходило карту заново.
+ */
+struct map_iter {
+    loff_t index;               /* номер экстента в cur */
+    bool eof;                   /* за index экстентов нет */
+    struct alloc_map_extent cur;
+};
+
+static struct dentry *ka_debugfs_dir;
+
+static const char *const map_owner_names[] = {
+    [ALLOC_MAP_FREE] = "free",
+    [ALLOC_MAP_KERNEL] = "kernel",
+    [ALLOC_MAP_DEV] = "dev",
+    [ALLOC_MAP_SLAB] = "slab",
+    [ALLOC_MAP_HANDLE] = "handle",
+};
+
+static void *map_iter_reset(struct map_iter *it)
+{
+    it->index = 1;
+    it->eof = allocator_map_extent(0, 0, &it->cur) != ALLOC_OK;
+    return it->eof ? NULL : &it->cur;
+}
+
+/* экстент, следующий за it->cur; NULL — карта кончилась */
+static void *map_iter_advance(struct map_iter *it)
+{
+    it->index++;
+    it->eof = allocator_map_extent(it->cur.arena,
+                                   it->cur.start + it->cur.blocks,
+                                   &it->cur) != ALLOC_OK;
+    return it->eof ? NULL : &it->cur;
+}
+
+/* позиция 0 — заголовок, экстенты с 1 */
+static void *map_start(struct seq_file *m, loff_t *pos)
+{
+    struct map_iter *it = m->private;
+
+    if (*pos == 0)
+        return SEQ_START_TOKEN;
+
+    /* продолжение с того же места — обычный случай */
+    if (it->index == *pos)
+        return it->eof ? NULL : &it->cur;
+
+    /* иначе (lseek) с начала карты */
+    if (!map_iter_reset(it))
+        return NULL;
+
+    while (it->index < *pos) {
+        if (!map_iter_advance(it))
+            return NULL;
+    }
+
+    return &it->cur;
+}
+
+static void *map_next(struct seq_file *m, void *v, loff_t *pos)
+{
+    struct map_iter *it = m->private;
+
+    ++*pos;
+
+    if (v == SEQ_START_TOKEN)
+        return map_iter_reset(it);
+
+    return map_iter_advance(it);
+}
+
+static void map_stop(struct seq_file *m, void *v)
+{
+}
+
+static int map_show(struct seq_file *m, void *v)
+{
+    const struct alloc_map_extent *e = v;
+
+    if (v == SEQ_START_TOKEN) {
+        seq_puts(m, "arena node     start    blocks owner\n");
+        return 0;
+    }
+
+    seq_printf(m, "%5u %4d %9zu %9zu %s", e->arena, e->nid, e->start,
+               e->blocks, map_owner_names[e->owner]);
+    if (e->owner == ALLOC_MAP_HANDLE)
+        seq_printf(m, " %u", e->handle);
+    seq_putc(m, '\n');
+    return 0;
+}
+
+static int map_bin_show(struct seq_file *m, void *v)
+{
+    const struct alloc_map_extent *e = v;
+
+    if (v == SEQ_START_TOKEN) {
+        struct ka_map_header h = {
+            .magic = KA_MAP_MAGIC,
+            .version = KA_MAP_VERSION,
+            .block_size = allocator_block_size(),
+            .rec_size = sizeof(struct ka_map_rec),
+        };
+
+        seq_write(m, &h, sizeof(h));
+    } else {
+        struct ka_map_rec r = {
+            .start = e->start,
+            .blocks = e->blocks,
+            .arena = e->arena,
+            .handle = e->handle,
+            .nid = e->nid,
+            .owner = e->owner,
+        };
+
+        seq_write(m, &r, sizeof(r));
+    }
+
+    return 0;
+}
+
+static const struct seq_operations map_seq_ops = {
+    .start = map_start,
+    .next = map_next,
+    .stop = map_stop,
+    .show = map_show,
+};
+
+static const struct seq_operations map_bin_seq_ops = {
+    .start = map_start,
+    .next = map_next,
+    .stop = map_stop,
+    .show = map_bin_show,
+};
+
+static int map_open(struct inode *inode, struct file *file)
+{
+    return seq_open_private(file, &map_seq_ops, sizeof(struct map_iter));
+}
+
+static int map_bin_open(struct inode *inode, struct file *file)
+{
+    return seq_open_private(file, &map_bin_seq_ops, sizeof(struct map_iter));
+}
+
+static const struct file_operations map_fops = {
+    .owner = THIS_MODULE,
+    .open = map_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = seq_release_private,
+};
+
+static const struct file_operations map_bin_fops = {
+    .owner = THIS_MODULE,
+    .open = map_bin_open,
+    .read = seq_read,
+    .llseek = seq_lseek,
+    .release = seq_release_private,
+};
+
+/* hist: чтение — сводка по всем CPU, любая запись обнуляет */
+static int hist_show(struct seq_file *m, void *v)
+{
+    alloc_hist_show(m);
+    return 0;
+}
+
+static int hist_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, hist_show, NULL);
+}
+
+static ssize_t hist_write(struct file *file, const char __user *buf,
+                          size_t len, loff_t *ppos)
+{
+    alloc_hist_reset();
+    return len;
+}
+
+static const struct file_operations hist_fops = {
+    .owner = THIS_MODULE,
+    .open = hist_open,
+    .read = seq_read,
+    .write = hist_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int hist_enable_get(void *data, u64 *val)
+{
+    *val = alloc_hist_on();
+    return 0;
+}
+
+static int hist_enable_set(void *data, u64 val)
+{
+    alloc_hist_enable(val);
+    return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(hist_enable_fops, hist_enable_get, hist_enable_set,
+                         "%llu\n");
+
+/*
+ * Замеры: запись аргументов запускает прогон, чтение — отчёт последнего.
+ * Прогон идёт секундами; в параметре модуля он держал бы kernel_param_lock
+ * и все остальные параметры kernel_alloc (stats, hfree, ...) ждали бы его.
+ * Здесь ждут только другие замеры: общий пул они делят по очереди.
+ */
+struct bench_file {
+    const char *name;
+    int (*run)(const char *args, char *out, size_t out_sz);
+    char report[PAGE_SIZE];
+};
+
+static DEFINE_MUTEX(bench_lock);
+
+/* replay: "<ops> [blocks]" — одна синтетическая трасса через first-fit и best-fit */
+static int bench_replay(const char *args, char *out, size_t out_sz)
+{
+    unsigned int ops = 100000;
+    size_t blocks = 2560;
+
+    if (sscanf(args, "%u %zu", &ops, &blocks) < 1)
+        return ALLOC_INVALID;
+    return allocator_replay(ops, blocks, out, out_sz);
+}
+
+/* access_bench: "<KiB> [accesses]" — скорость доступа по подложкам */
+static int bench_access(const char *args, char *out, size_t out_sz)
+{
+    unsigned long kib = 64 * 1024;
+    unsigned int accesses = 1u << 22;
+
+    if (sscanf(args, "%lu %u", &kib, &accesses) < 1)
+        return ALLOC_INVALID;
+    return allocator_access_bench((size_t)kib * 1024, accesses, out, out_sz);
+}
+
+/* stress: "<threads> [ms] [slots] [max_bytes] [hot%]" — kthreads на общем пуле */
+static int bench_stress(const char *args, char *out, size_t out_sz)
+{
+    struct stress_config cfg = {
+        .threads = num_online_cpus(),
+        .duration_ms = 1000,
+        .slots = 256,
+        .max_bytes = 64 * 1024,
+        .hot_percent = 80,
+    };
+
+    if (sscanf(args, "%u %u %u %zu %u", &cfg.threads, &cfg.duration_ms,
+               &cfg.slots, &cfg.max_bytes, &cfg.hot_percent) < 1)
+        return ALLOC_INVALID;
+    return allocator_stress(&cfg, out, out_sz);
+}
+
+static struct bench_file bench_files[] = {
+    { .name = "replay", .run = bench_replay },
+    { .name = "access_bench", .run = bench_access },
+    { .name = "stress", .run = bench_stress },
+};
+
+static ssize_t bench_write(struct file *file, const char __user *ubuf,
+                           size_t len, loff_t *ppos)
+{
+    struct bench_file *b = file->private_data;
+    char args[64];
+    int ret;
+
+    if (len >= sizeof(args))
+        return -EINVAL;
+    if (copy_from_user(args, ubuf, len))
+        return -EFAULT;
+    args[len] = '\0';
+
+    mutex_lock(&bench_lock);
+    ret = b->run(args, b->report, sizeof(b->report));
+    if (ret < 0)
+        b->report[0] = '\0';
+    mutex_unlock(&bench_lock);
+
+    if (ret == ALLOC_INVALID)
+        return -EINVAL;
+    if (ret < 0)
+        return -ENOMEM;
+    return len;
+}
+
+static ssize_t bench_read(struct file *file, char __user *ubuf, size_t len,
+                          loff_t *ppos)
+{
+    struct bench_file *b = file->private_data;
+    ssize_t ret;
+
+    mutex_lock(&bench_lock);
+    ret = simple_read_from_buffer(ubuf, len, ppos, b->report,
+                                  strlen(b->report));
+    mutex_unlock(&bench_lock);
+    return ret;
+}
+
+static const struct file_operations bench_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .read = bench_read,
+    .write = bench_write,
+    .llseek = default_llseek,
+};
+
+/* debugfs только для отладки: ошибки создания не мешают загрузке модуля */
+void kernel_alloc_debugfs_init(void)
+{
+    unsigned int i;
+
+    /* owner записи map.bin — тот же номер, что и в enum alloc_map_owner */
+    BUILD_BUG_ON(KA_MAP_FREE != ALLOC_MAP_FREE ||
+                 KA_MAP_KERNEL != ALLOC_MAP_KERNEL ||
+                 KA_MAP_DEV != ALLOC_MAP_DEV ||
+                 KA_MAP_SLAB != ALLOC_MAP_SLAB ||
+                 KA_MAP_HANDLE != ALLOC_MAP_HANDLE);
+    BUILD_BUG_ON(sizeof(struct ka_map_rec) != 32);
+
+    ka_debugfs_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+    debugfs_create_file("map", 0400, ka_debugfs_dir, NULL, &map_fops);
+    debugfs_create_file("map.bin", 0400, ka_debugfs_dir, NULL, &map_bin_fops);
+    debugfs_create_file("hist", 0600, ka_debugfs_dir, NULL, &hist_fops);
+    debugfs_create_file_unsafe("hist_enable", 0600, ka_debugfs_dir, NULL,
+                               &hist_enable_fops);
+
+    for (i = 0; i < ARRAY_SIZE(bench_files); i++)
+        debugfs_create_file(bench_files[i].name, 0600, ka_debugfs_dir,
+                            &bench_files[i], &bench_fops);
+}
+
+void kernel_alloc_debugfs_exit(void)
+{
+    debugfs_remove(ka_debugfs_dir);
+}
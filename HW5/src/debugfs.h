@@ -0,0 +1,8 @@
+#ifndef KERNEL_ALLOC_DEBUGFS_H
+#define KERNEL_ALLOC_DEBUGFS_H
+
+/* /sys/kernel/debug/kernel_alloc (debugfs.c) */
+void kernel_alloc_debugfs_init(void);
+void kernel_alloc_debugfs_exit(void);
+
+#endif
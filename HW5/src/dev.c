@@ -0,0 +1,211 @@
+// src/dev.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include "allocator.h"
+#include "dev.h"
+#include "kernel_alloc_uapi.h"
+
+static int alloc_errno(int ret)
+{
+    switch (ret) {
+    case ALLOC_OK:
+        return 0;
+    case ALLOC_NOMEM:
+        return -ENOMEM;
+    case ALLOC_NOT_FOUND:
+        return -ENOENT;
+    case ALLOC_BUSY:
+        return -EBUSY;
+    default:
+        return -EINVAL;
+    }
+}
+
+/* экстенты устройства всегда целыми блоками: их можно отобразить через mmap */
+static int ka_do_alloc(struct file *file, struct ka_extent *e)
+{
+    unsigned int shift = e->flags & KA_EXT_ALIGN_MASK;
+    void *p;
+    u64 off;
+
+    if (!e->bytes || (e->flags & ~KA_EXT_ALIGN_MASK) ||
+        shift > KA_EXT_ALIGN_MAX)
+        return -EINVAL;
+
+    /* без ALLOC_F_NOZERO: экстент уходит в userspace, старые данные видны быть не должны */
+    p = allocator_alloc_owned(e->bytes, shift ? 1ul << shift : 0,
+                              ALLOC_F_BLOCKS, file);
+    if (!p)
+        return -ENOMEM;
+
+    allocator_ptr_to_offset(p, &off);
+    e->offset = off;
+    return 0;
+}
+
+static int ka_do_free(struct file *file, struct ka_extent *e)
+{
+    void *p = allocator_offset_to_ptr(e->offset);
+
+    if (!p)
+        return -EINVAL;
+
+    return alloc_errno(allocator_free_owned(p, file));
+}
+
+/* пакет из count элементов: у каждого свой result, ioctl падает только на копировании */
+static long ka_ioctl_batch(struct file *file, unsigned int cmd,
+                           struct ka_batch __user *ubatch)
+{
+    struct ka_batch b;
+    struct ka_extent *ext;
+    long ret = 0;
+    u32 i;
+
+    if (copy_from_user(&b, ubatch, sizeof(b)))
+        return -EFAULT;
+
+    if (!b.count || b.count > KA_BATCH_MAX)
+        return -EINVAL;
+
+    ext = kmalloc_array(b.count, sizeof(*ext), GFP_KERNEL);
+    if (!ext)
+        return -ENOMEM;
+
+    if (copy_from_user(ext, u64_to_user_ptr(b.extents),
+                       b.count * sizeof(*ext))) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    b.done = 0;
+    for (i = 0; i < b.count; i++) {
+        if (cmd == KA_IOC_ALLOC)
+            ext[i].result = ka_do_alloc(file, &ext[i]);
+        else
+            ext[i].result = ka_do_free(file, &ext[i]);
+
+        if (!ext[i].result)
+            b.done++;
+    }
+
+    /* выделенное, но не доставленное пользователю освободится при close */
+    if (copy_to_user(u64_to_user_ptr(b.extents), ext, b.count * sizeof(*ext)) ||
+        copy_to_user(ubatch, &b, sizeof(b)))
+        ret = -EFAULT;
+
+out:
+    kfree(ext);
+    return ret;
+}
+
+static long ka_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    switch (cmd) {
+    case KA_IOC_ALLOC:
+    case KA_IOC_FREE:
+        return ka_ioctl_batch(file, cmd, (struct ka_batch __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
+/* vma держит экстент: пока он отображён, KA_IOC_FREE вернёт -EBUSY */
+static void ka_vm_open(struct vm_area_struct *vma)
+{
+    allocator_map_hold(vma->vm_private_data);
+}
+
+static void ka_vm_close(struct vm_area_struct *vma)
+{
+    allocator_map_put(vma->vm_private_data);
+}
+
+/* страницы пула подставляются по первому обращению */
+static vm_fault_t ka_vm_fault(struct vm_fault *vmf)
+{
+    struct page *page;
+
+    page = allocator_offset_to_page((u64)vmf->pgoff << PAGE_SHIFT);
+    if (!page)
+        return VM_FAULT_SIGBUS;
+
+    get_page(page);
+    vmf->page = page;
+    return 0;
+}
+
+static const struct vm_operations_struct ka_vm_ops = {
+    .open = ka_vm_open,
+    .close = ka_vm_close,
+    .fault = ka_vm_fault,
+};
+
+/* mmap(offset = handle): только свой экстент, с его начала и не длиннее его */
+static int ka_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    u64 off = (u64)vma->vm_pgoff << PAGE_SHIFT;
+    size_t len = vma->vm_end - vma->vm_start;
+    void *cookie;
+
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+
+    cookie = allocator_map_get(off, len, file);
+    if (!cookie)
+        return -EINVAL;
+
+    vma->vm_private_data = cookie;
+    vma->vm_ops = &ka_vm_ops;
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+    return 0;
+}
+
+static int ka_release(struct inode *inode, struct file *file)
+{
+    allocator_free_all_owned(file);
+    return 0;
+}
+
+static const struct file_operations ka_fops = {
+    .owner = THIS_MODULE,
+    .unlocked_ioctl = ka_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .mmap = ka_mmap,
+    .release = ka_release,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice ka_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = KA_DEV_NAME,
+    .fops = &ka_fops,
+    .mode = 0600,
+};
+
+int kernel_alloc_dev_init(void)
+{
+    int ret = misc_register(&ka_misc);
+
+    if (ret) {
+        pr_err("misc_register failed: %d\n", ret);
+        return ret;
+    }
+
+    pr_info("dev: /dev/%s created\n", KA_DEV_NAME);
+    return 0;
+}
+
+void kernel_alloc_dev_exit(void)
+{
+    misc_deregister(&ka_misc);
+    pr_info("dev removed\n");
+}
@@ -0,0 +1,8 @@
+#ifndef KERNEL_ALLOC_DEV_H
+#define KERNEL_ALLOC_DEV_H
+
+/* /dev/kernel_alloc (dev.c) */
+int kernel_alloc_dev_init(void);
+void kernel_alloc_dev_exit(void);
+
+#endif
@@ -0,0 +1,222 @@
+// src/extent_tree.c
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/rbtree.h>
+
+#include "allocator.h"
+#include "extent_tree.h"
+
+static struct free_extent *node_get(struct extent_tree *t)
+{
+    struct free_extent *e = t->spare;
+
+    if (e)
+        t->spare = e->next_spare;
+    return e;
+}
+
+static void node_put(struct extent_tree *t, struct free_extent *e)
+{
+    e->next_spare = t->spare;
+    t->spare = e;
+}
+
+/* ключ (len, start): равные по длине упорядочены по адресу */
+static void len_insert(struct extent_tree *t, struct free_extent *e)
+{
+    struct rb_node **link = &t->by_len.rb_node, *parent = NULL;
+
+    while (*link) {
+        struct free_extent *cur = rb_entry(*link, struct free_extent, by_len);
+
+        parent = *link;
+        if (e->len < cur->len || (e->len == cur->len && e->start < cur->start))
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    rb_link_node(&e->by_len, parent, link);
+    rb_insert_color(&e->by_len, &t->by_len);
+}
+
+static void addr_insert(struct extent_tree *t, struct free_extent *e)
+{
+    struct rb_node **link = &t->by_addr.rb_node, *parent = NULL;
+
+    while (*link) {
+        struct free_extent *cur = rb_entry(*link, struct free_extent, by_addr);
+
+        parent = *link;
+        if (e->start < cur->start)
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    rb_link_node(&e->by_addr, parent, link);
+    rb_insert_color(&e->by_addr, &t->by_addr);
+}
+
+static void ext_insert(struct extent_tree *t, size_t start, size_t len)
+{
+    struct free_extent *e = node_get(t);
+
+    /* запас рассчитан на худший случай, сюда попасть нельзя */
+    if (WARN_ON_ONCE(!e))
+        return;
+
+    e->start = start;
+    e->len = len;
+    len_insert(t, e);
+    addr_insert(t, e);
+    t->nr_extents++;
+}
+
+static void ext_remove(struct extent_tree *t, struct free_extent *e)
+{
+    rb_erase(&e->by_len, &t->by_len);
+    rb_erase(&e->by_addr, &t->by_addr);
+    node_put(t, e);
+    t->nr_extents--;
+}
+
+/*
+ * Новые границы экстента. Соседи по адресу не пересекаются, поэтому
+ * порядок в by_addr сохраняется, переставлять приходится только by_len.
+ */
+static void ext_resize(struct extent_tree *t, struct free_extent *e,
+                       size_t start, size_t len)
+{
+    rb_erase(&e->by_len, &t->by_len);
+    e->start = start;
+    e->len = len;
+    len_insert(t, e);
+}
+
+/* экстент с наибольшим началом <= idx */
+static struct free_extent *addr_lookup_le(struct extent_tree *t, size_t idx)
+{
+    struct rb_node *node = t->by_addr.rb_node;
+    struct free_extent *best = NULL;
+
+    while (node) {
+        struct free_extent *e = rb_entry(node, struct free_extent, by_addr);
+
+        if (e->start <= idx) {
+            best = e;
+            node = node->rb_right;
+        } else {
+            node = node->rb_left;
+        }
+    }
+
+    return best;
+}
+
+int extent_tree_init(struct extent_tree *t, size_t total_blocks)
+{
+    size_t i, nr_nodes = total_blocks / 2 + 1;
+
+    t->by_len = RB_ROOT;
+    t->by_addr = RB_ROOT;
+    t->nr_extents = 0;
+    t->spare = NULL;
+
+    t->nodes = kvcalloc(nr_nodes, sizeof(*t->nodes), GFP_KERNEL);
+    if (!t->nodes)
+        return ALLOC_NOMEM;
+
+    for (i = 0; i < nr_nodes; i++)
+        node_put(t, &t->nodes[i]);
+
+    /* пустая арена — один свободный экстент на всё */
+    ext_insert(t, 0, total_blocks);
+    return ALLOC_OK;
+}
+
+void extent_tree_destroy(struct extent_tree *t)
+{
+    kvfree(t->nodes);
+    t->nodes = NULL;
+    t->spare = NULL;
+    t->by_len = RB_ROOT;
+    t->by_addr = RB_ROOT;
+}
+
+/* best-fit: наименьший экстент не короче need, при равенстве — с меньшим адресом */
+int extent_tree_best_fit(struct extent_tree *t, size_t need, size_t *start_out)
+{
+    struct rb_node *node = t->by_len.rb_node;
+    struct free_extent *best = NULL;
+
+    while (node) {
+        struct free_extent *e = rb_entry(node, struct free_extent, by_len);
+
+        if (e->len >= need) {
+            best = e;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    if (!best)
+        return -ENOSPC;
+
+    *start_out = best->start;
+    return 0;
+}
+
+/* блоки [start, start + len) заняты: вырезать их из свободного экстента */
+void extent_tree_reserve(struct extent_tree *t, size_t start, size_t len)
+{
+    struct free_extent *e = addr_lookup_le(t, start);
+    size_t end = start + len, e_end;
+
+    if (WARN_ON_ONCE(!e || e->start + e->len < end))
+        return;
+
+    e_end = e->start + e->len;
+
+    if (start == e->start && end == e_end) {
+        ext_remove(t, e);
+    } else if (start == e->start) {
+        ext_resize(t, e, end, e_end - end);
+    } else if (end == e_end) {
+        ext_resize(t, e, e->start, start - e->start);
+    } else {
+        /* середина: экстент распадается на два */
+        ext_resize(t, e, e->start, start - e->start);
+        ext_insert(t, end, e_end - end);
+    }
+}
+
+/* блоки [start, start + len) свободны: слить с соседями по адресу */
+void extent_tree_release(struct extent_tree *t, size_t start, size_t len)
+{
+    struct free_extent *prev = addr_lookup_le(t, start);
+    struct free_extent *next;
+    struct rb_node *rb;
+    bool merge_prev, merge_next;
+
+    rb = prev ? rb_next(&prev->by_addr) : rb_first(&t->by_addr);
+    next = rb ? rb_entry(rb, struct free_extent, by_addr) : NULL;
+
+    merge_prev = prev && prev->start + prev->len == start;
+    merge_next = next && next->start == start + len;
+
+    if (merge_prev && merge_next) {
+        size_t total = prev->len + len + next->len;
+
+        ext_remove(t, next);
+        ext_resize(t, prev, prev->start, total);
+    } else if (merge_prev) {
+        ext_resize(t, prev, prev->start, prev->len + len);
+    } else if (merge_next) {
+        ext_resize(t, next, start, next->len + len);
+    } else {
+        ext_insert(t, start, len);
+    }
+}
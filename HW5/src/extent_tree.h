@@ -0,0 +1,41 @@
+#ifndef KERNEL_ALLOC_EXTENT_TREE_H
+#define KERNEL_ALLOC_EXTENT_TREE_H
+
+#include <linux/types.h>
+#include <linux/rbtree.h>
+
+/*
+ * Индекс свободных экстентов арены для политики best-fit: одно дерево
+ * упорядочено по (длина, начало) для поиска наименьшего подходящего,
+ * второе — по началу, для слияния с соседями при освобождении.
+ * Bitmap остаётся источником истины, дерево повторяет его изменения.
+ */
+struct free_extent {
+    struct rb_node by_len;
+    struct rb_node by_addr;
+    size_t start;
+    size_t len;
+    struct free_extent *next_spare;
+};
+
+struct extent_tree {
+    struct rb_root by_len;
+    struct rb_root by_addr;
+    size_t nr_extents;
+
+    /*
+     * Узлы берутся из заранее выделенного запаса: свободных экстентов не
+     * больше total_blocks / 2 + 1, поэтому под спинлоком ничего не выделяем.
+     */
+    struct free_extent *nodes;
+    struct free_extent *spare;
+};
+
+int extent_tree_init(struct extent_tree *t, size_t total_blocks);
+void extent_tree_destroy(struct extent_tree *t);
+
+int extent_tree_best_fit(struct extent_tree *t, size_t need, size_t *start_out);
+void extent_tree_reserve(struct extent_tree *t, size_t start, size_t len);
+void extent_tree_release(struct extent_tree *t, size_t start, size_t len);
+
+#endif
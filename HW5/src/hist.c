@@ -0,0 +1,78 @@
+// src/hist.c
+#include <linux/kernel.h>
+#include <linux/cpumask.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "hist.h"
+
+DEFINE_STATIC_KEY_FALSE(alloc_hist_key);
+DEFINE_PER_CPU(struct alloc_hist, alloc_hist);
+
+static const char *const hist_names[ALLOC_HIST_NR] = {
+    [ALLOC_HIST_ALLOC_NS] = "alloc_ns",
+    [ALLOC_HIST_FREE_NS] = "free_ns",
+    [ALLOC_HIST_LOCK_NS] = "lock_ns",
+    [ALLOC_HIST_SCANNED] = "scanned_blocks",
+    [ALLOC_HIST_SIZE] = "size_bytes",
+};
+
+/* static_branch_enable/disable могут спать: только из контекста процесса */
+void alloc_hist_enable(bool on)
+{
+    if (on)
+        static_branch_enable(&alloc_hist_key);
+    else
+        static_branch_disable(&alloc_hist_key);
+}
+
+/* без синхронизации с пишущими: инкремент на соседнем CPU может потеряться */
+void alloc_hist_reset(void)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&alloc_hist, cpu), 0, sizeof(struct alloc_hist));
+}
+
+void alloc_hist_show(struct seq_file *m)
+{
+    struct alloc_hist *sum;
+    unsigned int k, b;
+    int cpu;
+
+    /* ~2 KiB, на стек не кладём */
+    sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+    if (!sum)
+        return;
+
+    for_each_possible_cpu(cpu) {
+        const struct alloc_hist *h = per_cpu_ptr(&alloc_hist, cpu);
+
+        for (k = 0; k < ALLOC_HIST_NR; k++)
+            for (b = 0; b < ALLOC_HIST_BUCKETS; b++)
+                sum->buckets[k][b] += READ_ONCE(h->buckets[k][b]);
+        for (k = 0; k < ALLOC_FAIL_NR; k++)
+            sum->fails[k] += READ_ONCE(h->fails[k]);
+    }
+
+    seq_printf(m, "enabled: %s\n", alloc_hist_on() ? "yes" : "no");
+    seq_printf(m, "fail: no_run=%llu no_free=%llu no_mem=%llu\n",
+               sum->fails[ALLOC_FAIL_NO_RUN], sum->fails[ALLOC_FAIL_NO_FREE],
+               sum->fails[ALLOC_FAIL_NO_MEM]);
+
+    /* только непустые корзины: "от до-не-включая  число" */
+    for (k = 0; k < ALLOC_HIST_NR; k++) {
+        seq_printf(m, "%s:\n", hist_names[k]);
+        for (b = 0; b < ALLOC_HIST_BUCKETS; b++) {
+            if (!sum->buckets[k][b])
+                continue;
+            seq_printf(m, "  %14llu %14llu %12llu\n",
+                       b ? 1ull << (b - 1) : 0, 1ull << b,
+                       sum->buckets[k][b]);
+        }
+    }
+
+    kfree(sum);
+}
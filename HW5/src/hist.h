@@ -0,0 +1,65 @@
+#ifndef KERNEL_ALLOC_HIST_H
+#define KERNEL_ALLOC_HIST_H
+
+#include <linux/types.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+
+/*
+ * Гистограммы горячего пути: по CPU, корзины по степеням двойки.
+ * Выключены по умолчанию; пока static key выключен, на пути остаётся
+ * только пустой переход.
+ */
+enum alloc_hist_kind {
+    ALLOC_HIST_ALLOC_NS,        /* весь вызов allocator_alloc_owned */
+    ALLOC_HIST_FREE_NS,         /* весь вызов allocator_free_owned */
+    ALLOC_HIST_LOCK_NS,         /* удержание лока арены при выдаче блоков */
+    ALLOC_HIST_SCANNED,         /* блоков bitmap, пройденных поиском */
+    ALLOC_HIST_SIZE,            /* размер запроса в байтах */
+    ALLOC_HIST_NR,
+};
+
+/* почему выдача не удалась */
+enum alloc_fail_cause {
+    ALLOC_FAIL_NO_RUN,          /* свободных блоков хватает, но не подряд */
+    ALLOC_FAIL_NO_FREE,         /* свободных блоков меньше, чем нужно */
+    ALLOC_FAIL_NO_MEM,          /* не выделились служебные структуры */
+    ALLOC_FAIL_NR,
+};
+
+/* корзина b: [2^(b-1), 2^b), в корзине 0 — нули */
+#define ALLOC_HIST_BUCKETS 40
+
+struct alloc_hist {
+    u64 buckets[ALLOC_HIST_NR][ALLOC_HIST_BUCKETS];
+    u64 fails[ALLOC_FAIL_NR];
+};
+
+DECLARE_STATIC_KEY_FALSE(alloc_hist_key);
+DECLARE_PER_CPU(struct alloc_hist, alloc_hist);
+
+static inline bool alloc_hist_on(void)
+{
+    return static_branch_unlikely(&alloc_hist_key);
+}
+
+static inline void alloc_hist_add(enum alloc_hist_kind kind, u64 val)
+{
+    unsigned int b = min_t(unsigned int, fls64(val), ALLOC_HIST_BUCKETS - 1);
+
+    this_cpu_inc(alloc_hist.buckets[kind][b]);
+}
+
+static inline void alloc_hist_fail(enum alloc_fail_cause cause)
+{
+    this_cpu_inc(alloc_hist.fails[cause]);
+}
+
+/* функции из hist.c */
+struct seq_file;
+void alloc_hist_enable(bool on);
+void alloc_hist_reset(void);
+void alloc_hist_show(struct seq_file *m);
+
+#endif
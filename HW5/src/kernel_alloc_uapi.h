@@ -0,0 +1,75 @@
+#ifndef KERNEL_ALLOC_UAPI_H
+#define KERNEL_ALLOC_UAPI_H
+
+/* общий для модуля и userspace интерфейс /dev/kernel_alloc */
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define KA_DEV_NAME     "kernel_alloc"
+#define KA_BATCH_MAX    64
+
+/*
+ * Один элемент пакета. ALLOC: bytes на входе, offset на выходе.
+ * FREE: offset на входе. result — 0 или -errno для этого элемента.
+ * offset — handle экстента и одновременно смещение для mmap.
+ */
+struct ka_extent {
+    __u64 bytes;
+    __u64 offset;
+    __s32 result;
+    __u32 flags;
+};
+
+/*
+ * ka_extent.flags для ALLOC: младшие биты — log2 выравнивания адреса
+ * экстента в ядре (0 = по блоку), например KA_EXT_ALIGN(21) для 2 MiB.
+ */
+#define KA_EXT_ALIGN_MASK   0x3f
+#define KA_EXT_ALIGN_MAX    30
+#define KA_EXT_ALIGN(shift) ((__u32)(shift) & KA_EXT_ALIGN_MASK)
+
+struct ka_batch {
+    __u64 extents;              /* указатель на struct ka_extent[count] */
+    __u32 count;                /* 1..KA_BATCH_MAX */
+    __u32 done;                 /* сколько элементов завершилось успешно */
+};
+
+/*
+ * Двоичная карта пула, debugfs kernel_alloc/map.bin: заголовок, затем
+ * записи ka_map_rec до конца файла. Соседние свободные блоки арены —
+ * одна запись, занятые — запись на аллокацию.
+ */
+#define KA_MAP_MAGIC    0x504d414bu     /* "KAMP" */
+#define KA_MAP_VERSION  1
+
+struct ka_map_header {
+    __u32 magic;
+    __u32 version;
+    __u32 block_size;
+    __u32 rec_size;             /* sizeof(struct ka_map_rec) */
+};
+
+enum {
+    KA_MAP_FREE,
+    KA_MAP_KERNEL,
+    KA_MAP_DEV,
+    KA_MAP_SLAB,
+    KA_MAP_HANDLE,
+};
+
+struct ka_map_rec {
+    __u64 start;                /* в блоках от начала арены */
+    __u64 blocks;
+    __u32 arena;
+    __u32 handle;               /* для KA_MAP_HANDLE */
+    __s16 nid;
+    __u8 owner;                 /* KA_MAP_* */
+    __u8 pad[5];
+};
+
+#define KA_IOC_MAGIC    'k'
+#define KA_IOC_ALLOC    _IOWR(KA_IOC_MAGIC, 1, struct ka_batch)
+#define KA_IOC_FREE     _IOWR(KA_IOC_MAGIC, 2, struct ka_batch)
+
+#endif
@@ -4,24 +4,100 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 
 #include "allocator.h"
+#include "debugfs.h"
+#include "dev.h"
+
+/* геометрия пула, задаётся при загрузке */
+static ulong pool_size = 10 * 1024 * 1024;
+module_param(pool_size, ulong, 0444);
+MODULE_PARM_DESC(pool_size, "Initial arena size in bytes, per NUMA node (also the growth step)");
+
+static uint block_size = 4096;
+module_param(block_size, uint, 0444);
+MODULE_PARM_DESC(block_size, "Block size in bytes: power of two, PAGE_SIZE..2 MiB");
+
+static ulong max_pool_size;
+module_param(max_pool_size, ulong, 0444);
+MODULE_PARM_DESC(max_pool_size, "Upper bound for the pool incl. grown arenas (0 = no growth)");
+
+static char *policy = "first_fit";
+module_param(policy, charp, 0444);
+MODULE_PARM_DESC(policy, "Block search policy: first_fit (bitmap scan) or best_fit (extent tree)");
+
+static char *backing = "vmalloc";
+module_param(backing, charp, 0444);
+MODULE_PARM_DESC(backing, "Arena memory: vmalloc, huge (2 MiB mappings) or contig (physically contiguous, <= 4 MiB per arena); falls back contig -> huge -> vmalloc");
+
+static bool prezero = true;
+module_param(prezero, bool, 0444);
+MODULE_PARM_DESC(prezero, "Zero free blocks in the background (otherwise only on allocation)");
+
+static bool numa = true;
+module_param(numa, bool, 0444);
+MODULE_PARM_DESC(numa, "One node-local arena per online NUMA node; allocations prefer the caller's node");
+
+static uint compact_threshold;
+module_param(compact_threshold, uint, 0444);
+MODULE_PARM_DESC(compact_threshold, "Compact movable extents in the background once an arena is this fragmented, % (0 = off)");
 
 static int __init kernel_alloc_init(void)
 {
-    int ret = allocator_init();
+    struct allocator_config cfg = {
+        .pool_size = pool_size,
+        .block_size = block_size,
+        .max_pool_size = max_pool_size,
+        .prezero = prezero,
+        .numa = numa,
+        .compact_threshold = compact_threshold,
+    };
+    int ret;
+
+    if (sysfs_streq(policy, "first_fit")) {
+        cfg.policy = ALLOC_POLICY_FIRST_FIT;
+    } else if (sysfs_streq(policy, "best_fit")) {
+        cfg.policy = ALLOC_POLICY_BEST_FIT;
+    } else {
+        pr_err("unknown policy '%s'\n", policy);
+        return -EINVAL;
+    }
+
+    if (sysfs_streq(backing, "vmalloc")) {
+        cfg.backing = ALLOC_BACKING_VMALLOC;
+    } else if (sysfs_streq(backing, "huge")) {
+        cfg.backing = ALLOC_BACKING_HUGE;
+    } else if (sysfs_streq(backing, "contig")) {
+        cfg.backing = ALLOC_BACKING_CONTIG;
+    } else {
+        pr_err("unknown backing '%s'\n", backing);
+        return -EINVAL;
+    }
+
+    ret = allocator_init(&cfg);
 
     if (ret != ALLOC_OK) {
         pr_err("init failed: %d\n", ret);
-        return -ENOMEM;
+        return ret == ALLOC_INVALID ? -EINVAL : -ENOMEM;
+    }
+
+    ret = kernel_alloc_dev_init();
+    if (ret) {
+        allocator_cleanup();
+        return ret;
     }
 
+    kernel_alloc_debugfs_init();
+
     pr_info("init\n");
     return 0;
 }
 
 static void __exit kernel_alloc_exit(void)
 {
+    kernel_alloc_debugfs_exit();
+    kernel_alloc_dev_exit();
     allocator_cleanup();
     pr_info("exit\n");
 }
@@ -31,4 +107,4 @@ module_exit(kernel_alloc_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Andrey Ogurcov");
-MODULE_DESCRIPTION("kernel_alloc: bitmap allocator + module_param_cb");
+MODULE_DESCRIPTION("kernel_alloc: bitmap allocator + module_param_cb + /dev/kernel_alloc");
@@ -5,37 +5,82 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/mm.h>
+#include <linux/nodemask.h>
+#include <linux/log2.h>
 #include <linux/errno.h>
 #include <linux/types.h>
 
 #include "allocator.h"
 
-/* alloc (write-only) */
+/*
+ * Результаты alloc, realloc и halloc читаются обратно из тех же параметров:
+ * проверкам не нужно искать адрес в логе. Обработчики параметров модуля
+ * вызываются под kernel_param_lock, поэтому отдельный лок не нужен.
+ * Права 0600: адреса ядра видны только root.
+ */
+static u64 last_alloc;
+static u64 last_realloc;
+static u32 last_handle;
+
+/* alloc: запись "<bytes> [align]", чтение — адрес последней выдачи */
 static int alloc_set(const char *val, const struct kernel_param *kp)
 {
-    unsigned long long bytes;
+    unsigned long long bytes, align = 0;
     void *p;
-    int ret = kstrtoull(val, 10, &bytes);
 
-    if (ret)
+    if (sscanf(val, "%llu %llu", &bytes, &align) < 1)
         return -EINVAL;
 
     if (bytes == 0)
         return -EINVAL;
+    if (align && !is_power_of_2(align))
+        return -EINVAL;
 
-    p = allocator_alloc((size_t)bytes);
+    p = allocator_alloc_aligned((size_t)bytes, (size_t)align);
     if (!p)
         return -ENOMEM;
 
+    last_alloc = (u64)(uintptr_t)p;
     return 0;
 }
 
+static int alloc_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "0x%llx\n", last_alloc);
+}
+
 static const struct kernel_param_ops alloc_ops = {
     .set = alloc_set,
+    .get = alloc_get,
 };
 
-module_param_cb(alloc, &alloc_ops, NULL, 0220);
-MODULE_PARM_DESC(alloc, "Write-only: allocate N bytes");
+module_param_cb(alloc, &alloc_ops, NULL, 0600);
+MODULE_PARM_DESC(alloc, "Write \"<bytes> [align]\" to allocate N bytes (<= 2048 from size classes), optionally aligned to a power of two; read back the last address");
+
+/* grow (write-only): добавить арену в N байт (0 = pool_size) */
+static int grow_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned long long bytes;
+    int ret = kstrtoull(val, 0, &bytes);
+
+    if (ret)
+        return -EINVAL;
+
+    ret = allocator_grow((size_t)bytes);
+    if (ret == ALLOC_OK)
+        return 0;
+    if (ret == ALLOC_INVALID)
+        return -EINVAL;
+
+    return -ENOSPC;
+}
+
+static const struct kernel_param_ops grow_ops = {
+    .set = grow_set,
+};
+
+module_param_cb(grow, &grow_ops, NULL, 0220);
+MODULE_PARM_DESC(grow, "Write-only: add an arena of N bytes (0 = pool_size), bounded by max_pool_size");
 
 /* free (write-only): ожидаем адрес как число (0x...) */
 static int free_set(const char *val, const struct kernel_param *kp)
@@ -66,20 +111,152 @@ static const struct kernel_param_ops free_ops = {
 module_param_cb(free, &free_ops, NULL, 0220);
 MODULE_PARM_DESC(free, "Write-only: free by address (e.g. 0xffff...)");
 
+/* realloc: запись "<addr> <bytes>", чтение — новый адрес */
+static int realloc_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned long long addr, bytes;
+    void *p;
+
+    if (sscanf(val, "%llx %llu", &addr, &bytes) != 2 || !addr || !bytes)
+        return -EINVAL;
+
+    p = allocator_realloc((void *)(uintptr_t)addr, (size_t)bytes);
+    if (!p)
+        return -ENOMEM;
+
+    last_realloc = (u64)(uintptr_t)p;
+    return 0;
+}
+
+static int realloc_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "0x%llx\n", last_realloc);
+}
+
+static const struct kernel_param_ops realloc_ops = {
+    .set = realloc_set,
+    .get = realloc_get,
+};
+
+module_param_cb(realloc, &realloc_ops, NULL, 0600);
+MODULE_PARM_DESC(realloc, "Write \"<addr> <bytes>\" to resize an allocation (in place when possible); read back the new address");
+
+/* halloc: запись размера, чтение — номер последнего handle; hfree (write-only) */
+static int halloc_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned long long bytes;
+    u32 handle;
+
+    if (kstrtoull(val, 0, &bytes) || !bytes)
+        return -EINVAL;
+
+    if (allocator_handle_alloc((size_t)bytes, &handle) != ALLOC_OK)
+        return -ENOMEM;
+
+    last_handle = handle;
+    return 0;
+}
+
+static int halloc_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%u\n", last_handle);
+}
+
+static const struct kernel_param_ops halloc_ops = {
+    .set = halloc_set,
+    .get = halloc_get,
+};
+
+module_param_cb(halloc, &halloc_ops, NULL, 0600);
+MODULE_PARM_DESC(halloc, "Write N to allocate N bytes as a movable extent; read back the last handle");
+
+static int hfree_set(const char *val, const struct kernel_param *kp)
+{
+    u32 handle;
+    int ret;
+
+    if (kstrtou32(val, 0, &handle))
+        return -EINVAL;
+
+    ret = allocator_handle_free(handle);
+    if (ret == ALLOC_OK)
+        return 0;
+    if (ret == ALLOC_NOT_FOUND)
+        return -ENOENT;
+
+    return -EBUSY;
+}
+
+static const struct kernel_param_ops hfree_ops = {
+    .set = hfree_set,
+};
+
+module_param_cb(hfree, &hfree_ops, NULL, 0220);
+MODULE_PARM_DESC(hfree, "Write-only: free a movable extent by handle");
+
+/* compact (write-only): N шагов уплотнения, 0 — полный проход */
+static int compact_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned int steps;
+
+    if (kstrtouint(val, 0, &steps))
+        return -EINVAL;
+
+    allocator_compact(steps);
+    return 0;
+}
+
+static const struct kernel_param_ops compact_ops = {
+    .set = compact_set,
+};
+
+module_param_cb(compact, &compact_ops, NULL, 0220);
+MODULE_PARM_DESC(compact, "Write-only: run N bounded compaction steps over movable extents (0 = full pass)");
+
 /* stats (read-only) */
 static int stats_get(char *buf, const struct kernel_param *kp)
 {
     struct stats_info s = allocator_get_stats();
+    struct node_stats ns;
+    int nid, pos;
 
     /* формат похожий на пример из задания */
-    return scnprintf(buf, PAGE_SIZE,
+    pos = scnprintf(buf, PAGE_SIZE,
                      "Total: %zu KB | Free: %zu KB | Allocated: %zu KB | Fragmentation: %zu%%\n"
-                     "Blocks: total=%zu free=%zu allocated=%zu\n",
+                     "Blocks: total=%zu free=%zu allocated=%zu\n"
+                     "Arenas: %u block=%zu B policy=%s free_extents=%zu\n"
+                     "Backing: %s contig=%u huge=%u vmalloc=%u\n"
+                     "Zeroing: prezero=%s zeroed_free=%zu\n"
+                     "Realloc: in_place=%zu moved=%zu\n"
+                     "Compact: passes=%u moved=%zu extents %zu B frag %zu%% -> %zu%% threshold=%u%%\n"
+                     "Small: blocks=%zu objects=%zu used=%zu B\n",
                      s.total_memory / 1024,
                      s.free_memory / 1024,
                      s.allocated_memory / 1024,
                      s.fragmentation_percent,
-                     s.total_blocks, s.free_blocks, s.allocated_blocks);
+                     s.total_blocks, s.free_blocks, s.allocated_blocks,
+                     s.nr_arenas, s.block_size,
+                     allocator_policy_name(s.policy), s.free_extents,
+                     allocator_backing_name(s.backing),
+                     s.nr_contig, s.nr_huge, s.nr_vmalloc,
+                     s.prezero ? "on" : "off", s.zeroed_blocks,
+                     s.realloc_in_place, s.realloc_moved,
+                     s.compact.passes, s.compact.moved_extents,
+                     s.compact.moved_bytes, s.compact.frag_before,
+                     s.compact.frag_after, s.compact_threshold,
+                     s.small_blocks, s.small_objects, s.small_bytes);
+
+    /* по строке на узел с собственными аренами (при numa=0 таких нет) */
+    for_each_online_node(nid) {
+        if (allocator_node_stats(nid, &ns) != ALLOC_OK || !ns.nr_arenas)
+            continue;
+        pos += scnprintf(buf + pos, PAGE_SIZE - pos,
+                         "Node %d: arenas=%u total=%zu free=%zu local=%zu remote=%zu\n",
+                         nid, ns.nr_arenas, ns.total_blocks, ns.free_blocks,
+                         ns.local_allocs, ns.remote_allocs);
+    }
+
+    return pos;
 }
 
 static const struct kernel_param_ops stats_ops = {
@@ -105,4 +282,4 @@ static const struct kernel_param_ops bitmap_info_ops = {
 };
 
 module_param_cb(bitmap_info, &bitmap_info_ops, NULL, 0444);
-MODULE_PARM_DESC(bitmap_info, "Read-only: bitmap visualization (X=used .=free)");
+MODULE_PARM_DESC(bitmap_info, "Read-only: bitmap visualization, one line per arena (X=used .=free), cut at one page; full map in debugfs kernel_alloc/map");
@@ -0,0 +1,219 @@
+// src/replay.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/timekeeping.h>
+
+#include "allocator.h"
+#include "arena.h"
+
+/*
+ * Синтетическая трасса: в основном мелкие запросы, немного средних и
+ * редкие крупные; занятость пула держится около 75%. blocks == 0 — free(id).
+ */
+struct replay_op {
+    u32 id;
+    u32 blocks;
+};
+
+struct replay_result {
+    size_t fails;
+    size_t frag_sum;            /* сумма замеров фрагментации, % */
+    size_t frag_samples;
+    size_t frag_final;
+    u64 ns_sum;
+    u64 ns_max;
+    size_t allocs;
+};
+
+#define REPLAY_SAMPLE_EVERY 256
+
+static u32 replay_rand(u32 *state)
+{
+    /* xorshift32: одинаковая трасса для обеих политик */
+    u32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static u32 replay_size(u32 *state, size_t blocks)
+{
+    u32 r = replay_rand(state) % 100;
+    u32 big = max_t(u32, 33, blocks / 16);
+
+    if (r < 70)
+        return 1 + replay_rand(state) % 4;
+    if (r < 95)
+        return 5 + replay_rand(state) % 28;
+    return 33 + replay_rand(state) % (big - 32);
+}
+
+/* трасса строится по модели "все alloc успешны"; неудачные free пропускаются при прогоне */
+static size_t replay_build(struct replay_op *ops, unsigned int nr_ops,
+                           size_t blocks, u32 *live, u32 *live_blocks)
+{
+    size_t used = 0, nr_live = 0, i;
+    u32 state = 0x9e3779b9, next_id = 0;
+
+    for (i = 0; i < nr_ops; i++) {
+        bool do_alloc = !nr_live ||
+            (replay_rand(&state) % 100) < (used < blocks * 3 / 4 ? 60 : 40);
+
+        if (do_alloc) {
+            u32 sz = replay_size(&state, blocks);
+
+            ops[i].id = next_id;
+            ops[i].blocks = sz;
+            live_blocks[next_id] = sz;
+            live[nr_live++] = next_id++;
+            used += sz;
+        } else {
+            size_t k = replay_rand(&state) % nr_live;
+
+            ops[i].id = live[k];
+            ops[i].blocks = 0;
+            used -= live_blocks[live[k]];
+            live[k] = live[--nr_live];
+        }
+    }
+
+    return next_id;
+}
+
+static size_t arena_frag(struct memory_allocator *a)
+{
+    unsigned long flags;
+    size_t free_blocks, largest;
+
+    spin_lock_irqsave(&a->lock, flags);
+    free_blocks = a->free_blocks;
+    largest = arena_largest_free(a);
+    spin_unlock_irqrestore(&a->lock, flags);
+
+    return free_blocks ? 100 - largest * 100 / free_blocks : 0;
+}
+
+static int replay_run(const struct replay_op *ops, unsigned int nr_ops,
+                      size_t nr_ids, size_t blocks, size_t block_size,
+                      enum alloc_policy policy, struct replay_result *r)
+{
+    struct memory_allocator *a;
+    struct alloc_node *nodes;
+    unsigned int i;
+
+    /* временная арена вне пула: id за пределами ALLOC_MAX_ARENAS */
+    a = arena_create(ALLOC_MAX_ARENAS, blocks * block_size, block_size, policy,
+                     ALLOC_BACKING_VMALLOC, NUMA_NO_NODE);
+    if (!a)
+        return ALLOC_NOMEM;
+
+    /* узлы заранее, чтобы kmalloc не попадал в замер */
+    nodes = kvcalloc(nr_ids, sizeof(*nodes), GFP_KERNEL);
+    if (!nodes) {
+        arena_destroy(a);
+        return ALLOC_NOMEM;
+    }
+
+    memset(r, 0, sizeof(*r));
+
+    for (i = 0; i < nr_ops; i++) {
+        struct alloc_node *n = &nodes[ops[i].id];
+
+        if (ops[i].blocks) {
+            u64 t0 = ktime_get_ns(), dt;
+            void *p = arena_alloc_blocks(a, ops[i].blocks, 0, n, NULL,
+                                         ALLOC_F_NOZERO);
+
+            dt = ktime_get_ns() - t0;
+            r->ns_sum += dt;
+            r->ns_max = max(r->ns_max, dt);
+            r->allocs++;
+            if (!p)
+                r->fails++;
+        } else if (n->ptr) {
+            arena_free_node(a, n);
+            n->ptr = NULL;
+        }
+
+        if (i % REPLAY_SAMPLE_EVERY == 0) {
+            r->frag_sum += arena_frag(a);
+            r->frag_samples++;
+            cond_resched();
+        }
+    }
+
+    r->frag_final = arena_frag(a);
+
+    /* узлы принадлежат массиву, arena_destroy их освобождать не должна */
+    for (i = 0; i < nr_ids; i++) {
+        if (nodes[i].ptr)
+            arena_free_node(a, &nodes[i]);
+    }
+
+    kvfree(nodes);
+    arena_destroy(a);
+    return ALLOC_OK;
+}
+
+int allocator_replay(unsigned int ops, size_t blocks, char *out, size_t out_sz)
+{
+    static const enum alloc_policy policies[] = {
+        ALLOC_POLICY_FIRST_FIT, ALLOC_POLICY_BEST_FIT,
+    };
+    struct stats_info s = allocator_get_stats();
+    struct replay_op *trace;
+    u32 *live, *live_blocks;
+    size_t nr_ids, pos = 0;
+    unsigned int i;
+    int ret = ALLOC_OK;
+
+    if (!ops || blocks < 64)
+        return ALLOC_INVALID;
+
+    trace = kvmalloc_array(ops, sizeof(*trace), GFP_KERNEL);
+    live = kvmalloc_array(ops, sizeof(*live), GFP_KERNEL);
+    live_blocks = kvmalloc_array(ops, sizeof(*live_blocks), GFP_KERNEL);
+    if (!trace || !live || !live_blocks) {
+        ret = ALLOC_NOMEM;
+        goto out;
+    }
+
+    nr_ids = replay_build(trace, ops, blocks, live, live_blocks);
+
+    pos += scnprintf(out + pos, out_sz - pos,
+                     "trace: ops=%u blocks=%zu block=%zu\n"
+                     "policy     allocs  fails  frag_avg%% frag_end%%  avg_ns  max_ns\n",
+                     ops, blocks, s.block_size);
+
+    for (i = 0; i < ARRAY_SIZE(policies); i++) {
+        struct replay_result r;
+
+        ret = replay_run(trace, ops, nr_ids, blocks, s.block_size,
+                         policies[i], &r);
+        if (ret != ALLOC_OK)
+            break;
+
+        pos += scnprintf(out + pos, out_sz - pos,
+                         "%-9s %7zu %6zu %9zu %9zu %7llu %7llu\n",
+                         allocator_policy_name(policies[i]),
+                         r.allocs, r.fails,
+                         r.frag_samples ? r.frag_sum / r.frag_samples : 0,
+                         r.frag_final,
+                         r.allocs ? div64_u64(r.ns_sum, r.allocs) : 0,
+                         r.ns_max);
+    }
+
+out:
+    kvfree(live_blocks);
+    kvfree(live);
+    kvfree(trace);
+    return ret == ALLOC_OK ? (int)pos : ret;
+}
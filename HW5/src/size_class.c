@@ -0,0 +1,76 @@
+// src/size_class.c
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "allocator.h"
+#include "bitmap.h"
+#include "size_class.h"
+
+/* номер класса для запроса или -1, если запрос идёт целыми блоками */
+int sc_class_of(size_t bytes)
+{
+    unsigned int cls = 0;
+
+    if (bytes == 0 || bytes > SC_MAX_SIZE)
+        return -1;
+
+    while ((1u << (SC_MIN_SHIFT + cls)) < bytes)
+        cls++;
+
+    return (int)cls;
+}
+
+/* размер дескриптора вместе с картой объектов (под kmalloc) */
+size_t sc_page_bytes(size_t block_size, unsigned int cls)
+{
+    size_t nr_objs = block_size >> (SC_MIN_SHIFT + cls);
+
+    return sizeof(struct sc_page) + (nr_objs + 7) / 8;
+}
+
+void sc_page_init(struct sc_page *sp, void *base, unsigned int cls,
+                    size_t block_size)
+{
+    INIT_LIST_HEAD(&sp->partial);
+    sp->base = base;
+    sp->cls = cls;
+    sp->obj_size = 1u << (SC_MIN_SHIFT + cls);
+    sp->nr_objs = block_size / sp->obj_size;
+    sp->used = 0;
+    memset(sp->map, 0, (sp->nr_objs + 7) / 8);
+}
+
+void *sc_obj_alloc(struct sc_page *sp)
+{
+    size_t idx;
+
+    if (sc_page_full(sp))
+        return NULL;
+
+    if (bitmap_first_fit(sp->map, sp->nr_objs, 1, &idx))
+        return NULL;
+
+    bm_set(sp->map, idx);
+    sp->used++;
+
+    return (char *)sp->base + idx * sp->obj_size;
+}
+
+int sc_obj_free(struct sc_page *sp, void *ptr)
+{
+    uintptr_t off = (uintptr_t)ptr - (uintptr_t)sp->base;
+    size_t idx;
+
+    /* указатель должен смотреть ровно на начало объекта */
+    if (off % sp->obj_size)
+        return ALLOC_INVALID;
+
+    idx = off / sp->obj_size;
+    if (idx >= sp->nr_objs || !bm_test(sp->map, idx))
+        return ALLOC_INVALID;
+
+    bm_clear(sp->map, idx);
+    sp->used--;
+
+    return ALLOC_OK;
+}
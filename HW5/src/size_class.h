@@ -0,0 +1,48 @@
+#ifndef KERNEL_ALLOC_SIZE_CLASS_H
+#define KERNEL_ALLOC_SIZE_CLASS_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+/* размерные классы для мелких запросов: 16 B .. 2 KiB (степени двойки) */
+#define SC_MIN_SHIFT   4
+#define SC_MAX_SHIFT   11
+#define SC_NR_CLASSES  (SC_MAX_SHIFT - SC_MIN_SHIFT + 1)
+#define SC_MAX_SIZE    (1u << SC_MAX_SHIFT)
+
+/* один блок пула, нарезанный на объекты одного класса */
+struct sc_page {
+    struct list_head partial;   /* в списке частично занятых страниц класса */
+    void *base;                 /* начало блока */
+    unsigned int cls;
+    unsigned int obj_size;
+    unsigned int nr_objs;
+    unsigned int used;
+    unsigned char map[];        /* 1 бит на объект: 0 = свободен, 1 = занят */
+};
+
+struct size_class {
+    struct list_head partial;   /* страницы, где есть свободные объекты */
+    size_t pages;
+    size_t objects;
+};
+
+int sc_class_of(size_t bytes);
+size_t sc_page_bytes(size_t block_size, unsigned int cls);
+
+void sc_page_init(struct sc_page *sp, void *base, unsigned int cls,
+                    size_t block_size);
+void *sc_obj_alloc(struct sc_page *sp);
+int sc_obj_free(struct sc_page *sp, void *ptr);
+
+static inline bool sc_page_full(const struct sc_page *sp)
+{
+    return sp->used == sp->nr_objs;
+}
+
+static inline bool sc_page_empty(const struct sc_page *sp)
+{
+    return sp->used == 0;
+}
+
+#endif
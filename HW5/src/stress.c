@@ -0,0 +1,271 @@
+// src/stress.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/timekeeping.h>
+#include <linux/log2.h>
+#include <linux/bitops.h>
+
+#include "allocator.h"
+
+#define STRESS_LAT_BUCKETS 40
+
+/*
+ * Поток нагрузки: slots ячеек, операция выбирает ячейку и либо выделяет в
+ * пустую, либо освобождает занятую. hot% операций приходится на первую
+ * восьмую ячеек — там аллокации живут коротко, в остальных долго.
+ */
+struct stress_thread {
+    struct task_struct *task;
+    struct completion done;
+    const struct stress_config *cfg;
+    unsigned int cpu;
+    u32 seed;
+
+    void **ptr;
+    size_t *bytes;
+
+    u64 ops;
+    u64 fails;
+    u64 corrupt;                /* чужие данные в своей аллокации */
+    u64 ns;
+    u64 lat_max;
+    u64 lat[STRESS_LAT_BUCKETS];   /* корзина b: [2^(b-1), 2^b) нс */
+};
+
+static u32 stress_rand(u32 *state)
+{
+    u32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* лог-равномерно от 16 байт до max_bytes: мелких запросов больше */
+static size_t stress_size(u32 *state, size_t max_bytes)
+{
+    unsigned int top = ilog2(max_bytes);
+    unsigned int shift = 4 + stress_rand(state) % (top - 3);
+    size_t lo = 1ul << shift;
+
+    return min(max_bytes, lo + stress_rand(state) % lo);
+}
+
+static size_t stress_slot(struct stress_thread *t)
+{
+    size_t hot = max_t(size_t, t->cfg->slots / 8, 1);
+
+    if (stress_rand(&t->seed) % 100 < t->cfg->hot_percent)
+        return stress_rand(&t->seed) % hot;
+    return stress_rand(&t->seed) % t->cfg->slots;
+}
+
+/* метка ячейки в первом и последнем байте: перекрытие аллокаций её испортит */
+static u8 stress_tag(struct stress_thread *t, size_t slot)
+{
+    return (u8)(t->cpu * 31 + slot);
+}
+
+static void stress_op(struct stress_thread *t)
+{
+    size_t slot = stress_slot(t);
+    u8 tag = stress_tag(t, slot);
+    u64 t0, dt;
+
+    if (t->ptr[slot]) {
+        u8 *p = t->ptr[slot];
+
+        if (p[0] != tag || p[t->bytes[slot] - 1] != tag)
+            t->corrupt++;
+
+        t0 = ktime_get_ns();
+        allocator_free(p);
+        dt = ktime_get_ns() - t0;
+        t->ptr[slot] = NULL;
+    } else {
+        size_t bytes = stress_size(&t->seed, t->cfg->max_bytes);
+        u8 *p;
+
+        t0 = ktime_get_ns();
+        p = allocator_alloc(bytes);
+        dt = ktime_get_ns() - t0;
+        if (p) {
+            p[0] = tag;
+            p[bytes - 1] = tag;
+            t->ptr[slot] = p;
+            t->bytes[slot] = bytes;
+        } else {
+            t->fails++;
+        }
+    }
+
+    t->ops++;
+    t->ns += dt;
+    t->lat_max = max(t->lat_max, dt);
+    t->lat[min_t(unsigned int, fls64(dt), STRESS_LAT_BUCKETS - 1)]++;
+}
+
+static int stress_fn(void *arg)
+{
+    struct stress_thread *t = arg;
+    unsigned long deadline = jiffies + msecs_to_jiffies(t->cfg->duration_ms);
+
+    while (time_before(jiffies, deadline) && !kthread_should_stop()) {
+        stress_op(t);
+        cond_resched();
+    }
+
+    complete(&t->done);
+
+    /* живые аллокации остаются до сверки, потом их освобождает запустивший */
+    while (!kthread_should_stop()) {
+        set_current_state(TASK_INTERRUPTIBLE);
+        if (!kthread_should_stop())
+            schedule();
+        __set_current_state(TASK_RUNNING);
+    }
+    return 0;
+}
+
+/* верхняя граница корзины, в которой набирается доля permille всех операций */
+static u64 stress_percentile(const u64 *lat, u64 total, unsigned int permille)
+{
+    u64 want = div_u64(total * permille + 999, 1000), seen = 0;
+    unsigned int b;
+
+    for (b = 0; b < STRESS_LAT_BUCKETS; b++) {
+        seen += lat[b];
+        if (seen >= want)
+            return 1ull << b;
+    }
+    return 1ull << (STRESS_LAT_BUCKETS - 1);
+}
+
+int allocator_stress(const struct stress_config *cfg, char *out, size_t out_sz)
+{
+    struct stress_thread *threads;
+    u64 lat[STRESS_LAT_BUCKETS] = { 0 };
+    u64 ops = 0, fails = 0, corrupt = 0, lat_max = 0;
+    unsigned int i, cpu, started = 0;
+    struct stats_info s;
+    size_t pos = 0;
+    int verify, ret = ALLOC_OK;
+
+    if (!cfg->threads || cfg->threads > STRESS_MAX_THREADS ||
+        !cfg->duration_ms || !cfg->slots || cfg->max_bytes < 32 ||
+        cfg->hot_percent > 100)
+        return ALLOC_INVALID;
+
+    threads = kcalloc(cfg->threads, sizeof(*threads), GFP_KERNEL);
+    if (!threads)
+        return ALLOC_NOMEM;
+
+    /* потоки по CPU по кругу */
+    cpu = cpumask_first(cpu_online_mask);
+    for (i = 0; i < cfg->threads; i++) {
+        struct stress_thread *t = &threads[i];
+
+        t->cfg = cfg;
+        t->cpu = cpu;
+        t->seed = 0x9e3779b9 ^ (i * 0x85ebca6b);
+        init_completion(&t->done);
+
+        t->ptr = kvcalloc(cfg->slots, sizeof(*t->ptr), GFP_KERNEL);
+        t->bytes = kvcalloc(cfg->slots, sizeof(*t->bytes), GFP_KERNEL);
+        if (!t->ptr || !t->bytes) {
+            ret = ALLOC_NOMEM;
+            break;
+        }
+
+        t->task = kthread_create_on_cpu(stress_fn, t, cpu, "ka_stress/%u");
+        if (IS_ERR(t->task)) {
+            t->task = NULL;
+            ret = ALLOC_NOMEM;
+            break;
+        }
+
+        cpu = cpumask_next(cpu, cpu_online_mask);
+        if (cpu >= nr_cpu_ids)
+            cpu = cpumask_first(cpu_online_mask);
+    }
+
+    /* запускаем только когда созданы все, иначе первые отработают в одиночку */
+    if (ret == ALLOC_OK) {
+        for (i = 0; i < cfg->threads; i++)
+            wake_up_process(threads[i].task);
+        started = cfg->threads;
+
+        for (i = 0; i < cfg->threads; i++)
+            wait_for_completion(&threads[i].done);
+    }
+
+    /* все стоят, живые аллокации на месте: снимок фрагментации и сверка */
+    s = allocator_get_stats();
+    verify = started ? allocator_verify() : 0;
+
+    for (i = 0; i < cfg->threads; i++) {
+        struct stress_thread *t = &threads[i];
+        size_t k;
+
+        if (t->task)
+            kthread_stop(t->task);
+
+        for (k = 0; t->ptr && k < cfg->slots; k++)
+            if (t->ptr[k])
+                allocator_free(t->ptr[k]);
+
+        kvfree(t->ptr);
+        kvfree(t->bytes);
+    }
+
+    if (ret != ALLOC_OK)
+        goto out;
+
+    pos += scnprintf(out + pos, out_sz - pos,
+                     "stress: threads=%u ms=%u slots=%u max_bytes=%zu hot=%u%%\n"
+                     "thread cpu        ops     ops/s  fails\n",
+                     cfg->threads, cfg->duration_ms, cfg->slots,
+                     cfg->max_bytes, cfg->hot_percent);
+
+    for (i = 0; i < cfg->threads; i++) {
+        struct stress_thread *t = &threads[i];
+        unsigned int b;
+
+        pos += scnprintf(out + pos, out_sz - pos, "%6u %3u %10llu %9llu %6llu\n",
+                         i, t->cpu, t->ops,
+                         div_u64(t->ops * 1000, cfg->duration_ms), t->fails);
+
+        ops += t->ops;
+        fails += t->fails;
+        corrupt += t->corrupt;
+        lat_max = max(lat_max, t->lat_max);
+        for (b = 0; b < STRESS_LAT_BUCKETS; b++)
+            lat[b] += t->lat[b];
+    }
+
+    pos += scnprintf(out + pos, out_sz - pos,
+                     "total: ops=%llu ops/s=%llu fails=%llu\n"
+                     "latency_ns: p50<%llu p99<%llu p999<%llu max=%llu\n"
+                     "fragmentation: %zu%%\n"
+                     "verify: %s mismatches=%d corrupt=%llu\n",
+                     ops, div_u64(ops * 1000, cfg->duration_ms), fails,
+                     stress_percentile(lat, ops, 500),
+                     stress_percentile(lat, ops, 990),
+                     stress_percentile(lat, ops, 999), lat_max,
+                     s.fragmentation_percent,
+                     verify == 0 && !corrupt ? "ok" : "FAILED",
+                     verify, corrupt);
+
+out:
+    kfree(threads);
+    return ret == ALLOC_OK ? (int)pos : ret;
+}
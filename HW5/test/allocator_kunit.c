@@ -0,0 +1,453 @@
+// test/allocator_kunit.c
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/cpumask.h>
+#include <linux/completion.h>
+#include <linux/kthread.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+#include "allocator.h"
+#include "arena.h"
+
+/*
+ * Наборы KUnit для allocator.c. Собираются в модуль только с make kunit и
+ * выполняются при insmod, уже после allocator_init: тесты работают с живым
+ * пулом модуля, а поиск внутри арены проверяют на временных аренах вне пула.
+ * После каждого теста пул должен сходиться с allocator_verify.
+ */
+
+static void alloc_test_exit(struct kunit *test)
+{
+    KUNIT_EXPECT_EQ(test, allocator_verify(), 0);
+}
+
+static bool mem_is(const void *p, int c, size_t len)
+{
+    const unsigned char *b = p;
+
+    while (len--)
+        if (*b++ != c)
+            return false;
+    return true;
+}
+
+static void alloc_test_invalid(struct kunit *test)
+{
+    int on_stack;
+
+    KUNIT_EXPECT_NULL(test, allocator_alloc(0));
+    KUNIT_EXPECT_NULL(test, allocator_alloc_aligned(4096, 3000));
+    KUNIT_EXPECT_EQ(test, allocator_free(NULL), ALLOC_INVALID);
+    /* адрес не из пула */
+    KUNIT_EXPECT_EQ(test, allocator_free(&on_stack), ALLOC_INVALID);
+}
+
+static void alloc_test_double_free(struct kunit *test)
+{
+    void *p = allocator_alloc(8192);
+    void *q = allocator_alloc(64);
+
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    KUNIT_ASSERT_NOT_NULL(test, q);
+    KUNIT_EXPECT_EQ(test, allocator_free(p), ALLOC_OK);
+    KUNIT_EXPECT_NE(test, allocator_free(p), ALLOC_OK);
+    KUNIT_EXPECT_EQ(test, allocator_free(q), ALLOC_OK);
+    KUNIT_EXPECT_NE(test, allocator_free(q), ALLOC_OK);
+}
+
+/* память отдаётся обнулённой, даже если до этого блок был исписан */
+static void alloc_test_zeroed(struct kunit *test)
+{
+    const size_t sizes[] = { 48, 2048, 4096, 3 * 4096 + 1 };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        void *p = allocator_alloc(sizes[i]);
+
+        KUNIT_ASSERT_NOT_NULL(test, p);
+        memset(p, 0xa5, sizes[i]);
+        allocator_free(p);
+
+        p = allocator_alloc(sizes[i]);
+        KUNIT_ASSERT_NOT_NULL(test, p);
+        KUNIT_EXPECT_TRUE_MSG(test, mem_is(p, 0, sizes[i]), "%zu bytes", sizes[i]);
+        allocator_free(p);
+    }
+}
+
+static void alloc_test_aligned(struct kunit *test)
+{
+    const size_t aligns[] = { 64, 256, 4096, 65536 };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(aligns); i++) {
+        void *small = allocator_alloc_aligned(24, aligns[i]);
+        void *big = allocator_alloc_aligned(8192, aligns[i]);
+
+        KUNIT_ASSERT_NOT_NULL(test, small);
+        KUNIT_ASSERT_NOT_NULL(test, big);
+        KUNIT_EXPECT_TRUE(test, IS_ALIGNED((uintptr_t)small, aligns[i]));
+        KUNIT_EXPECT_TRUE(test, IS_ALIGNED((uintptr_t)big, aligns[i]));
+        allocator_free(small);
+        allocator_free(big);
+    }
+}
+
+/* объекты одного класса не пересекаются и лежат на границе своего размера */
+static void alloc_test_size_class(struct kunit *test)
+{
+    enum { NR = 200, SZ = 64 };
+    void **objs = kunit_kcalloc(test, NR, sizeof(*objs), GFP_KERNEL);
+    unsigned int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, objs);
+
+    for (i = 0; i < NR; i++) {
+        objs[i] = allocator_alloc(SZ);
+        KUNIT_ASSERT_NOT_NULL(test, objs[i]);
+        KUNIT_EXPECT_TRUE(test, IS_ALIGNED((uintptr_t)objs[i], SZ));
+        memset(objs[i], i & 0xff, SZ);
+    }
+    for (i = 0; i < NR; i++)
+        KUNIT_EXPECT_TRUE_MSG(test, mem_is(objs[i], i & 0xff, SZ), "object %u", i);
+    for (i = 0; i < NR; i++)
+        KUNIT_EXPECT_EQ(test, allocator_free(objs[i]), ALLOC_OK);
+}
+
+static void alloc_test_realloc(struct kunit *test)
+{
+    unsigned char *p = allocator_alloc(16384), *q;
+
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    memset(p, 0x3c, 16384);
+
+    /* уменьшение всегда на месте */
+    q = allocator_realloc(p, 4096);
+    KUNIT_ASSERT_PTR_EQ(test, q, p);
+
+    /* рост — на месте или с переносом, данные сохраняются */
+    q = allocator_realloc(p, 65536);
+    KUNIT_ASSERT_NOT_NULL(test, q);
+    KUNIT_EXPECT_TRUE(test, mem_is(q, 0x3c, 4096));
+    KUNIT_EXPECT_TRUE(test, mem_is(q + 4096, 0, 65536 - 4096));
+    allocator_free(q);
+
+    /* объект класса: в пределах класса на месте, больше — перенос */
+    p = allocator_alloc(40);
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    memset(p, 0x7e, 40);
+    KUNIT_EXPECT_PTR_EQ(test, allocator_realloc(p, 64), (void *)p);
+    q = allocator_realloc(p, 5000);
+    KUNIT_ASSERT_NOT_NULL(test, q);
+    KUNIT_EXPECT_TRUE(test, mem_is(q, 0x7e, 40));
+    allocator_free(q);
+}
+
+static void alloc_test_owner(struct kunit *test)
+{
+    int owner;
+    void *p = allocator_alloc_owned(8192, 0, 0, &owner);
+
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    /* чужой экстент не освобождается, в том числе ядром */
+    KUNIT_EXPECT_EQ(test, allocator_free(p), ALLOC_INVALID);
+    KUNIT_EXPECT_EQ(test, allocator_free_owned(p, test), ALLOC_INVALID);
+    KUNIT_EXPECT_EQ(test, allocator_free_owned(p, &owner), ALLOC_OK);
+}
+
+static void alloc_test_handle(struct kunit *test)
+{
+    u32 h;
+    void *p;
+
+    KUNIT_ASSERT_EQ(test, allocator_handle_alloc(8192, &h), ALLOC_OK);
+    p = allocator_handle_pin(h);
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    KUNIT_EXPECT_TRUE(test, mem_is(p, 0, 8192));
+
+    /* закреплённый экстент не освобождается и не двигается */
+    KUNIT_EXPECT_EQ(test, allocator_handle_free(h), ALLOC_BUSY);
+    allocator_compact(0);
+    KUNIT_EXPECT_PTR_EQ(test, allocator_handle_pin(h), p);
+    allocator_handle_unpin(h);
+    allocator_handle_unpin(h);
+
+    KUNIT_EXPECT_EQ(test, allocator_handle_free(h), ALLOC_OK);
+    KUNIT_EXPECT_EQ(test, allocator_handle_free(h), ALLOC_NOT_FOUND);
+    KUNIT_EXPECT_NULL(test, allocator_handle_pin(h));
+}
+
+/*
+ * Два потока закрепляют и освобождают одни и те же handle: каждый
+ * освобождается ровно один раз, закреплённый не уходит из-под pin.
+ */
+#define HRACE_HANDLES 256
+
+struct hrace {
+    u32 h[HRACE_HANDLES];
+    atomic_t freed;
+    struct completion done;
+};
+
+static void hrace_run(struct hrace *r)
+{
+    unsigned int i;
+    int ret;
+
+    for (i = 0; i < HRACE_HANDLES; i++) {
+        void *p = allocator_handle_pin(r->h[i]);
+
+        if (p) {
+            memset(p, 0x5a, 64);
+            allocator_handle_unpin(r->h[i]);
+        }
+        while ((ret = allocator_handle_free(r->h[i])) == ALLOC_BUSY)
+            cpu_relax();
+        if (ret == ALLOC_OK)
+            atomic_inc(&r->freed);
+    }
+}
+
+static int hrace_thread(void *arg)
+{
+    struct hrace *r = arg;
+
+    hrace_run(r);
+    complete(&r->done);
+    return 0;
+}
+
+static void alloc_test_handle_race(struct kunit *test)
+{
+    struct hrace *r = kunit_kzalloc(test, sizeof(*r), GFP_KERNEL);
+    struct task_struct *t;
+    unsigned int i;
+
+    KUNIT_ASSERT_NOT_NULL(test, r);
+    for (i = 0; i < HRACE_HANDLES; i++)
+        KUNIT_ASSERT_EQ(test, allocator_handle_alloc(8192, &r->h[i]), ALLOC_OK);
+    init_completion(&r->done);
+
+    /* без второго потока гонки нет, но handle всё равно освобождаются */
+    t = kthread_run(hrace_thread, r, "kalloc_hrace");
+    KUNIT_EXPECT_FALSE(test, IS_ERR(t));
+    if (IS_ERR(t))
+        complete(&r->done);
+
+    hrace_run(r);
+    wait_for_completion(&r->done);
+    KUNIT_EXPECT_EQ(test, atomic_read(&r->freed), HRACE_HANDLES);
+}
+
+/*
+ * Временная арена вне пула на 64 блока: половина блоков свободна, но
+ * вразброс, поэтому два блока подряд уже не найти.
+ */
+#define ARENA_TEST_BLOCKS 64
+
+static struct memory_allocator *arena_fragmented(struct kunit *test,
+                                                 enum alloc_policy policy,
+                                                 struct alloc_node *nodes)
+{
+    struct memory_allocator *a;
+    unsigned int i;
+
+    a = arena_create(ALLOC_MAX_ARENAS, ARENA_TEST_BLOCKS * PAGE_SIZE, PAGE_SIZE,
+                     policy, ALLOC_BACKING_VMALLOC, NUMA_NO_NODE);
+    KUNIT_ASSERT_NOT_NULL(test, a);
+
+    for (i = 0; i < ARENA_TEST_BLOCKS; i++)
+        KUNIT_ASSERT_NOT_NULL(test, arena_alloc_blocks(a, 1, 0, &nodes[i], NULL,
+                                                       ALLOC_F_NOZERO));
+    for (i = 0; i < ARENA_TEST_BLOCKS; i += 2) {
+        arena_free_node(a, &nodes[i]);
+        nodes[i].ptr = NULL;
+    }
+    return a;
+}
+
+static void arena_release(struct memory_allocator *a, struct alloc_node *nodes)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARENA_TEST_BLOCKS; i++)
+        if (nodes[i].ptr)
+            arena_free_node(a, &nodes[i]);
+    arena_destroy(a);
+}
+
+static void arena_test_fragmented(struct kunit *test)
+{
+    static const enum alloc_policy policies[] = {
+        ALLOC_POLICY_FIRST_FIT, ALLOC_POLICY_BEST_FIT,
+    };
+    struct alloc_node *nodes, extra;
+    struct memory_allocator *a;
+    unsigned long flags;
+    unsigned int i;
+
+    nodes = kunit_kcalloc(test, ARENA_TEST_BLOCKS, sizeof(*nodes), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, nodes);
+
+    for (i = 0; i < ARRAY_SIZE(policies); i++) {
+        memset(nodes, 0, ARENA_TEST_BLOCKS * sizeof(*nodes));
+        a = arena_fragmented(test, policies[i], nodes);
+
+        spin_lock_irqsave(&a->lock, flags);
+        KUNIT_EXPECT_EQ(test, a->free_blocks, (size_t)ARENA_TEST_BLOCKS / 2);
+        KUNIT_EXPECT_EQ(test, arena_largest_free(a), (size_t)1);
+        spin_unlock_irqrestore(&a->lock, flags);
+
+        KUNIT_EXPECT_NULL(test, arena_alloc_blocks(a, 2, 0, &extra, NULL, 0));
+
+        /* освободили соседа: дыра в 3 блока, best-fit и first-fit её находят */
+        arena_free_node(a, &nodes[5]);
+        nodes[5].ptr = NULL;
+        KUNIT_EXPECT_PTR_EQ(test, arena_alloc_blocks(a, 3, 0, &extra, NULL, 0),
+                            (void *)((char *)a->memory_pool + 4 * PAGE_SIZE));
+        arena_free_node(a, &extra);
+
+        arena_release(a, nodes);
+    }
+}
+
+/* best-fit берёт самую тесную дыру, first-fit — первую подходящую */
+static void arena_test_best_fit(struct kunit *test)
+{
+    struct alloc_node *nodes, extra;
+    struct memory_allocator *a;
+    void *p;
+
+    nodes = kunit_kcalloc(test, ARENA_TEST_BLOCKS, sizeof(*nodes), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, nodes);
+
+    a = arena_fragmented(test, ALLOC_POLICY_BEST_FIT, nodes);
+    /* дыры [8, 13) из 5 блоков и [40, 43) из 3: запросу на 3 теснее вторая */
+    arena_free_node(a, &nodes[9]);
+    nodes[9].ptr = NULL;
+    arena_free_node(a, &nodes[11]);
+    nodes[11].ptr = NULL;
+    arena_free_node(a, &nodes[41]);
+    nodes[41].ptr = NULL;
+
+    p = arena_alloc_blocks(a, 3, 0, &extra, NULL, 0);
+    KUNIT_EXPECT_PTR_EQ(test, p, (void *)((char *)a->memory_pool + 40 * PAGE_SIZE));
+    if (p)
+        arena_free_node(a, &extra);
+
+    arena_release(a, nodes);
+}
+
+/*
+ * Блок 64 KiB, выравнивание 128 KiB: vmalloc даёт базу, выровненную лишь
+ * на страницу, и без выравнивания базы на блок такой адрес не находился.
+ */
+static void arena_test_aligned_big_block(struct kunit *test)
+{
+    enum { BS = 65536, ALIGN = 131072, NR = 16 };
+    struct alloc_node nodes[NR / 2];
+    struct memory_allocator *a;
+    unsigned int i;
+
+    a = arena_create(ALLOC_MAX_ARENAS, NR * BS, BS, ALLOC_POLICY_FIRST_FIT,
+                     ALLOC_BACKING_VMALLOC, NUMA_NO_NODE);
+    KUNIT_ASSERT_NOT_NULL(test, a);
+    KUNIT_EXPECT_TRUE(test, IS_ALIGNED((uintptr_t)a->memory_pool, BS));
+
+    /* через блок: в арене ровно NR / 2 выровненных адресов */
+    for (i = 0; i < NR / 2; i++) {
+        void *p = arena_alloc_blocks(a, 1, ALIGN, &nodes[i], NULL,
+                                     ALLOC_F_NOZERO);
+
+        KUNIT_ASSERT_NOT_NULL_MSG(test, p, "allocation %u", i);
+        KUNIT_EXPECT_TRUE(test, IS_ALIGNED((uintptr_t)p, ALIGN));
+    }
+    KUNIT_EXPECT_NULL(test, arena_alloc_blocks(a, 1, ALIGN, &nodes[0], NULL,
+                                               ALLOC_F_NOZERO));
+
+    for (i = 0; i < NR / 2; i++)
+        arena_free_node(a, &nodes[i]);
+    arena_destroy(a);
+}
+
+/* замеры: ns на пару alloc+free в одном потоке и под нагрузкой allocator_stress */
+#define ALLOC_BENCH_OPS 20000
+
+static void alloc_bench_single(struct kunit *test)
+{
+    const size_t sizes[] = { 64, 4096, 65536 };
+    unsigned int i, k, fails;
+    u64 t0, ns;
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        fails = 0;
+        t0 = ktime_get_ns();
+        for (k = 0; k < ALLOC_BENCH_OPS; k++) {
+            void *p = allocator_alloc(sizes[i]);
+
+            if (!p || allocator_free(p) != ALLOC_OK)
+                fails++;
+        }
+        ns = ktime_get_ns() - t0;
+
+        KUNIT_EXPECT_EQ(test, fails, 0u);
+        kunit_info(test, "%zu bytes: %llu ns per alloc+free\n",
+                   sizes[i], div_u64(ns, ALLOC_BENCH_OPS));
+    }
+}
+
+static void alloc_bench_contended(struct kunit *test)
+{
+    struct stress_config cfg = {
+        .threads = clamp_t(unsigned int, num_online_cpus(), 2, 8),
+        .duration_ms = 300,
+        .slots = 256,
+        .max_bytes = 64 * 1024,
+        .hot_percent = 80,
+    };
+    char *report = kunit_kzalloc(test, PAGE_SIZE, GFP_KERNEL);
+    char *line, *cur;
+    int ret;
+
+    KUNIT_ASSERT_NOT_NULL(test, report);
+    ret = allocator_stress(&cfg, report, PAGE_SIZE);
+    KUNIT_ASSERT_GT(test, ret, 0);
+
+    /* в отчёт KUnit — только итоговые строки */
+    cur = report;
+    while ((line = strsep(&cur, "\n"))) {
+        if (str_has_prefix(line, "total:") || str_has_prefix(line, "latency_ns:") ||
+            str_has_prefix(line, "verify:"))
+            kunit_info(test, "%u threads %s\n", cfg.threads, line);
+        if (str_has_prefix(line, "verify:"))
+            KUNIT_EXPECT_TRUE(test, str_has_prefix(line, "verify: ok "));
+    }
+}
+
+static struct kunit_case alloc_test_cases[] = {
+    KUNIT_CASE(alloc_test_invalid),
+    KUNIT_CASE(alloc_test_double_free),
+    KUNIT_CASE(alloc_test_zeroed),
+    KUNIT_CASE(alloc_test_aligned),
+    KUNIT_CASE(alloc_test_size_class),
+    KUNIT_CASE(alloc_test_realloc),
+    KUNIT_CASE(alloc_test_owner),
+    KUNIT_CASE(alloc_test_handle),
+    KUNIT_CASE(alloc_test_handle_race),
+    KUNIT_CASE(arena_test_fragmented),
+    KUNIT_CASE(arena_test_best_fit),
+    KUNIT_CASE(arena_test_aligned_big_block),
+    KUNIT_CASE(alloc_bench_single),
+    KUNIT_CASE(alloc_bench_contended),
+    {}
+};
+
+static struct kunit_suite alloc_test_suite = {
+    .name = "kernel_alloc",
+    .exit = alloc_test_exit,
+    .test_cases = alloc_test_cases,
+};
+
+kunit_test_suite(alloc_test_suite);
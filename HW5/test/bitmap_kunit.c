@@ -0,0 +1,297 @@
+// test/bitmap_kunit.c
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+#include "bitmap.h"
+
+/*
+ * Наборы KUnit для src/bitmap.c: граничные случаи поиска и сверка быстрых
+ * путей (сводки сегментов, пословный bitmap_next_change) с побитовым
+ * проходом на случайных картах. Собираются в модуль только с make kunit.
+ */
+
+static u32 bm_rand(u32 *state)
+{
+    u32 x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static unsigned char *bm_new(struct kunit *test, size_t total)
+{
+    unsigned char *bm = kunit_kzalloc(test, DIV_ROUND_UP(total, 8), GFP_KERNEL);
+
+    KUNIT_ASSERT_NOT_NULL(test, bm);
+    return bm;
+}
+
+static void bm_fill(unsigned char *bm, size_t start, size_t len)
+{
+    while (len--)
+        bm_set(bm, start++);
+}
+
+/* занятые отрезки случайной длины: от почти пустой до почти полной карты */
+static void bm_random(unsigned char *bm, size_t total, u32 *state,
+                      unsigned int used_pct)
+{
+    size_t i = 0;
+
+    memset(bm, 0, DIV_ROUND_UP(total, 8));
+    while (i < total) {
+        size_t run = 1 + bm_rand(state) % 96;
+        bool used = bm_rand(state) % 100 < used_pct;
+
+        run = min(run, total - i);
+        if (used)
+            bm_fill(bm, i, run);
+        i += run;
+    }
+}
+
+static void bitmap_test_first_fit(struct kunit *test)
+{
+    unsigned char *bm = bm_new(test, 64);
+    size_t start = 0;
+
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 64, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)0);
+
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 0, &start), -EINVAL);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 65, &start), -EINVAL);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 1, NULL), -EINVAL);
+
+    /* дыры 3 и 5 блоков, 4 влезает только во вторую */
+    bm_fill(bm, 0, 10);
+    bm_fill(bm, 13, 20);
+    bm_fill(bm, 38, 26);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 3, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)10);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 4, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)33);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 6, &start), -ENOSPC);
+
+    /* отрезок, упирающийся в конец карты */
+    memset(bm, 0xff, 8);
+    bm_clear(bm, 62);
+    bm_clear(bm, 63);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 2, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)62);
+    KUNIT_EXPECT_EQ(test, bitmap_first_fit(bm, 64, 3, &start), -ENOSPC);
+}
+
+static void bitmap_test_aligned_fit(struct kunit *test)
+{
+    unsigned char *bm = bm_new(test, 128);
+    size_t start = 0;
+
+    KUNIT_EXPECT_EQ(test, bitmap_aligned_fit(bm, 128, 4, 0, 0, &start), -EINVAL);
+
+    /* блок 1 занят: позиция 0 не годится, следующая по сетке 16 */
+    bm_set(bm, 1);
+    KUNIT_EXPECT_EQ(test, bitmap_aligned_fit(bm, 128, 4, 0, 16, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)16);
+
+    /* сетка со сдвигом first */
+    KUNIT_EXPECT_EQ(test, bitmap_aligned_fit(bm, 128, 4, 3, 8, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)3);
+
+    /* свободно только [100, 128): позиции сетки 16 — 112 */
+    memset(bm, 0, 16);
+    bm_fill(bm, 0, 100);
+    KUNIT_EXPECT_EQ(test, bitmap_aligned_fit(bm, 128, 16, 0, 16, &start), 0);
+    KUNIT_EXPECT_EQ(test, start, (size_t)112);
+    KUNIT_EXPECT_EQ(test, bitmap_aligned_fit(bm, 128, 17, 0, 16, &start), -ENOSPC);
+}
+
+static void bitmap_test_counts(struct kunit *test)
+{
+    unsigned char *bm = bm_new(test, 100);
+
+    KUNIT_EXPECT_EQ(test, bitmap_count_free(bm, 100), (size_t)100);
+    KUNIT_EXPECT_EQ(test, bitmap_largest_free_run(bm, 100), (size_t)100);
+
+    bm_fill(bm, 10, 5);
+    bm_fill(bm, 50, 1);
+    KUNIT_EXPECT_EQ(test, bitmap_count_free(bm, 100), (size_t)94);
+    KUNIT_EXPECT_EQ(test, bitmap_largest_free_run(bm, 100), (size_t)49);
+
+    bm_fill(bm, 0, 100);
+    KUNIT_EXPECT_EQ(test, bitmap_count_free(bm, 100), (size_t)0);
+    KUNIT_EXPECT_EQ(test, bitmap_largest_free_run(bm, 100), (size_t)0);
+}
+
+/* сводки сегментов дают тот же самый длинный отрезок, что и проход по битам */
+static void bitmap_test_seg_longest(struct kunit *test)
+{
+    /* неполный последний сегмент и хвост не кратный байту */
+    const size_t total = 5 * BITMAP_SEG_BLOCKS + 77;
+    size_t nr = bitmap_nr_segs(total), seg;
+    unsigned char *bm = bm_new(test, total);
+    struct bitmap_seg *segs;
+    unsigned int round, pct;
+    u32 state = 0x12345678;
+
+    segs = kunit_kcalloc(test, nr, sizeof(*segs), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, segs);
+
+    for (round = 0; round < 200; round++) {
+        pct = round % 10 * 11;
+        bm_random(bm, total, &state, pct);
+        for (seg = 0; seg < nr; seg++)
+            bitmap_seg_compute(bm, total, seg, &segs[seg]);
+
+        KUNIT_ASSERT_EQ_MSG(test, bitmap_seg_longest(segs, total),
+                            bitmap_largest_free_run(bm, total),
+                            "round %u used %u%%", round, pct);
+    }
+}
+
+static size_t next_change_naive(const unsigned char *bm, size_t total,
+                                size_t start)
+{
+    int used = bm_test(bm, start);
+    size_t i = start + 1;
+
+    while (i < total && bm_test(bm, i) == used)
+        i++;
+    return i;
+}
+
+static void bitmap_test_next_change(struct kunit *test)
+{
+    const size_t total = 1000;  /* не кратно 64: хвост идёт по битам */
+    unsigned char *bm = bm_new(test, total);
+    u32 state = 0xdeadbeef;
+    unsigned int round;
+    size_t i;
+
+    /* вся карта в одном состоянии: конец карты */
+    KUNIT_EXPECT_EQ(test, bitmap_next_change(bm, total, 0), total);
+    KUNIT_EXPECT_EQ(test, bitmap_next_change(bm, total, total - 1), total);
+
+    for (round = 0; round < 50; round++) {
+        bm_random(bm, total, &state, round % 2 ? 30 : 70);
+        for (i = 0; i < total; i++)
+            KUNIT_ASSERT_EQ_MSG(test, bitmap_next_change(bm, total, i),
+                                next_change_naive(bm, total, i),
+                                "round %u start %zu", round, i);
+    }
+}
+
+static void bitmap_test_to_string(struct kunit *test)
+{
+    unsigned char *bm = bm_new(test, 40);
+    char buf[64];
+
+    bm_fill(bm, 0, 2);
+    bm_set(bm, 33);
+    KUNIT_EXPECT_EQ(test, bitmap_to_string(bm, 4, buf, sizeof(buf)), 7);
+    KUNIT_EXPECT_STREQ(test, buf, "[XX..]\n");
+
+    /* после 32 блоков пробел */
+    KUNIT_EXPECT_EQ(test, bitmap_to_string(bm, 34, buf, sizeof(buf)), 38);
+    KUNIT_EXPECT_EQ(test, (int)buf[33], ' ');
+    KUNIT_EXPECT_EQ(test, (int)buf[35], 'X');
+
+    KUNIT_EXPECT_EQ(test, bitmap_to_string(bm, 4, buf, 3), -EINVAL);
+}
+
+/* обрезанный вывод целиком помещается в out_sz вместе с '\0' */
+static void bitmap_test_to_string_truncated(struct kunit *test)
+{
+    unsigned char *bm = bm_new(test, 256);
+    char buf[32];
+    size_t sz;
+    int ret;
+
+    for (sz = 4; sz < sizeof(buf); sz++) {
+        memset(buf, 0x5a, sizeof(buf));
+        ret = bitmap_to_string(bm, 256, buf, sz);
+
+        KUNIT_ASSERT_GT(test, ret, 0);
+        KUNIT_EXPECT_LT(test, (size_t)ret, sz);
+        KUNIT_EXPECT_EQ(test, (int)buf[ret], '\0');
+        KUNIT_EXPECT_EQ(test, (int)buf[ret - 1], '\n');
+        KUNIT_EXPECT_EQ_MSG(test, (int)buf[sz], 0x5a, "out_sz %zu", sz);
+    }
+}
+
+/* замеры: поиск по фрагментированной карте и полный пересчёт самого длинного отрезка */
+#define BITMAP_BENCH_BLOCKS (64 * 1024)
+#define BITMAP_BENCH_ROUNDS 200
+
+static void bitmap_bench(struct kunit *test)
+{
+    size_t nr = bitmap_nr_segs(BITMAP_BENCH_BLOCKS), seg, start, sum = 0;
+    unsigned char *bm = bm_new(test, BITMAP_BENCH_BLOCKS);
+    struct bitmap_seg *segs;
+    unsigned int r;
+    u32 state = 1;
+    u64 t0, fit_ns, run_ns, seg_ns, change_ns;
+
+    segs = kunit_kcalloc(test, nr, sizeof(*segs), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, segs);
+
+    /* 75% занято короткими отрезками, длинный свободный — только в конце */
+    bm_random(bm, BITMAP_BENCH_BLOCKS - 128, &state, 75);
+    for (seg = 0; seg < nr; seg++)
+        bitmap_seg_compute(bm, BITMAP_BENCH_BLOCKS, seg, &segs[seg]);
+
+    t0 = ktime_get_ns();
+    for (r = 0; r < BITMAP_BENCH_ROUNDS; r++)
+        if (!bitmap_first_fit(bm, BITMAP_BENCH_BLOCKS, 128, &start))
+            sum += start;
+    fit_ns = ktime_get_ns() - t0;
+
+    t0 = ktime_get_ns();
+    for (r = 0; r < BITMAP_BENCH_ROUNDS; r++)
+        sum += bitmap_largest_free_run(bm, BITMAP_BENCH_BLOCKS);
+    run_ns = ktime_get_ns() - t0;
+
+    t0 = ktime_get_ns();
+    for (r = 0; r < BITMAP_BENCH_ROUNDS; r++)
+        sum += bitmap_seg_longest(segs, BITMAP_BENCH_BLOCKS);
+    seg_ns = ktime_get_ns() - t0;
+
+    /* обход по отрезкам, как у карты в debugfs */
+    t0 = ktime_get_ns();
+    for (r = 0; r < BITMAP_BENCH_ROUNDS; r++)
+        for (start = 0; start < BITMAP_BENCH_BLOCKS;
+             start = bitmap_next_change(bm, BITMAP_BENCH_BLOCKS, start))
+            sum++;
+    change_ns = ktime_get_ns() - t0;
+
+    KUNIT_EXPECT_NE(test, sum, (size_t)0);
+    kunit_info(test, "%u blocks: first_fit %llu ns, largest_run %llu ns, seg_longest %llu ns, extent walk %llu ns\n",
+               BITMAP_BENCH_BLOCKS,
+               div_u64(fit_ns, BITMAP_BENCH_ROUNDS),
+               div_u64(run_ns, BITMAP_BENCH_ROUNDS),
+               div_u64(seg_ns, BITMAP_BENCH_ROUNDS),
+               div_u64(change_ns, BITMAP_BENCH_ROUNDS));
+}
+
+static struct kunit_case bitmap_test_cases[] = {
+    KUNIT_CASE(bitmap_test_first_fit),
+    KUNIT_CASE(bitmap_test_aligned_fit),
+    KUNIT_CASE(bitmap_test_counts),
+    KUNIT_CASE(bitmap_test_seg_longest),
+    KUNIT_CASE(bitmap_test_next_change),
+    KUNIT_CASE(bitmap_test_to_string),
+    KUNIT_CASE(bitmap_test_to_string_truncated),
+    KUNIT_CASE(bitmap_bench),
+    {}
+};
+
+static struct kunit_suite bitmap_test_suite = {
+    .name = "kernel_alloc_bitmap",
+    .test_cases = bitmap_test_cases,
+};
+
+kunit_test_suite(bitmap_test_suite);
@@ -0,0 +1,381 @@
+// user/bench.c
+/*
+ * Прогон трассы alloc/free через ядро аллокатора в userspace: задержки по
+ * операциям, фрагментация в конце, сверка allocator_verify и аппаратные
+ * счётчики perf на весь прогон (если ядро их даёт непривилегированным).
+ *
+ * Трасса — синтетическая (-n) или из файла (-t), строки:
+ *   a <id> <bytes>    выделить под id
+ *   f <id>            освободить id
+ */
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/seq_file.h>
+
+#include "allocator.h"
+#include "hist.h"
+
+struct op {
+    u32 id;
+    u32 bytes;                  /* 0 = free */
+};
+
+struct trace {
+    struct op *ops;
+    size_t nr;
+    size_t cap;
+    u32 nr_ids;
+};
+
+#define LAT_BUCKETS 40
+
+struct lat {
+    u64 n;
+    u64 sum;
+    u64 max;
+    u64 buckets[LAT_BUCKETS];   /* корзина b: [2^(b-1), 2^b) нс */
+};
+
+static void trace_push(struct trace *t, u32 id, u32 bytes)
+{
+    if (t->nr == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        t->ops = realloc(t->ops, t->cap * sizeof(*t->ops));
+        if (!t->ops) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    t->ops[t->nr++] = (struct op){ id, bytes };
+    if (id >= t->nr_ids)
+        t->nr_ids = id + 1;
+}
+
+static u32 xorshift(u32 *s)
+{
+    u32 x = *s;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+/* как replay в модуле: в основном мелкие, немного средних, редкие крупные */
+static u32 synth_size(u32 *s, size_t block)
+{
+    u32 r = xorshift(s) % 100;
+
+    if (r < 50)
+        return 16 + xorshift(s) % 2032;
+    if (r < 85)
+        return block + xorshift(s) % (4 * block);
+    if (r < 98)
+        return 5 * block + xorshift(s) % (28 * block);
+    return 33 * block + xorshift(s) % (96 * block);
+}
+
+/* занятость держится около 75% пула; free — случайный живой id */
+static void trace_synth(struct trace *t, size_t nr_ops, size_t pool, size_t block,
+                        u32 seed)
+{
+    u32 *live = malloc(nr_ops * sizeof(*live));
+    u32 *sizes = malloc(nr_ops * sizeof(*sizes));
+    size_t nr_live = 0, used = 0, i;
+    u32 next = 0;
+
+    if (!live || !sizes) {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (i = 0; i < nr_ops; i++) {
+        bool alloc = !nr_live ||
+            xorshift(&seed) % 100 < (used < pool * 3 / 4 ? 60 : 40);
+
+        if (alloc) {
+            u32 sz = synth_size(&seed, block);
+
+            sizes[next] = sz;
+            used += sz;
+            live[nr_live++] = next;
+            trace_push(t, next++, sz);
+        } else {
+            size_t k = xorshift(&seed) % nr_live;
+
+            used -= sizes[live[k]];
+            trace_push(t, live[k], 0);
+            live[k] = live[--nr_live];
+        }
+    }
+
+    free(live);
+    free(sizes);
+}
+
+static void trace_load(struct trace *t, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    unsigned long id, bytes;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "a %lu %lu", &id, &bytes) == 2 && bytes)
+            trace_push(t, id, bytes);
+        else if (sscanf(line, "f %lu", &id) == 1)
+            trace_push(t, id, 0);
+        else if (line[0] != '#' && line[0] != '\n')
+            fprintf(stderr, "%s: skipped: %s", path, line);
+    }
+
+    fclose(f);
+}
+
+static void lat_add(struct lat *l, u64 ns)
+{
+    l->n++;
+    l->sum += ns;
+    l->max = max(l->max, ns);
+    l->buckets[min_t(unsigned int, fls64(ns), LAT_BUCKETS - 1)]++;
+}
+
+static u64 lat_pct(const struct lat *l, unsigned int permille)
+{
+    u64 want = (l->n * permille + 999) / 1000, seen = 0;
+    unsigned int b;
+
+    for (b = 0; b < LAT_BUCKETS; b++) {
+        seen += l->buckets[b];
+        if (seen >= want)
+            return 1ull << b;
+    }
+    return 1ull << (LAT_BUCKETS - 1);
+}
+
+static void lat_print(const char *name, const struct lat *l)
+{
+    printf("%-6s n=%-9llu avg=%-6llu p50<%-6llu p99<%-7llu p999<%-8llu max=%llu ns\n",
+           name, l->n, l->n ? l->sum / l->n : 0, lat_pct(l, 500),
+           lat_pct(l, 990), lat_pct(l, 999), l->max);
+}
+
+/* счётчики одной группой; только user-space часть, чтобы хватало perf_event_paranoid=2 */
+static const struct {
+    u32 type;
+    u64 config;
+    const char *name;
+} perf_events[] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch-misses" },
+};
+
+#define NR_PERF ARRAY_SIZE(perf_events)
+
+static int perf_open(int *fds)
+{
+    unsigned int i;
+
+    for (i = 0; i < NR_PERF; i++) {
+        struct perf_event_attr attr = {
+            .size = sizeof(attr),
+            .type = perf_events[i].type,
+            .config = perf_events[i].config,
+            .disabled = i == 0,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+            .read_format = PERF_FORMAT_GROUP,
+        };
+
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, i ? fds[0] : -1, 0);
+        if (fds[i] < 0) {
+            int err = errno;
+
+            while (i--)
+                close(fds[i]);
+            return -err;
+        }
+    }
+    return 0;
+}
+
+static void perf_report(int *fds, size_t ops)
+{
+    struct {
+        u64 nr;
+        u64 val[NR_PERF];
+    } r;
+    unsigned int i;
+
+    if (read(fds[0], &r, sizeof(r)) != sizeof(r)) {
+        printf("perf: read failed\n");
+        return;
+    }
+
+    printf("perf:");
+    for (i = 0; i < NR_PERF; i++)
+        printf(" %s/op=%.1f", perf_events[i].name, (double)r.val[i] / ops);
+    printf("\n");
+
+    for (i = 0; i < NR_PERF; i++)
+        close(fds[i]);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-p first_fit|best_fit] [-b block] [-s pool_bytes] [-m max_pool_bytes]\n"
+            "          [-n ops | -t trace] [-r seed] [-Z] [-H]\n"
+            "  -Z  no background prezeroing\n"
+            "  -H  also print the allocator's internal histograms (lock hold, scan length)\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    struct allocator_config cfg = {
+        .pool_size = 64ul << 20,
+        .block_size = 4096,
+        .policy = ALLOC_POLICY_FIRST_FIT,
+        .backing = ALLOC_BACKING_VMALLOC,
+        .prezero = true,
+    };
+    struct trace t = { 0 };
+    struct lat la = { 0 }, lf = { 0 };
+    const char *trace_path = NULL;
+    size_t nr_ops = 1000000, fails = 0, i;
+    bool hist = false;
+    u32 seed = 0x9e3779b9;
+    int perf_fds[NR_PERF], perf_err, verify, c;
+    struct stats_info s;
+    void **ptrs;
+    u64 t0;
+
+    while ((c = getopt(argc, argv, "p:b:s:m:n:t:r:ZH")) != -1) {
+        switch (c) {
+        case 'p':
+            if (sysfs_streq(optarg, "best_fit"))
+                cfg.policy = ALLOC_POLICY_BEST_FIT;
+            else if (!sysfs_streq(optarg, "first_fit"))
+                usage(argv[0]);
+            break;
+        case 'b':
+            cfg.block_size = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            cfg.pool_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            cfg.max_pool_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            nr_ops = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            trace_path = optarg;
+            break;
+        case 'r':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'Z':
+            cfg.prezero = false;
+            break;
+        case 'H':
+            hist = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (trace_path)
+        trace_load(&t, trace_path);
+    else
+        trace_synth(&t, nr_ops, cfg.pool_size, cfg.block_size, seed);
+
+    if (allocator_init(&cfg) != ALLOC_OK) {
+        fprintf(stderr, "allocator_init failed\n");
+        return 1;
+    }
+
+    ptrs = calloc(t.nr_ids, sizeof(*ptrs));
+    if (!ptrs) {
+        perror("calloc");
+        return 1;
+    }
+
+    if (hist)
+        alloc_hist_enable(true);
+
+    perf_err = perf_open(perf_fds);
+    if (!perf_err) {
+        ioctl(perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    for (i = 0; i < t.nr; i++) {
+        const struct op *op = &t.ops[i];
+
+        if (op->bytes) {
+            /* id из файла может повториться без free: старое освобождаем */
+            if (ptrs[op->id])
+                allocator_free(ptrs[op->id]);
+
+            t0 = ktime_get_ns();
+            ptrs[op->id] = allocator_alloc(op->bytes);
+            lat_add(&la, ktime_get_ns() - t0);
+            if (!ptrs[op->id])
+                fails++;
+        } else if (ptrs[op->id]) {
+            t0 = ktime_get_ns();
+            allocator_free(ptrs[op->id]);
+            lat_add(&lf, ktime_get_ns() - t0);
+            ptrs[op->id] = NULL;
+        }
+    }
+
+    if (!perf_err)
+        ioctl(perf_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    s = allocator_get_stats();
+    verify = allocator_verify();
+
+    printf("trace: ops=%zu ids=%u pool=%zu block=%zu policy=%s prezero=%s\n",
+           t.nr, t.nr_ids, cfg.pool_size, cfg.block_size,
+           allocator_policy_name(cfg.policy), cfg.prezero ? "on" : "off");
+    lat_print("alloc", &la);
+    lat_print("free", &lf);
+    printf("fails=%zu frag_end=%zu%% arenas=%u verify=%s\n", fails,
+           s.fragmentation_percent, s.nr_arenas, verify ? "FAILED" : "ok");
+
+    if (perf_err)
+        printf("perf: unavailable (%s)\n", strerror(-perf_err));
+    else
+        perf_report(perf_fds, t.nr);
+
+    if (hist) {
+        struct seq_file m = { .f = stdout };
+
+        alloc_hist_show(&m);
+    }
+
+    for (i = 0; i < t.nr_ids; i++)
+        if (ptrs[i])
+            allocator_free(ptrs[i]);
+    allocator_cleanup();
+
+    free(ptrs);
+    free(t.ops);
+    return verify ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+// user/fuzz_alloc.c
+/*
+ * libFuzzer: вход — конфигурация пула и последовательность операций
+ * alloc/aligned/free/realloc/handle/compact над 32 ячейками. После каждой
+ * операции проверяется, что чужие данные не задеты, а периодически —
+ * allocator_verify. Любое расхождение — abort().
+ *
+ * Без libFuzzer (KA_FUZZ_MAIN) собирается драйвер: файлы из аргументов
+ * как входы или, без аргументов, случайные входы.
+ */
+#include "allocator.h"
+
+#define SLOTS 32
+
+struct slot {
+    u8 *ptr;
+    size_t bytes;
+    u32 handle;                 /* != 0: перемещаемый экстент, ptr не хранится */
+    u8 tag;
+};
+
+struct input {
+    const u8 *data;
+    size_t size;
+    size_t pos;
+};
+
+static struct slot slots[SLOTS];
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "fuzz_alloc: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+static u8 next_byte(struct input *in)
+{
+    return in->pos < in->size ? in->data[in->pos++] : 0;
+}
+
+/* мелкие размеры (size-классы) и блочные примерно поровну */
+static size_t next_size(struct input *in)
+{
+    u8 a = next_byte(in), b = next_byte(in);
+
+    if (a & 1)
+        return 1 + ((size_t)b << 3);
+    return 1 + ((size_t)(a >> 1) << 12) + b;
+}
+
+/* метка в первом и последнем байте */
+static void tag_set(u8 *p, size_t bytes, u8 tag)
+{
+    p[0] = tag;
+    p[bytes - 1] = tag;
+}
+
+static void tag_check(const u8 *p, size_t bytes, u8 tag)
+{
+    CHECK(p[0] == tag && p[bytes - 1] == tag);
+}
+
+static void slot_check(struct slot *s)
+{
+    u8 *p;
+
+    if (s->handle) {
+        p = allocator_handle_pin(s->handle);
+        CHECK(p);
+        tag_check(p, s->bytes, s->tag);
+        allocator_handle_unpin(s->handle);
+    } else if (s->ptr) {
+        tag_check(s->ptr, s->bytes, s->tag);
+    }
+}
+
+static void slot_release(struct slot *s)
+{
+    slot_check(s);
+    if (s->handle)
+        CHECK(allocator_handle_free(s->handle) == ALLOC_OK);
+    else if (s->ptr)
+        CHECK(allocator_free(s->ptr) == ALLOC_OK);
+    memset(s, 0, sizeof(*s));
+}
+
+/* новая память обнулена (флаг ALLOC_F_NOZERO не используется) */
+static void slot_fill(struct slot *s, u8 *p, size_t bytes, u8 tag)
+{
+    CHECK(p[0] == 0 && p[bytes - 1] == 0);
+    tag_set(p, bytes, tag);
+    s->ptr = p;
+    s->bytes = bytes;
+    s->tag = tag;
+}
+
+static void run_op(struct input *in, u8 op)
+{
+    struct slot *s = &slots[next_byte(in) % SLOTS];
+    size_t bytes, align;
+    u8 *p;
+
+    switch (op % 8) {
+    case 0:                     /* alloc */
+        bytes = next_size(in);
+        slot_release(s);
+        p = allocator_alloc(bytes);
+        if (p)
+            slot_fill(s, p, bytes, op);
+        break;
+
+    case 1:                     /* aligned */
+        bytes = next_size(in);
+        align = 1ul << (4 + next_byte(in) % 15);
+        slot_release(s);
+        p = allocator_alloc_aligned(bytes, align);
+        if (p) {
+            CHECK(((uintptr_t)p & (align - 1)) == 0);
+            slot_fill(s, p, bytes, op);
+        }
+        break;
+
+    case 2:                     /* free */
+        slot_release(s);
+        break;
+
+    case 3:                     /* realloc: данные до min(старый, новый) на месте */
+        if (!s->ptr)
+            break;
+        bytes = next_size(in);
+        p = allocator_realloc(s->ptr, bytes);
+        if (!p) {
+            slot_check(s);
+            break;
+        }
+        CHECK(p[0] == s->tag);
+        if (bytes > s->bytes)
+            CHECK(p[s->bytes - 1] == s->tag);
+        s->ptr = p;
+        s->bytes = bytes;
+        tag_set(p, bytes, s->tag);
+        break;
+
+    case 4:                     /* перемещаемый экстент */
+        bytes = next_size(in);
+        slot_release(s);
+        if (allocator_handle_alloc(bytes, &s->handle) != ALLOC_OK) {
+            s->handle = 0;
+            break;
+        }
+        p = allocator_handle_pin(s->handle);
+        CHECK(p);
+        s->bytes = bytes;
+        s->tag = op;
+        tag_set(p, bytes, op);
+        allocator_handle_unpin(s->handle);
+        break;
+
+    case 5:                     /* уплотнение на несколько шагов */
+        allocator_compact(next_byte(in) % 4);
+        break;
+
+    case 6:                     /* неверные free не должны проходить */
+        if (s->ptr) {
+            CHECK(allocator_free(s->ptr + 1) != ALLOC_OK);
+            slot_check(s);
+        }
+        if (s->handle) {
+            p = allocator_handle_pin(s->handle);
+            CHECK(allocator_free(p) != ALLOC_OK);
+            allocator_handle_unpin(s->handle);
+        }
+        break;
+
+    case 7:                     /* пересчитать всё */
+        CHECK(allocator_verify() == 0);
+        break;
+    }
+}
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+    struct input in = { data, size, 0 };
+    u8 conf = next_byte(&in);
+    struct allocator_config cfg = {
+        .pool_size = 64 * 4096,
+        .block_size = (conf & 4) ? 8192 : 4096,
+        .max_pool_size = 3 * 64 * 8192,
+        .policy = (conf & 1) ? ALLOC_POLICY_BEST_FIT : ALLOC_POLICY_FIRST_FIT,
+        .backing = ALLOC_BACKING_VMALLOC,
+        .prezero = conf & 2,
+        .compact_threshold = (conf & 8) ? 30 : 0,
+    };
+    struct stats_info st;
+    unsigned int i, n = 0;
+
+    /* фоновая работа прямо в queue_work: прогон воспроизводим */
+    kshim_sync_work = 1;
+
+    CHECK(allocator_init(&cfg) == ALLOC_OK);
+    memset(slots, 0, sizeof(slots));
+
+    while (in.pos < in.size) {
+        run_op(&in, next_byte(&in));
+        if (++n % 16 == 0)
+            CHECK(allocator_verify() == 0);
+    }
+
+    for (i = 0; i < SLOTS; i++)
+        slot_release(&slots[i]);
+
+    CHECK(allocator_verify() == 0);
+    st = allocator_get_stats();
+    CHECK(st.allocated_blocks == 0);
+
+    allocator_cleanup();
+    return 0;
+}
+
+#ifdef KA_FUZZ_MAIN
+static int run_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    static u8 buf[1 << 16];
+    size_t n;
+
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return LLVMFuzzerTestOneInput(buf, n);
+}
+
+int main(int argc, char **argv)
+{
+    static u8 buf[4096];
+    unsigned long runs = 2000, r;
+    u32 x = 0x2545f491;
+    int i;
+
+    if (argc > 1 && strcmp(argv[1], "-runs") != 0) {
+        for (i = 1; i < argc; i++)
+            if (run_file(argv[i]))
+                return 1;
+        return 0;
+    }
+
+    if (argc > 2)
+        runs = strtoul(argv[2], NULL, 0);
+
+    for (r = 0; r < runs; r++) {
+        size_t len = 1 + r % sizeof(buf), k;
+
+        for (k = 0; k < len; k++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            buf[k] = x;
+        }
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+
+    printf("fuzz_alloc: %lu random inputs ok\n", runs);
+    return 0;
+}
+#endif
@@ -0,0 +1,10 @@
+#include "../kshim.h"
+
+/* сборка userspace-версии только на little-endian */
+static inline u64 get_unaligned_le64(const void *p)
+{
+    u64 v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
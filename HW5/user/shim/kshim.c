@@ -0,0 +1,525 @@
+// user/shim/kshim.c
+#include "kshim.h"
+#include "linux/rbtree.h"
+#include "linux/xarray.h"
+
+int kshim_verbose;
+int kshim_sync_work;
+int kshim_nr_nodes = 1;
+__thread int kshim_cur_node;
+pthread_rwlock_t kshim_rcu = PTHREAD_RWLOCK_INITIALIZER;
+
+__attribute__((constructor)) static void kshim_env(void)
+{
+    const char *v = getenv("KA_VERBOSE");
+
+    kshim_verbose = v && *v == '1';
+}
+
+void *kshim_alloc_aligned(size_t align, size_t bytes, int fill)
+{
+    void *p = aligned_alloc(align, round_up(bytes, align));
+
+    if (p)
+        memset(p, fill, bytes);
+    return p;
+}
+
+/* ---- workqueue: один поток, очередь FIFO, повторная постановка схлопывается */
+
+static pthread_mutex_t wq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wq_cond = PTHREAD_COND_INITIALIZER;
+static struct work_struct *wq_head, *wq_tail, *wq_running;
+static bool wq_started;
+
+static void *wq_thread(void *arg)
+{
+    pthread_mutex_lock(&wq_lock);
+    for (;;) {
+        struct work_struct *w;
+
+        while (!wq_head)
+            pthread_cond_wait(&wq_cond, &wq_lock);
+
+        w = wq_head;
+        wq_head = w->next;
+        if (!wq_head)
+            wq_tail = NULL;
+        w->next = NULL;
+        w->pending = 0;
+        wq_running = w;
+        pthread_mutex_unlock(&wq_lock);
+
+        w->func(w);
+
+        pthread_mutex_lock(&wq_lock);
+        wq_running = NULL;
+        pthread_cond_broadcast(&wq_cond);
+    }
+    return NULL;
+}
+
+bool queue_work(void *wq, struct work_struct *w)
+{
+    pthread_t th;
+
+    if (kshim_sync_work) {
+        w->func(w);
+        return true;
+    }
+
+    pthread_mutex_lock(&wq_lock);
+    if (w->pending) {
+        pthread_mutex_unlock(&wq_lock);
+        return false;
+    }
+
+    if (!wq_started) {
+        pthread_create(&th, NULL, wq_thread, NULL);
+        pthread_detach(th);
+        wq_started = true;
+    }
+
+    w->pending = 1;
+    if (wq_tail)
+        wq_tail->next = w;
+    else
+        wq_head = w;
+    wq_tail = w;
+    pthread_cond_broadcast(&wq_cond);
+    pthread_mutex_unlock(&wq_lock);
+    return true;
+}
+
+/* снять из очереди и дождаться, если уже выполняется */
+bool cancel_work_sync(struct work_struct *w)
+{
+    struct work_struct **pp, *prev = NULL;
+    bool was_pending = false;
+
+    pthread_mutex_lock(&wq_lock);
+    for (pp = &wq_head; *pp; prev = *pp, pp = &(*pp)->next) {
+        if (*pp == w) {
+            *pp = w->next;
+            if (wq_tail == w)
+                wq_tail = prev;
+            w->next = NULL;
+            w->pending = 0;
+            was_pending = true;
+            break;
+        }
+    }
+
+    while (wq_running == w)
+        pthread_cond_wait(&wq_cond, &wq_lock);
+    pthread_mutex_unlock(&wq_lock);
+    return was_pending;
+}
+
+/* ---- rbtree: классические вставка и удаление с перекрашиванием */
+
+static void rb_set_child(struct rb_root *root, struct rb_node *parent,
+                         struct rb_node *old, struct rb_node *new)
+{
+    if (!parent)
+        root->rb_node = new;
+    else if (parent->rb_left == old)
+        parent->rb_left = new;
+    else
+        parent->rb_right = new;
+}
+
+static void rb_rotate_left(struct rb_root *root, struct rb_node *x)
+{
+    struct rb_node *y = x->rb_right;
+
+    x->rb_right = y->rb_left;
+    if (y->rb_left)
+        y->rb_left->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    rb_set_child(root, x->rb_parent, x, y);
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void rb_rotate_right(struct rb_root *root, struct rb_node *x)
+{
+    struct rb_node *y = x->rb_left;
+
+    x->rb_left = y->rb_right;
+    if (y->rb_right)
+        y->rb_right->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    rb_set_child(root, x->rb_parent, x, y);
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+static bool rb_is_red(const struct rb_node *n)
+{
+    return n && n->rb_red;
+}
+
+void rb_insert_color(struct rb_node *z, struct rb_root *root)
+{
+    struct rb_node *p, *g, *u;
+
+    while ((p = z->rb_parent) && p->rb_red) {
+        g = p->rb_parent;
+
+        if (p == g->rb_left) {
+            u = g->rb_right;
+            if (rb_is_red(u)) {
+                p->rb_red = u->rb_red = false;
+                g->rb_red = true;
+                z = g;
+                continue;
+            }
+            if (z == p->rb_right) {
+                rb_rotate_left(root, p);
+                z = p;
+                p = z->rb_parent;
+            }
+            p->rb_red = false;
+            g->rb_red = true;
+            rb_rotate_right(root, g);
+        } else {
+            u = g->rb_left;
+            if (rb_is_red(u)) {
+                p->rb_red = u->rb_red = false;
+                g->rb_red = true;
+                z = g;
+                continue;
+            }
+            if (z == p->rb_left) {
+                rb_rotate_right(root, p);
+                z = p;
+                p = z->rb_parent;
+            }
+            p->rb_red = false;
+            g->rb_red = true;
+            rb_rotate_left(root, g);
+        }
+    }
+
+    root->rb_node->rb_red = false;
+}
+
+static void rb_erase_fixup(struct rb_node *node, struct rb_node *parent,
+                           struct rb_root *root)
+{
+    struct rb_node *other;
+
+    while (!rb_is_red(node) && node != root->rb_node) {
+        if (parent->rb_left == node) {
+            other = parent->rb_right;
+            if (other->rb_red) {
+                other->rb_red = false;
+                parent->rb_red = true;
+                rb_rotate_left(root, parent);
+                other = parent->rb_right;
+            }
+            if (!rb_is_red(other->rb_left) && !rb_is_red(other->rb_right)) {
+                other->rb_red = true;
+                node = parent;
+                parent = node->rb_parent;
+            } else {
+                if (!rb_is_red(other->rb_right)) {
+                    other->rb_left->rb_red = false;
+                    other->rb_red = true;
+                    rb_rotate_right(root, other);
+                    other = parent->rb_right;
+                }
+                other->rb_red = parent->rb_red;
+                parent->rb_red = false;
+                other->rb_right->rb_red = false;
+                rb_rotate_left(root, parent);
+                node = root->rb_node;
+                break;
+            }
+        } else {
+            other = parent->rb_left;
+            if (other->rb_red) {
+                other->rb_red = false;
+                parent->rb_red = true;
+                rb_rotate_right(root, parent);
+                other = parent->rb_left;
+            }
+            if (!rb_is_red(other->rb_left) && !rb_is_red(other->rb_right)) {
+                other->rb_red = true;
+                node = parent;
+                parent = node->rb_parent;
+            } else {
+                if (!rb_is_red(other->rb_left)) {
+                    other->rb_right->rb_red = false;
+                    other->rb_red = true;
+                    rb_rotate_left(root, other);
+                    other = parent->rb_left;
+                }
+                other->rb_red = parent->rb_red;
+                parent->rb_red = false;
+                other->rb_left->rb_red = false;
+                rb_rotate_right(root, parent);
+                node = root->rb_node;
+                break;
+            }
+        }
+    }
+
+    if (node)
+        node->rb_red = false;
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *child, *parent;
+    bool red;
+
+    if (node->rb_left && node->rb_right) {
+        /* на место node встаёт его преемник */
+        struct rb_node *old = node;
+
+        node = node->rb_right;
+        while (node->rb_left)
+            node = node->rb_left;
+
+        rb_set_child(root, old->rb_parent, old, node);
+
+        child = node->rb_right;
+        parent = node->rb_parent;
+        red = node->rb_red;
+
+        if (parent == old) {
+            parent = node;
+        } else {
+            if (child)
+                child->rb_parent = parent;
+            parent->rb_left = child;
+            node->rb_right = old->rb_right;
+            old->rb_right->rb_parent = node;
+        }
+
+        node->rb_parent = old->rb_parent;
+        node->rb_red = old->rb_red;
+        node->rb_left = old->rb_left;
+        old->rb_left->rb_parent = node;
+    } else {
+        child = node->rb_left ? node->rb_left : node->rb_right;
+        parent = node->rb_parent;
+        red = node->rb_red;
+
+        if (child)
+            child->rb_parent = parent;
+        rb_set_child(root, parent, node, child);
+    }
+
+    if (!red)
+        rb_erase_fixup(child, parent, root);
+}
+
+struct rb_node *rb_first(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    while (n && n->rb_left)
+        n = n->rb_left;
+    return n;
+}
+
+struct rb_node *rb_last(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    while (n && n->rb_right)
+        n = n->rb_right;
+    return n;
+}
+
+struct rb_node *rb_next(const struct rb_node *n)
+{
+    struct rb_node *p;
+
+    if (n->rb_right) {
+        n = n->rb_right;
+        while (n->rb_left)
+            n = n->rb_left;
+        return (struct rb_node *)n;
+    }
+
+    while ((p = n->rb_parent) && n == p->rb_right)
+        n = p;
+    return p;
+}
+
+struct rb_node *rb_prev(const struct rb_node *n)
+{
+    struct rb_node *p;
+
+    if (n->rb_left) {
+        n = n->rb_left;
+        while (n->rb_right)
+            n = n->rb_right;
+        return (struct rb_node *)n;
+    }
+
+    while ((p = n->rb_parent) && n == p->rb_left)
+        n = p;
+    return p;
+}
+
+/* ---- xarray: упорядоченные непересекающиеся диапазоны */
+
+void xa_init_flags(struct xarray *xa, unsigned int flags)
+{
+    pthread_mutex_init(&xa->lock, NULL);
+    xa->r = NULL;
+    xa->nr = 0;
+    xa->cap = 0;
+    xa->flags = flags;
+}
+
+void xa_destroy(struct xarray *xa)
+{
+    free(xa->r);
+    xa->r = NULL;
+    xa->nr = 0;
+    xa->cap = 0;
+}
+
+/* первый диапазон с last >= index */
+static unsigned int xa_lower(const struct xarray *xa, unsigned long index)
+{
+    unsigned int lo = 0, hi = xa->nr;
+
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+
+        if (xa->r[mid].last < index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool xa_hit(const struct xarray *xa, unsigned int i, unsigned long index)
+{
+    return i < xa->nr && xa->r[i].first <= index;
+}
+
+void *xa_load(struct xarray *xa, unsigned long index)
+{
+    unsigned int i;
+    void *e = NULL;
+
+    pthread_mutex_lock(&xa->lock);
+    i = xa_lower(xa, index);
+    if (xa_hit(xa, i, index))
+        e = xa->r[i].entry;
+    pthread_mutex_unlock(&xa->lock);
+    return e;
+}
+
+static void xa_remove_at(struct xarray *xa, unsigned int i)
+{
+    memmove(&xa->r[i], &xa->r[i + 1], (xa->nr - i - 1) * sizeof(*xa->r));
+    xa->nr--;
+}
+
+/* вставить [first, last] на позицию i; пересечения — ошибка вызывающего */
+static int xa_insert_at(struct xarray *xa, unsigned int i, unsigned long first,
+                        unsigned long last, void *entry)
+{
+    if (xa->nr == xa->cap) {
+        unsigned int cap = xa->cap ? xa->cap * 2 : 16;
+        struct xa_range *r = realloc(xa->r, cap * sizeof(*r));
+
+        if (!r)
+            return -ENOMEM;
+        xa->r = r;
+        xa->cap = cap;
+    }
+
+    memmove(&xa->r[i + 1], &xa->r[i], (xa->nr - i) * sizeof(*xa->r));
+    xa->r[i] = (struct xa_range){ first, last, entry };
+    xa->nr++;
+    return 0;
+}
+
+/* только целые диапазоны: сначала снимается всё, что начинается в [first, last] */
+void *xa_store_range(struct xarray *xa, unsigned long first,
+                     unsigned long last, void *entry, gfp_t gfp)
+{
+    unsigned int i;
+    void *old = NULL;
+
+    pthread_mutex_lock(&xa->lock);
+    i = xa_lower(xa, first);
+    while (i < xa->nr && xa->r[i].first <= last) {
+        old = xa->r[i].entry;
+        xa_remove_at(xa, i);
+    }
+    if (entry)
+        xa_insert_at(xa, i, first, last, entry);
+    pthread_mutex_unlock(&xa->lock);
+    return old;
+}
+
+void *xa_store(struct xarray *xa, unsigned long index, void *entry, gfp_t gfp)
+{
+    unsigned int i;
+    void *old = NULL;
+
+    pthread_mutex_lock(&xa->lock);
+    i = xa_lower(xa, index);
+    if (xa_hit(xa, i, index)) {
+        old = xa->r[i].entry;
+        if (entry || (xa->flags & XA_FLAGS_ALLOC))
+            xa->r[i].entry = entry;   /* в allocating xarray NULL держит индекс */
+        else
+            xa_remove_at(xa, i);
+    } else if (entry) {
+        xa_insert_at(xa, i, index, index, entry);
+    }
+    pthread_mutex_unlock(&xa->lock);
+    return old;
+}
+
+void *xa_erase(struct xarray *xa, unsigned long index)
+{
+    unsigned int i;
+    void *old = NULL;
+
+    pthread_mutex_lock(&xa->lock);
+    i = xa_lower(xa, index);
+    if (xa_hit(xa, i, index)) {
+        old = xa->r[i].entry;
+        xa_remove_at(xa, i);
+    }
+    pthread_mutex_unlock(&xa->lock);
+    return old;
+}
+
+/* наименьший свободный индекс в [min, max], как в ядре */
+int xa_alloc(struct xarray *xa, u32 *id, void *entry, struct xa_limit limit,
+             gfp_t gfp)
+{
+    unsigned long want = limit.min;
+    unsigned int i;
+    int ret = -EBUSY;
+
+    if ((xa->flags & XA_FLAGS_ALLOC1) == XA_FLAGS_ALLOC1 && want < 1)
+        want = 1;
+
+    pthread_mutex_lock(&xa->lock);
+    for (i = xa_lower(xa, want); i < xa->nr && xa->r[i].first <= want; i++)
+        want = xa->r[i].last + 1;
+
+    if (want <= limit.max) {
+        ret = xa_insert_at(xa, i, want, want, entry);
+        if (!ret)
+            *id = want;
+    }
+    pthread_mutex_unlock(&xa->lock);
+    return ret;
+}
@@ -0,0 +1,297 @@
+/*
+ * Минимальная замена заголовков ядра для сборки ядра аллокатора
+ * (allocator.c, bitmap.c, size_class.c, extent_tree.c, hist.c) в userspace.
+ * Только то, чем эти файлы пользуются; семантика — ровно та, на которую
+ * они полагаются. spinlock — pthread mutex, память — malloc, фоновые
+ * work_struct — один поток-исполнитель.
+ */
+#ifndef KSHIM_H
+#define KSHIM_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* типы */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef unsigned int gfp_t;
+
+#define KBUILD_MODNAME "kernel_alloc"
+#define __init
+#define __exit
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+
+/* printk: pr_info только при KA_VERBOSE=1, иначе горячий путь меряет printf */
+extern int kshim_verbose;
+
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+#define pr_info(fmt, ...) \
+    do { if (kshim_verbose) printf(pr_fmt(fmt), ##__VA_ARGS__); } while (0)
+#define pr_debug(fmt, ...) do { } while (0)
+#define pr_err(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warn pr_err
+#define scnprintf(buf, sz, ...) \
+    ({ size_t __sz = (sz); int __n = snprintf(buf, __sz, __VA_ARGS__); \
+       __sz == 0 ? 0 : __n >= (int)__sz ? (int)__sz - 1 : __n; })
+
+#define WARN_ON_ONCE(c) ({ \
+    int __c = !!(c); \
+    if (__c) fprintf(stderr, "WARN_ON_ONCE at %s:%d\n", __FILE__, __LINE__); \
+    __c; })
+#define WARN_ON(c) WARN_ON_ONCE(c)
+#define BUILD_BUG_ON(c) _Static_assert(!(c), #c)
+
+/* арифметика */
+#define min(a, b) ({ __typeof__(a) __a = (a); __typeof__(b) __b = (b); __a < __b ? __a : __b; })
+#define max(a, b) ({ __typeof__(a) __a = (a); __typeof__(b) __b = (b); __a > __b ? __a : __b; })
+#define min_t(t, a, b) ({ t __a = (a); t __b = (b); __a < __b ? __a : __b; })
+#define max_t(t, a, b) ({ t __a = (a); t __b = (b); __a > __b ? __a : __b; })
+#define round_up(x, y) ((((x) - 1) | ((__typeof__(x))((y) - 1))) + 1)
+#define round_down(x, y) ((x) & ~((__typeof__(x))((y) - 1)))
+#define ALIGN(x, a) round_up(x, a)
+#define IS_ALIGNED(x, a) (((x) & ((__typeof__(x))(a) - 1)) == 0)
+#define PTR_ALIGN(p, a) ((__typeof__(p))ALIGN((uintptr_t)(p), (a)))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+    ((type *)((char *)(ptr) - offsetof(type, member)))
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+static inline u64 div_u64(u64 a, u32 b) { return a / b; }
+static inline bool is_power_of_2(unsigned long n) { return n && !(n & (n - 1)); }
+static inline int ilog2(unsigned long n) { return 63 - __builtin_clzl(n); }
+static inline unsigned long roundup_pow_of_two(unsigned long n)
+{
+    return n <= 1 ? 1 : 1ul << (64 - __builtin_clzl(n - 1));
+}
+
+/* биты */
+#define BITS_PER_LONG 64
+#define BITS_TO_LONGS(n) DIV_ROUND_UP(n, BITS_PER_LONG)
+#define BIT_WORD(nr) ((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr) (1ul << ((nr) % BITS_PER_LONG))
+
+static inline void set_bit(long nr, unsigned long *a)
+{
+    __atomic_fetch_or(&a[BIT_WORD(nr)], BIT_MASK(nr), __ATOMIC_RELAXED);
+}
+
+static inline void clear_bit(long nr, unsigned long *a)
+{
+    __atomic_fetch_and(&a[BIT_WORD(nr)], ~BIT_MASK(nr), __ATOMIC_RELAXED);
+}
+
+static inline bool test_bit(long nr, const unsigned long *a)
+{
+    return __atomic_load_n(&a[BIT_WORD(nr)], __ATOMIC_RELAXED) & BIT_MASK(nr);
+}
+
+static inline bool test_and_set_bit(long nr, unsigned long *a)
+{
+    return __atomic_fetch_or(&a[BIT_WORD(nr)], BIT_MASK(nr), __ATOMIC_SEQ_CST) & BIT_MASK(nr);
+}
+
+static inline bool test_and_clear_bit(long nr, unsigned long *a)
+{
+    return __atomic_fetch_and(&a[BIT_WORD(nr)], ~BIT_MASK(nr), __ATOMIC_SEQ_CST) & BIT_MASK(nr);
+}
+
+static inline bool __test_and_set_bit(long nr, unsigned long *a)
+{
+    bool old = a[BIT_WORD(nr)] & BIT_MASK(nr);
+
+    a[BIT_WORD(nr)] |= BIT_MASK(nr);
+    return old;
+}
+
+static inline unsigned long __ffs64(u64 x) { return __builtin_ctzll(x); }
+static inline int fls64(u64 x) { return x ? 64 - __builtin_clzll(x) : 0; }
+
+static inline unsigned long *bitmap_zalloc(unsigned int nbits, gfp_t gfp)
+{
+    return calloc(BITS_TO_LONGS(nbits), sizeof(unsigned long));
+}
+
+static inline void bitmap_free(unsigned long *b) { free(b); }
+
+static inline unsigned int bitmap_weight(const unsigned long *a, unsigned int nbits)
+{
+    unsigned int i, w = 0;
+
+    for (i = 0; i < nbits / BITS_PER_LONG; i++)
+        w += __builtin_popcountl(a[i]);
+    if (nbits % BITS_PER_LONG)
+        w += __builtin_popcountl(a[i] & (BIT_MASK(nbits) - 1));
+    return w;
+}
+
+/* атомики и барьеры */
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v) (*(volatile __typeof__(x) *)&(x) = (v))
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+typedef struct { long counter; } atomic_long_t;
+#define ATOMIC_LONG_INIT(v) { (v) }
+#define atomic_long_read(a) __atomic_load_n(&(a)->counter, __ATOMIC_RELAXED)
+#define atomic_long_set(a, v) __atomic_store_n(&(a)->counter, v, __ATOMIC_RELAXED)
+#define atomic_long_inc(a) ((void)__atomic_fetch_add(&(a)->counter, 1, __ATOMIC_RELAXED))
+#define atomic_long_dec(a) ((void)__atomic_fetch_sub(&(a)->counter, 1, __ATOMIC_RELAXED))
+#define atomic_long_add(v, a) ((void)__atomic_fetch_add(&(a)->counter, v, __ATOMIC_RELAXED))
+
+/* блокировки: irqsave в userspace просто не нужен */
+typedef struct { pthread_mutex_t m; } spinlock_t;
+#define spin_lock_init(l) pthread_mutex_init(&(l)->m, NULL)
+#define spin_lock(l) pthread_mutex_lock(&(l)->m)
+#define spin_unlock(l) pthread_mutex_unlock(&(l)->m)
+#define spin_lock_irqsave(l, f) do { (f) = 0; pthread_mutex_lock(&(l)->m); } while (0)
+#define spin_unlock_irqrestore(l, f) do { (void)(f); pthread_mutex_unlock(&(l)->m); } while (0)
+
+/*
+ * RCU: читатели под rwlock на чтение, kfree_rcu ждёт их всех, взяв его на
+ * запись, — грубо, но освобождённое под читателем ASan увидел бы.
+ */
+struct rcu_head { void *unused; };
+extern pthread_rwlock_t kshim_rcu;
+#define rcu_read_lock() pthread_rwlock_rdlock(&kshim_rcu)
+#define rcu_read_unlock() pthread_rwlock_unlock(&kshim_rcu)
+#define synchronize_rcu() \
+    do { pthread_rwlock_wrlock(&kshim_rcu); pthread_rwlock_unlock(&kshim_rcu); } while (0)
+#define kfree_rcu(p, field) do { synchronize_rcu(); free(p); } while (0)
+
+struct mutex { pthread_mutex_t m; };
+#define DEFINE_MUTEX(n) struct mutex n = { PTHREAD_MUTEX_INITIALIZER }
+#define mutex_init(l) pthread_mutex_init(&(l)->m, NULL)
+#define mutex_lock(l) pthread_mutex_lock(&(l)->m)
+#define mutex_unlock(l) pthread_mutex_unlock(&(l)->m)
+#define mutex_trylock(l) (pthread_mutex_trylock(&(l)->m) == 0)
+
+/* память */
+#define GFP_KERNEL 0u
+#define GFP_ATOMIC 0u
+#define __GFP_NOWARN 0u
+#define __GFP_ZERO 0u
+#define __GFP_NORETRY 0u
+#define __GFP_COMP 0u
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1ul << PAGE_SHIFT)
+#define PMD_SHIFT 21
+#define PMD_SIZE (1ul << PMD_SHIFT)
+#define MAX_ORDER 11
+
+void *kshim_alloc_aligned(size_t align, size_t bytes, int fill);
+
+#define kmalloc(n, g) malloc(n)
+#define kzalloc(n, g) calloc(1, n)
+#define kcalloc(n, s, g) calloc(n, s)
+#define kmalloc_array(n, s, g) malloc((size_t)(n) * (s))
+#define kfree(p) free(p)
+#define kvmalloc(n, g) malloc(n)
+#define kvzalloc(n, g) calloc(1, n)
+#define kvcalloc(n, s, g) calloc(n, s)
+#define kvmalloc_array(n, s, g) malloc((size_t)(n) * (s))
+#define kvfree(p) free(p)
+#define kzalloc_node(n, g, nid) calloc(1, n)
+
+/* vmalloc в ядре отдаёт мусор: заполняем, чтобы забытое обнуление было видно */
+#define vmalloc(n) kshim_alloc_aligned(PAGE_SIZE, n, 0xa5)
+#define vzalloc(n) kshim_alloc_aligned(PAGE_SIZE, n, 0)
+#define vmalloc_node(n, nid) vmalloc(n)
+#define vmalloc_huge(n, g) kshim_alloc_aligned(PMD_SIZE, n, 0xa5)
+#define vfree(p) free(p)
+#define alloc_pages_exact(n, g) kshim_alloc_aligned(PAGE_SIZE, n, 0xa5)
+#define alloc_pages_exact_nid(nid, n, g) alloc_pages_exact(n, g)
+#define free_pages_exact(p, n) free(p)
+
+static inline int get_order(unsigned long size)
+{
+    return size <= PAGE_SIZE ? 0 : 64 - __builtin_clzl((size - 1) >> PAGE_SHIFT);
+}
+
+/* страниц нет: page — это просто адрес, pfn — адрес >> PAGE_SHIFT */
+struct page;
+#define is_vmalloc_addr(p) true
+#define vmalloc_to_page(p) ((struct page *)(p))
+#define virt_to_page(p) ((struct page *)(p))
+#define vmalloc_to_pfn(p) ((unsigned long)(uintptr_t)(p) >> PAGE_SHIFT)
+
+/* NUMA: kshim_nr_nodes узлов, текущий — kshim_cur_node */
+#define NUMA_NO_NODE (-1)
+extern int kshim_nr_nodes;
+extern __thread int kshim_cur_node;
+#define numa_node_id() kshim_cur_node
+#define num_online_nodes() kshim_nr_nodes
+#define for_each_online_node(n) for ((n) = 0; (n) < kshim_nr_nodes; (n)++)
+
+/* время и планировщик */
+static inline u64 ktime_get_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define cond_resched() do { } while (0)
+
+/* jiffies — те же миллисекунды CLOCK_MONOTONIC */
+#define HZ 1000
+#define jiffies ((unsigned long)(ktime_get_ns() / 1000000))
+#define time_after(a, b) ((long)((b) - (a)) < 0)
+#define time_before(a, b) time_after(b, a)
+
+/*
+ * Отложенная работа. По умолчанию её выполняет фоновый поток, как
+ * system_unbound_wq; kshim_sync_work = 1 выполняет прямо в queue_work —
+ * для воспроизводимости под фаззером.
+ */
+struct work_struct {
+    void (*func)(struct work_struct *);
+    struct work_struct *next;
+    int pending;
+};
+
+extern int kshim_sync_work;
+#define system_unbound_wq NULL
+#define system_wq NULL
+#define INIT_WORK(w, f) ((w)->func = (f), (w)->next = NULL, (w)->pending = 0)
+bool queue_work(void *wq, struct work_struct *w);
+bool cancel_work_sync(struct work_struct *w);
+#define schedule_work(w) queue_work(NULL, w)
+
+/* строки */
+static inline bool sysfs_streq(const char *a, const char *b)
+{
+    size_t n = strlen(b);
+
+    return !strncmp(a, b, n) && (a[n] == '\0' || (a[n] == '\n' && a[n + 1] == '\0'));
+}
+
+#define kstrtouint(s, base, res) \
+    ({ char *__e; unsigned long __v = strtoul(s, &__e, base); \
+       *(res) = (unsigned int)__v; (__e == (s) || (*__e && *__e != '\n')) ? -EINVAL : 0; })
+#define kstrtou32 kstrtouint
+
+#endif
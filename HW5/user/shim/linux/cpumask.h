@@ -0,0 +1,4 @@
+#include "../kshim.h"
+
+/* счётчики "по CPU" в userspace общие, CPU один */
+#define for_each_possible_cpu(cpu) for ((cpu) = 0; (cpu) < 1; (cpu)++)
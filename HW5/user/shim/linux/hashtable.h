@@ -0,0 +1,70 @@
+#ifndef KSHIM_HASHTABLE_H
+#define KSHIM_HASHTABLE_H
+
+#include "../kshim.h"
+
+struct hlist_node {
+    struct hlist_node *next, **pprev;
+};
+
+struct hlist_head {
+    struct hlist_node *first;
+};
+
+#define HLIST_HEAD(name) struct hlist_head name = { NULL }
+
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+    n->next = h->first;
+    if (h->first)
+        h->first->pprev = &n->next;
+    h->first = n;
+    n->pprev = &h->first;
+}
+
+static inline void hlist_del_init(struct hlist_node *n)
+{
+    if (!n->pprev)
+        return;
+    *n->pprev = n->next;
+    if (n->next)
+        n->next->pprev = n->pprev;
+    n->next = NULL;
+    n->pprev = NULL;
+}
+
+static inline bool hlist_empty(const struct hlist_head *h)
+{
+    return !h->first;
+}
+
+#define hlist_entry_safe(ptr, type, member) \
+    ((ptr) ? container_of(ptr, type, member) : NULL)
+#define hlist_for_each_entry(pos, head, member) \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member); pos; \
+         pos = hlist_entry_safe((pos)->member.next, __typeof__(*(pos)), member))
+#define hlist_for_each_entry_safe(pos, n, head, member) \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*pos), member); \
+         pos && ({ n = pos->member.next; 1; }); \
+         pos = hlist_entry_safe(n, __typeof__(*pos), member))
+
+/* хеш тот же, что hash_64 в ядре (золотое сечение) */
+#define DECLARE_HASHTABLE(name, bits) struct hlist_head name[1 << (bits)]
+#define HASH_SIZE(name) ARRAY_SIZE(name)
+#define HASH_BITS(name) __builtin_ctzl(HASH_SIZE(name))
+#define hash_min(val, bits) \
+    ((unsigned long)(((u64)(val) * 0x61C8864680B583EBull) >> (64 - (bits))))
+#define hash_init(name) memset(name, 0, sizeof(name))
+#define hash_add(name, node, key) \
+    hlist_add_head(node, &(name)[hash_min(key, HASH_BITS(name))])
+#define hash_del(node) hlist_del_init(node)
+#define hash_for_each(name, bkt, obj, member) \
+    for ((bkt) = 0; (bkt) < (int)HASH_SIZE(name); (bkt)++) \
+        hlist_for_each_entry(obj, &(name)[bkt], member)
+#define hash_for_each_safe(name, bkt, tmp, obj, member) \
+    for ((bkt) = 0; (bkt) < (int)HASH_SIZE(name); (bkt)++) \
+        hlist_for_each_entry_safe(obj, tmp, &(name)[bkt], member)
+#define hash_for_each_possible(name, obj, member, key) \
+    hlist_for_each_entry(obj, &(name)[hash_min(key, HASH_BITS(name))], member)
+
+#endif
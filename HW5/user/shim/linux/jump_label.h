@@ -0,0 +1,12 @@
+#include "../kshim.h"
+
+/* static key — обычный флаг: переходы не патчатся, но логика та же */
+struct static_key_false {
+    int enabled;
+};
+
+#define DECLARE_STATIC_KEY_FALSE(name) extern struct static_key_false name
+#define DEFINE_STATIC_KEY_FALSE(name) struct static_key_false name
+#define static_branch_unlikely(key) unlikely(__atomic_load_n(&(key)->enabled, __ATOMIC_RELAXED))
+#define static_branch_enable(key) __atomic_store_n(&(key)->enabled, 1, __ATOMIC_RELAXED)
+#define static_branch_disable(key) __atomic_store_n(&(key)->enabled, 0, __ATOMIC_RELAXED)
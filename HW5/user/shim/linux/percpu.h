@@ -0,0 +1,6 @@
+#include "../kshim.h"
+
+#define DECLARE_PER_CPU(type, name) extern type name
+#define DEFINE_PER_CPU(type, name) type name
+#define per_cpu_ptr(ptr, cpu) (ptr)
+#define this_cpu_inc(var) ((void)__atomic_fetch_add(&(var), 1, __ATOMIC_RELAXED))
@@ -0,0 +1,38 @@
+#ifndef KSHIM_RBTREE_H
+#define KSHIM_RBTREE_H
+
+#include "../kshim.h"
+
+/* красно-чёрное дерево с API ядра; балансировка в kshim.c */
+struct rb_node {
+    struct rb_node *rb_parent;
+    struct rb_node *rb_left;
+    struct rb_node *rb_right;
+    bool rb_red;
+};
+
+struct rb_root {
+    struct rb_node *rb_node;
+};
+
+#define RB_ROOT ((struct rb_root){ NULL })
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **link)
+{
+    node->rb_parent = parent;
+    node->rb_left = NULL;
+    node->rb_right = NULL;
+    node->rb_red = true;
+    *link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+#endif
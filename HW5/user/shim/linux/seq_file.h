@@ -0,0 +1,10 @@
+#include "../kshim.h"
+
+/* seq_file поверх FILE *: alloc_hist_show пишет прямо в поток */
+struct seq_file {
+    FILE *f;
+};
+
+#define seq_printf(m, ...) fprintf((m)->f, __VA_ARGS__)
+#define seq_puts(m, s) fputs(s, (m)->f)
+#define seq_putc(m, c) fputc(c, (m)->f)
@@ -0,0 +1,24 @@
+#pragma once
+#include "../kshim.h"
+
+/*
+ * События ядра здесь не пишутся: trace_<name>() пустая, а
+ * trace_<name>_enabled() всегда false, поэтому замеры под ней не делаются.
+ */
+#define TP_PROTO(args...) args
+#define TP_ARGS(args...) args
+#define TP_STRUCT__entry(args...)
+#define TP_fast_assign(args...)
+#define TP_printk(fmt, args...)
+
+#define KSHIM_TRACE(name, proto) \
+    static inline void trace_##name(proto) {} \
+    static inline bool trace_##name##_enabled(void) { return false; }
+
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+    KSHIM_TRACE(name, PARAMS(proto))
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args) \
+    KSHIM_TRACE(name, PARAMS(proto))
+
+#define PARAMS(args...) args
@@ -0,0 +1,51 @@
+#ifndef KSHIM_XARRAY_H
+#define KSHIM_XARRAY_H
+
+#include "../kshim.h"
+
+/*
+ * xarray как упорядоченный массив диапазонов [first, last] -> entry с
+ * двоичным поиском. Хватает для индекса арен (мало длинных диапазонов)
+ * и handle (точечные записи); лок — как внутренний xa_lock.
+ */
+struct xa_range {
+    unsigned long first;
+    unsigned long last;
+    void *entry;
+};
+
+struct xarray {
+    pthread_mutex_t lock;
+    struct xa_range *r;
+    unsigned int nr;
+    unsigned int cap;
+    unsigned int flags;
+};
+
+struct xa_limit {
+    u32 max;
+    u32 min;
+};
+
+#define XA_FLAGS_ALLOC 1u
+#define XA_FLAGS_ALLOC1 3u
+#define xa_limit_31b ((struct xa_limit){ .max = 0x7fffffff, .min = 0 })
+#define xa_limit_32b ((struct xa_limit){ .max = 0xffffffff, .min = 0 })
+
+void xa_init_flags(struct xarray *xa, unsigned int flags);
+#define xa_init(xa) xa_init_flags(xa, 0)
+void xa_destroy(struct xarray *xa);
+void *xa_load(struct xarray *xa, unsigned long index);
+void *xa_store_range(struct xarray *xa, unsigned long first,
+                     unsigned long last, void *entry, gfp_t gfp);
+void *xa_store(struct xarray *xa, unsigned long index, void *entry, gfp_t gfp);
+void *xa_erase(struct xarray *xa, unsigned long index);
+int xa_alloc(struct xarray *xa, u32 *id, void *entry, struct xa_limit limit,
+             gfp_t gfp);
+
+static inline bool xa_is_err(const void *entry)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1 @@
+/* второе чтение заголовка событий не нужно: всё уже развернуто в linux/tracepoint.h */
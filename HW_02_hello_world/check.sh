@@ -25,7 +25,7 @@ sudo dmesg -C >/dev/null 2>&1 || true
 sudo insmod "$KO"
 
 # проверить параметры
-for p in idx ch_val my_str; do
+for p in idx ch_val range my_str; do
   if [[ ! -e "${PARAM_DIR}/${p}" ]]; then
     echo "ERROR: missing parameter ${PARAM_DIR}/${p}" >&2
     exit 2
@@ -64,6 +64,67 @@ if [[ "$got" != "$PHRASE" ]]; then
   exit 4
 fi
 
+# range: кусок текста одной записью, поверх и за концом (дыра — пробелы)
+wparam "${PARAM_DIR}/range" "7 there"
+wparam "${PARAM_DIR}/range" "15 x"
+got="$(cat "${PARAM_DIR}/my_str" | tr -d '\n')"
+if [[ "$got" != "Hello, there!  x" ]]; then
+  echo "ERROR: range write mismatch, got '$got'"
+  exit 7
+fi
+
+# /dev/my_str: строка длиннее страницы, запись с позиции (dd seek)
+DEV="/dev/my_str"
+[[ -c "$DEV" ]] || { echo "ERROR: missing $DEV"; exit 8; }
+head -c 10000 /dev/zero | tr '\0' a | sudo dd of="$DEV" bs=4096 seek=100 oflag=seek_bytes conv=notrunc status=none
+len="$(sudo cat "$DEV" | wc -c)"
+tail_a="$(sudo dd if="$DEV" bs=4096 skip=100 iflag=skip_bytes status=none | tr -d a | wc -c)"
+if [[ "$len" != "10100" || "$tail_a" != "0" ]]; then
+  echo "ERROR: $DEV expected 10100 bytes ending in 10000 'a', got len=$len stray=$tail_a"
+  exit 9
+fi
+
+# читатели без lock: range целиком виден или не виден, "половины" нет
+A="$(printf 'A%.0s' {1..64})"
+B="$(printf 'B%.0s' {1..64})"
+# начало строки — A до старта писателя: иначе первое чтение застанет "Hello"
+wparam "${PARAM_DIR}/range" "0 $A"
+sudo bash -c 'for i in $(seq 200); do echo "0 $2" > "$1/range"; echo "0 $3" > "$1/range"; done' _ "$PARAM_DIR" "$A" "$B" &
+WR=$!
+for i in $(seq 200); do
+  head="$(head -c 64 "${PARAM_DIR}/my_str")"
+  if [[ "$head" != "$A" && "$head" != "$B" ]]; then
+    echo "ERROR: torn my_str read: '$head'"
+    exit 10
+  fi
+done
+wait "$WR" || { echo "ERROR: background range writer failed"; exit 11; }
+
+# запись через старый конец: перезапись и новая длина видны вместе.
+# Каждая запись — 16 одинаковых букв с отступом 8 от конца, поэтому в
+# любой целой версии последние 16 байт одинаковые; старая длина с уже
+# перезаписанным началом дала бы 8 старых букв и 8 новых.
+sudo rmmod "$MODNAME"
+sudo insmod "$KO"
+got="$(cat "${PARAM_DIR}/my_str")"
+P=$(( ${#got} > 8 ? ${#got} - 8 : 0 ))
+wparam "${PARAM_DIR}/range" "$P $(printf 'A%.0s' {1..16})"
+L=$((P + 16))
+sudo bash -c 'L=$2; for i in $(seq 300); do
+    c=A; [[ $((i % 2)) == 1 ]] && c=B
+    echo "$((L - 8)) $(printf "$c%.0s" {1..16})" > "$1/range"; L=$((L + 8))
+  done' _ "$PARAM_DIR" "$L" &
+WR=$!
+for i in $(seq 300); do
+  s="$(cat "${PARAM_DIR}/my_str")"
+  t="${s: -16}"
+  if [[ "$t" != "$(printf 'A%.0s' {1..16})" && "$t" != "$(printf 'B%.0s' {1..16})" ]]; then
+    echo "ERROR: torn straddling write: tail '$t' at length ${#s}"
+    exit 12
+  fi
+done
+wait "$WR" || { echo "ERROR: background straddling writer failed"; exit 13; }
+
 sudo rmmod "$MODNAME"
 
 dmesg_out="$(sudo dmesg || true)"
@@ -6,41 +6,223 @@
 #include <linux/moduleparam.h>
 #include <linux/kernel.h>
 #include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/rcupdate.h>
+#include <linux/overflow.h>
 #include <linux/ctype.h>
 #include <linux/string.h>
 #include <linux/errno.h>
 #include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
 
-#define MAX_SIZE 64
+/* предел длины my_str; память берётся страницами по мере записи */
+#define MAX_SIZE (16U << 20)
+#define CHUNK    PAGE_SIZE
 
+/* lock сериализует только писателей; читатели его не берут */
 static DEFINE_MUTEX(lock);
 
-/* idx — индекс в массиве (0..MAX_SIZE-2, чтобы оставалось место под '\0') */
+/* idx — индекс в строке (0..MAX_SIZE-1) */
 static unsigned int idx;
 
 /* ch_val — ASCII-код последнего записанного символа */
 static unsigned int ch_val;
 
-/* my_str — итоговая строка (read-only) */
-static char my_str[MAX_SIZE];
-static size_t my_len;
+/*
+ * my_str — итоговая строка (read-only), лежит кусками по странице:
+ * pages[i] — байты [i * CHUNK, (i + 1) * CHUNK). При росте строка не
+ * переезжает, удваивается только массив указателей, так что запись len
+ * байт стоит O(len), а не O(длины строки). '\0' в конце не хранится.
+ *
+ * Читатели не берут lock:
+ *  - массив указателей подменяется через RCU, старый освобождается
+ *    после grace period; сами страницы живут до выгрузки модуля;
+ *  - my_len публикуется release после того, как байты за старым концом
+ *    записаны, поэтому дописывание в конец читателей не задевает;
+ *  - перезапись уже видимых байт идёт внутри my_seq, читатель,
+ *    попавший на неё, повторяет копирование. Если запись ещё и выходит
+ *    за конец, новая длина публикуется в той же секции my_seq.
+ * Гарантия: снимок (my_str_snapshot) — байты одной версии строки,
+ * между двумя записями, без "половины" записи. Одна запись — это
+ * ch_val, range или кусок write() на /dev/my_str не больше страницы.
+ */
+struct chunk_map {
+    struct rcu_head rcu;
+    size_t cap;
+    char *pages[];
+};
+
+static struct chunk_map __rcu *map;
+static size_t nr_chunks;            /* под lock */
+static size_t my_len;               /* пишут под lock, читают acquire */
+static seqcount_mutex_t my_seq = SEQCNT_MUTEX_ZERO(my_seq, &lock);
+
+static struct chunk_map *map_locked(void)
+{
+    return rcu_dereference_protected(map, lockdep_is_held(&lock));
+}
+
+/* под lock: страниц хватает на new_len байт */
+static int grow_chunks(size_t new_len)
+{
+    struct chunk_map *m = map_locked(), *nm;
+    size_t need = DIV_ROUND_UP(new_len, CHUNK), cap;
+
+    if (!m || need > m->cap) {
+        cap = max(need, m ? 2 * m->cap : 1);
+        nm = kmalloc(struct_size(nm, pages, cap), GFP_KERNEL);
+        if (!nm)
+            return -ENOMEM;
+        nm->cap = cap;
+        if (m)
+            memcpy(nm->pages, m->pages, nr_chunks * sizeof(*m->pages));
+        rcu_assign_pointer(map, nm);
+        if (m)
+            kfree_rcu(m, rcu);
+        m = nm;
+    }
+
+    while (nr_chunks < need) {
+        m->pages[nr_chunks] = (char *)__get_free_page(GFP_KERNEL);
+        if (!m->pages[nr_chunks])
+            return -ENOMEM;
+        nr_chunks++;
+    }
+    return 0;
+}
+
+/* [pos, pos + len) выделено; src == NULL — пробелы */
+static void chunks_fill(struct chunk_map *m, size_t pos, const char *src, size_t len)
+{
+    size_t off, n;
+
+    while (len) {
+        off = pos % CHUNK;
+        n = min_t(size_t, len, CHUNK - off);
+        if (src) {
+            memcpy(m->pages[pos / CHUNK] + off, src, n);
+            src += n;
+        } else {
+            memset(m->pages[pos / CHUNK] + off, ' ', n);
+        }
+        pos += n;
+        len -= n;
+    }
+}
 
-static int ensure_len(size_t new_len)
+/* [pos, pos + len) в пределах my_len */
+static void chunks_copy(struct chunk_map *m, char *dst, size_t pos, size_t len)
+{
+    size_t off, n;
+
+    while (len) {
+        off = pos % CHUNK;
+        n = min_t(size_t, len, CHUNK - off);
+        memcpy(dst, m->pages[pos / CHUNK] + off, n);
+        dst += n;
+        pos += n;
+        len -= n;
+    }
+}
+
+/* печатаемый ASCII (включая пробел), как у ch_val */
+static bool all_printable(const char *s, size_t len)
 {
     size_t i;
 
-    if (new_len > MAX_SIZE - 1)
-        return -ERANGE;
+    for (i = 0; i < len; i++) {
+        if (!isprint((unsigned char)s[i]))
+            return false;
+    }
+    return true;
+}
 
-    /* заполняем “дыры” пробелами, чтобы строка не обрывалась '\0' */
-    for (i = my_len; i < new_len; i++)
-        my_str[i] = ' ';
+/*
+ * Под lock: len байт с позиции pos. Дыру до pos заполняем пробелами,
+ * чтобы строка не обрывалась. За старым концом читатели не смотрят —
+ * туда пишем первым делом и без my_seq. Видимую часть и сдвиг my_len
+ * делаем в одной секции my_seq: иначе читатель между ними получил бы
+ * новое начало записи со старой длиной.
+ */
+static int str_write_locked(size_t pos, const char *src, size_t len)
+{
+    size_t end = pos + len, old = my_len, in;
+    struct chunk_map *m;
+    int ret;
 
-    my_len = new_len;
-    my_str[my_len] = '\0';
+    if (pos > MAX_SIZE || len > MAX_SIZE - pos)
+        return -ERANGE;
+
+    if (end > old) {
+        ret = grow_chunks(end);
+        if (ret)
+            return ret;
+    }
+    m = map_locked();
+    if (pos > old)
+        chunks_fill(m, old, NULL, pos - old);
+
+    in = pos < old ? min(end, old) - pos : 0;
+    chunks_fill(m, pos + in, src + in, len - in);
+
+    if (in) {
+        write_seqcount_begin(&my_seq);
+        chunks_fill(m, pos, src, in);
+        if (end > old)
+            smp_store_release(&my_len, end);
+        write_seqcount_end(&my_seq);
+    } else if (end > old) {
+        smp_store_release(&my_len, end);
+    }
     return 0;
 }
 
+/* len байт с позиции pos одним вызовом: один захват lock на всю пачку */
+static int my_str_write(size_t pos, const char *src, size_t len)
+{
+    int ret;
+
+    if (!all_printable(src, len))
+        return -EINVAL;
+
+    mutex_lock(&lock);
+    ret = str_write_locked(pos, src, len);
+    mutex_unlock(&lock);
+
+    return ret;
+}
+
+/*
+ * Без lock: до cnt байт с позиции pos, одной версией строки (см. выше).
+ * Возвращает, сколько скопировано; 0 — pos за концом. На PREEMPT_RT
+ * read_seqcount_begin может ждать писателя на lock, поэтому он — вне
+ * rcu_read_lock.
+ */
+static size_t my_str_snapshot(char *dst, size_t pos, size_t cnt)
+{
+    struct chunk_map *m;
+    unsigned int seq;
+    size_t len, n;
+
+    do {
+        seq = read_seqcount_begin(&my_seq);
+        len = smp_load_acquire(&my_len);
+        n = pos < len ? min(cnt, len - pos) : 0;
+
+        rcu_read_lock();
+        m = rcu_dereference(map);
+        if (m)          /* NULL — выгрузка, retry это увидит */
+            chunks_copy(m, dst, pos, n);
+        rcu_read_unlock();
+    } while (read_seqcount_retry(&my_seq, seq));
+
+    return n;
+}
+
 /* ===== idx param callbacks ===== */
 
 static int idx_set(const char *val, const struct kernel_param *kp)
@@ -51,26 +233,20 @@ static int idx_set(const char *val, const struct kernel_param *kp)
     if (ret)
         return ret;
 
-    if (v > MAX_SIZE - 2)
+    if (v > MAX_SIZE - 1)
         return -ERANGE;
 
     mutex_lock(&lock);
-    idx = v;
+    WRITE_ONCE(idx, v);
     mutex_unlock(&lock);
 
-    pr_info("idx=%u\n", idx);
+    pr_info("idx=%u\n", v);
     return 0;
 }
 
 static int idx_get(char *buf, const struct kernel_param *kp)
 {
-    unsigned int v;
-
-    mutex_lock(&lock);
-    v = idx;
-    mutex_unlock(&lock);
-
-    return scnprintf(buf, PAGE_SIZE, "%u", v);
+    return scnprintf(buf, PAGE_SIZE, "%u", READ_ONCE(idx));
 }
 
 static const struct kernel_param_ops idx_ops = {
@@ -104,30 +280,23 @@ static int ch_val_set(const char *val, const struct kernel_param *kp)
     mutex_lock(&lock);
 
     pos = idx;
-    ret = ensure_len(pos + 1);
+    ret = str_write_locked(pos, &c, 1);
     if (ret) {
         mutex_unlock(&lock);
         return ret;
     }
 
-    ch_val = v;
-    my_str[pos] = c;
+    WRITE_ONCE(ch_val, v);
 
     mutex_unlock(&lock);
 
-    pr_info("write my_str[%zu]=%u('%c') -> \"%s\"\n", pos, ch_val, c, my_str);
+    pr_info("write my_str[%zu]=%u('%c')\n", pos, v, c);
     return 0;
 }
 
 static int ch_val_get(char *buf, const struct kernel_param *kp)
 {
-    unsigned int v;
-
-    mutex_lock(&lock);
-    v = ch_val;
-    mutex_unlock(&lock);
-
-    return scnprintf(buf, PAGE_SIZE, "%u", v);
+    return scnprintf(buf, PAGE_SIZE, "%u", READ_ONCE(ch_val));
 }
 
 static const struct kernel_param_ops ch_val_ops = {
@@ -138,6 +307,48 @@ static const struct kernel_param_ops ch_val_ops = {
 module_param_cb(ch_val, &ch_val_ops, NULL, 0664);
 MODULE_PARM_DESC(ch_val, "ASCII code of character to write at idx");
 
+/* ===== range param callbacks (WO) ===== */
+
+/* "OFF TEXT": TEXT целиком с позиции OFF, вместо idx + ch_val на каждый байт */
+static int range_set(const char *val, const struct kernel_param *kp)
+{
+    const char *text = strchr(val, ' ');
+    char num[12];
+    unsigned int off;
+    size_t len;
+    int ret;
+
+    if (!text || text - val >= sizeof(num))
+        return -EINVAL;
+
+    memcpy(num, val, text - val);
+    num[text - val] = '\0';
+    ret = kstrtouint(num, 10, &off);
+    if (ret)
+        return ret;
+
+    /* echo и tee дописывают перевод строки — он не часть текста */
+    text++;
+    len = strlen(text);
+    if (len && text[len - 1] == '\n')
+        len--;
+
+    ret = my_str_write(off, text, len);
+    if (ret)
+        return ret;
+
+    pr_info("write my_str[%u..%zu)\n", off, off + len);
+    return 0;
+}
+
+static const struct kernel_param_ops range_ops = {
+    .set = range_set,
+    .get = NULL,
+};
+
+module_param_cb(range, &range_ops, NULL, 0220);
+MODULE_PARM_DESC(range, "Write-only: \"OFF TEXT\" writes TEXT into my_str starting at OFF");
+
 /* ===== my_str param callbacks (RO) ===== */
 
 static int my_str_set(const char *val, const struct kernel_param *kp)
@@ -146,15 +357,13 @@ static int my_str_set(const char *val, const struct kernel_param *kp)
     return -EPERM;
 }
 
+/* параметр отдаёт не больше страницы, одним снимком; строку целиком — /dev/my_str */
 static int my_str_get(char *buf, const struct kernel_param *kp)
 {
-    int ret;
-
-    mutex_lock(&lock);
-    ret = scnprintf(buf, PAGE_SIZE, "%s", my_str);
-    mutex_unlock(&lock);
+    size_t n = my_str_snapshot(buf, 0, PAGE_SIZE - 1);
 
-    return ret;
+    buf[n] = '\0';
+    return n;
 }
 
 static const struct kernel_param_ops my_str_ops = {
@@ -163,16 +372,106 @@ static const struct kernel_param_ops my_str_ops = {
 };
 
 module_param_cb(my_str, &my_str_ops, NULL, 0444);
-MODULE_PARM_DESC(my_str, "Result string (read-only)");
+MODULE_PARM_DESC(my_str, "Result string (read-only, first page)");
+
+/*
+ * ===== /dev/my_str =====
+ * read() — строка с позиции файла, write()/pwrite() — байты с позиции
+ * файла, дыра до неё заполняется пробелами. Пишутся только печатаемые
+ * символы: на первом непечатаемом куске write() возвращает, сколько
+ * успел, или -EINVAL. И то, и другое идёт по страницам: каждая страница
+ * read() — один снимок, но read() длиннее страницы может захватить
+ * соседние страницы разных версий, как у обычного файла.
+ */
+static ssize_t my_str_dev_read(struct file *file, char __user *ubuf,
+                               size_t count, loff_t *ppos)
+{
+    char *page;
+    size_t n, done = 0;
+    ssize_t ret = 0;
+
+    if (*ppos < 0)
+        return -EINVAL;
+
+    page = (char *)__get_free_page(GFP_KERNEL);
+    if (!page)
+        return -ENOMEM;
+
+    while (done < count) {
+        n = my_str_snapshot(page, *ppos, min_t(size_t, count - done, PAGE_SIZE));
+        if (!n)
+            break;
+        if (copy_to_user(ubuf + done, page, n)) {
+            ret = -EFAULT;
+            break;
+        }
+        *ppos += n;
+        done += n;
+    }
+
+    free_page((unsigned long)page);
+    return done ? done : ret;
+}
+
+static ssize_t my_str_dev_write(struct file *file, const char __user *ubuf,
+                                size_t count, loff_t *ppos)
+{
+    char *page;
+    size_t n, done = 0;
+    int ret = 0;
+
+    if (*ppos < 0 || *ppos > MAX_SIZE)
+        return -EFBIG;
+
+    page = (char *)__get_free_page(GFP_KERNEL);
+    if (!page)
+        return -ENOMEM;
+
+    while (done < count) {
+        n = min_t(size_t, count - done, PAGE_SIZE);
+        if (copy_from_user(page, ubuf + done, n)) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = my_str_write(*ppos, page, n);
+        if (ret)
+            break;
+        *ppos += n;
+        done += n;
+    }
+
+    free_page((unsigned long)page);
+    return done ? done : ret;
+}
+
+static loff_t my_str_dev_llseek(struct file *file, loff_t offset, int whence)
+{
+    return generic_file_llseek_size(file, offset, whence, MAX_SIZE, READ_ONCE(my_len));
+}
+
+static const struct file_operations my_str_fops = {
+    .owner = THIS_MODULE,
+    .read = my_str_dev_read,
+    .write = my_str_dev_write,
+    .llseek = my_str_dev_llseek,
+};
+
+static struct miscdevice my_str_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "my_str",
+    .fops = &my_str_fops,
+    .mode = 0600,
+};
 
 static int __init hw2_init(void)
 {
-    mutex_lock(&lock);
-    idx = 0;
-    ch_val = 0;
-    my_len = 0;
-    my_str[0] = '\0';
-    mutex_unlock(&lock);
+    int ret;
+
+    ret = misc_register(&my_str_misc);
+    if (ret) {
+        pr_err("misc_register failed: %d\n", ret);
+        return ret;
+    }
 
     pr_info("init\n");
     return 0;
@@ -180,6 +479,25 @@ static int __init hw2_init(void)
 
 static void __exit hw2_exit(void)
 {
+    struct chunk_map *m;
+    size_t i;
+
+    misc_deregister(&my_str_misc);
+
+    /* параметры снимаются уже после exit: читатель ещё может прийти */
+    mutex_lock(&lock);
+    write_seqcount_begin(&my_seq);
+    m = map_locked();
+    RCU_INIT_POINTER(map, NULL);
+    WRITE_ONCE(my_len, 0);
+    write_seqcount_end(&my_seq);
+    mutex_unlock(&lock);
+    synchronize_rcu();
+
+    for (i = 0; i < nr_chunks; i++)
+        free_page((unsigned long)m->pages[i]);
+    kfree(m);
+
     pr_info("exit\n");
 }
 
@@ -188,4 +506,4 @@ module_exit(hw2_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Andrei Ogurcov");
-MODULE_DESCRIPTION("HW2: build 'Hello, World!' via module params");
+MODULE_DESCRIPTION("HW2: build 'Hello, World!' via module params or /dev/my_str");
@@ -0,0 +1,100 @@
+// bpf/fifo_feed.bpf.c
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+/*
+ * Кормит kernel_fifo из tp_btf/sys_enter: на каждый syscall процесса
+ * target_tgid кладёт очередной номер. feed_one — по одному элементу,
+ * feed_bulk — пачками FEED_BATCH из per-CPU буфера (хвост < FEED_BATCH
+ * так и остаётся в буфере). Загрузчик — fifo_feed.c.
+ */
+#define FEED_BATCH 16
+
+extern int bpf_kfifo_enqueue(int value) __ksym;
+extern int bpf_kfifo_enqueue_bulk(const int *vals, u32 vals__sz) __ksym;
+extern int bpf_kfifo_size(void) __ksym;
+
+const volatile int target_tgid;
+
+/* итоги для загрузчика: элементов принято, вызовов с FULL/прочим */
+__u64 calls, enqueued, full, other;
+int max_size_seen;
+int seq;
+
+struct feed_batch {
+    __u32 n;
+    int vals[FEED_BATCH];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct feed_batch);
+} batch SEC(".maps");
+
+/* FIFO_FULL из src/fifo_ops.h */
+static __always_inline void account(int ret)
+{
+    int sz;
+
+    if (ret >= 0)
+        __sync_fetch_and_add(&enqueued, ret);
+    else if (ret == -2)
+        __sync_fetch_and_add(&full, 1);
+    else
+        __sync_fetch_and_add(&other, 1);
+
+    sz = bpf_kfifo_size();
+    if (sz > max_size_seen)
+        max_size_seen = sz;
+}
+
+static __always_inline bool is_target(void)
+{
+    return (bpf_get_current_pid_tgid() >> 32) == target_tgid;
+}
+
+SEC("tp_btf/sys_enter")
+int BPF_PROG(feed_one, struct pt_regs *regs, long id)
+{
+    int ret;
+
+    if (!is_target())
+        return 0;
+
+    __sync_fetch_and_add(&calls, 1);
+    ret = bpf_kfifo_enqueue(__sync_fetch_and_add(&seq, 1));
+    account(ret == 0 ? 1 : ret);
+    return 0;
+}
+
+SEC("tp_btf/sys_enter")
+int BPF_PROG(feed_bulk, struct pt_regs *regs, long id)
+{
+    struct feed_batch *b;
+    __u32 key = 0, i;
+
+    if (!is_target())
+        return 0;
+
+    b = bpf_map_lookup_elem(&batch, &key);
+    if (!b)
+        return 0;
+
+    i = b->n;
+    if (i >= FEED_BATCH)
+        i = 0;
+    b->vals[i] = __sync_fetch_and_add(&seq, 1);
+    b->n = ++i;
+    if (i < FEED_BATCH)
+        return 0;
+
+    b->n = 0;
+    __sync_fetch_and_add(&calls, 1);
+    account(bpf_kfifo_enqueue_bulk(b->vals, sizeof(b->vals)));
+    return 0;
+}
+
+char LICENSE[] SEC("license") = "GPL";
@@ -39,5 +39,124 @@ echo 1 | sudo tee "$DIR/clear" >/dev/null
 empty="$(tr -d '\n' < "$DIR/is_empty")"
 [[ "$empty" == "1" ]] || { echo "ERROR: is_empty expected 1 got $empty"; exit 7; }
 
+# события вместо printk: fifo_enqueue видно в tracefs, если он смонтирован
+TRC=/sys/kernel/tracing
+if sudo test -d "$TRC/events/kernel_fifo"; then
+  echo | sudo tee "$TRC/trace" >/dev/null
+  echo 1 | sudo tee "$TRC/events/kernel_fifo/fifo_enqueue/enable" >/dev/null
+  echo 40 | sudo tee "$DIR/enqueue" >/dev/null
+  echo 0 | sudo tee "$TRC/events/kernel_fifo/fifo_enqueue/enable" >/dev/null
+  sudo grep -q "fifo_enqueue: value=40 size=1 ret=0 " "$TRC/trace" || { echo "ERROR: fifo_enqueue event missing"; exit 8; }
+fi
+
+# /dev/kernel_fifo: read спит на пустой очереди, enqueue будит его (irq_work)
+DEV="/dev/$MOD"
+[[ -c "$DEV" ]] || { echo "ERROR: missing $DEV"; exit 11; }
+echo 1 | sudo tee "$DIR/clear" >/dev/null
+OUT="$(mktemp)"
+sudo timeout 5 dd if="$DEV" bs=4 count=1 status=none > "$OUT" &
+RD=$!
+sleep 0.3
+echo 77 | sudo tee "$DIR/enqueue" >/dev/null
+wait "$RD" || { echo "ERROR: blocking read on $DEV failed"; exit 12; }
+got="$(od -An -td4 "$OUT" | tr -d ' \n')"
+rm -f "$OUT"
+[[ "$got" == "77" ]] || { echo "ERROR: $DEV read expected 77 got $got"; exit 13; }
+
+# партии: при wm_high=4 три элемента никого не будят, дальше — одно объявление
+for f in wm_high wm_low batch_us notifications; do
+  [[ -e "$DIR/$f" ]] || { echo "ERROR: missing $DIR/$f"; exit 14; }
+done
+notif() { tr -d '\n' < "$DIR/notifications"; }
+echo 1 | sudo tee "$DIR/clear" >/dev/null
+echo 4 | sudo tee "$DIR/wm_high" >/dev/null
+n0="$(notif)"
+for v in 1 2 3; do echo "$v" | sudo tee "$DIR/enqueue" >/dev/null; done
+sleep 0.1
+[[ "$(notif)" == "$n0" ]] || { echo "ERROR: notified below wm_high"; exit 15; }
+for v in 4 5 6; do echo "$v" | sudo tee "$DIR/enqueue" >/dev/null; done
+sleep 0.1
+[[ "$(notif)" == "$((n0 + 1))" ]] || { echo "ERROR: expected one batch, got $(( $(notif) - n0 ))"; exit 16; }
+
+# таймер партии: один элемент ниже wm_high объявляется через batch_us
+echo 1 | sudo tee "$DIR/clear" >/dev/null
+echo 50000 | sudo tee "$DIR/batch_us" >/dev/null
+echo 7 | sudo tee "$DIR/enqueue" >/dev/null
+sleep 0.3
+[[ "$(notif)" == "$((n0 + 2))" ]] || { echo "ERROR: batch timer did not fire"; exit 17; }
+echo 0 | sudo tee "$DIR/batch_us" >/dev/null
+echo 1 | sudo tee "$DIR/wm_high" >/dev/null
+echo 1 | sudo tee "$DIR/clear" >/dev/null
+
+# срок годности: без читателей просроченное снимает чистильщик
+for f in ttl_ms expired_skipped expired_reaped; do
+  [[ -e "$DIR/$f" ]] || { echo "ERROR: missing $DIR/$f"; exit 24; }
+done
+r0="$(tr -d '\n' < "$DIR/expired_reaped")"
+echo 50 | sudo tee "$DIR/ttl_ms" >/dev/null
+for v in 1 2 3; do echo "$v" | sudo tee "$DIR/enqueue" >/dev/null; done
+sleep 0.3
+[[ "$(tr -d '\n' < "$DIR/size")" == "0" ]] || { echo "ERROR: expired elements not reaped"; exit 25; }
+[[ "$(tr -d '\n' < "$DIR/expired_reaped")" == "$((r0 + 3))" ]] || { echo "ERROR: expired_reaped expected $((r0 + 3))"; exit 26; }
+echo 0 | sudo tee "$DIR/ttl_ms" >/dev/null
+
+# kfuncs: если собран bpf/ (make bpf) и у модуля есть BTF, грузим программу
+FEED=./bpf/build/fifo_feed
+if [[ -x "$FEED" ]] && [[ -d "/sys/kernel/btf/$MOD" ]]; then
+  echo 1 | sudo tee "$DIR/clear" >/dev/null
+  sudo "$FEED" -n 100000 || { echo "ERROR: fifo_feed failed"; exit 9; }
+  echo 1 | sudo tee "$DIR/clear" >/dev/null
+  sudo "$FEED" -n 100000 -b || { echo "ERROR: fifo_feed -b failed"; exit 10; }
+fi
+
+# режим приоритетов: старший выходит первым, равные — по приходу;
+# read на /dev отдаёт верх кучи пачкой
+sudo rmmod "$MOD"
+sudo insmod "$KO" max_size=8 mode=prio
+[[ "$(tr -d '\n' < "$DIR/mode")" == "prio" ]] || { echo "ERROR: mode expected prio"; exit 18; }
+echo 5 | sudo tee "$DIR/enqueue" >/dev/null
+for pv in "1 10" "200 20" "1 11" "200 21"; do
+  echo "$pv" | sudo tee "$DIR/enqueue_prio" >/dev/null
+done
+[[ "$(tr -d '\n' < "$DIR/size")" == "5" ]] || { echo "ERROR: prio size expected 5"; exit 19; }
+[[ "$(tr -d '\n' < "$DIR/peek")" == "20" ]] || { echo "ERROR: prio peek expected 20"; exit 20; }
+got="$(sudo dd if="$DEV" bs=16 count=1 status=none | od -An -td4 | xargs)"
+[[ "$got" == "20 21 10 11" ]] || { echo "ERROR: prio read expected '20 21 10 11' got '$got'"; exit 21; }
+[[ "$(tr -d '\n' < "$DIR/dequeue")" == "5" ]] || { echo "ERROR: prio dequeue expected 5"; exit 22; }
+if echo "256 1" | sudo tee "$DIR/enqueue_prio" >/dev/null 2>&1; then
+  echo "ERROR: prio 256 accepted"; exit 23
+fi
+
+# широковещание: каждый открытый на чтение файл видит все элементы,
+# место освобождается, когда прочли все; при lag_policy=drop отставший
+# теряет старейшее, без неё производитель упирается в ENOSPC
+sudo rmmod "$MOD"
+sudo insmod "$KO" max_size=4 mode=bcast
+[[ "$(tr -d '\n' < "$DIR/mode")" == "bcast" ]] || { echo "ERROR: mode expected bcast"; exit 27; }
+got="$(sudo bash -c '
+  exec 3<"$1" 4<"$1"
+  for v in 1 2 3; do echo "$v" > "$2/enqueue"; done
+  a="$(dd bs=12 count=1 status=none <&3 | od -An -td4 | xargs)"
+  b="$(dd bs=12 count=1 status=none <&4 | od -An -td4 | xargs)"
+  echo "$a|$b|$(cat "$2/size")"
+' _ "$DEV" "$DIR")"
+[[ "$got" == "1 2 3|1 2 3|0" ]] || { echo "ERROR: bcast read expected '1 2 3|1 2 3|0' got '$got'"; exit 28; }
+got="$(sudo bash -c '
+  exec 3<"$1"
+  for v in 1 2 3 4; do echo "$v" > "$2/enqueue"; done
+  echo 5 2>/dev/null > "$2/enqueue" && echo "block ignored"
+  echo drop > "$2/lag_policy"
+  echo 5 > "$2/enqueue"
+  echo "$(cat "$2/overwritten")|$(dd bs=16 count=1 status=none <&3 | od -An -td4 | xargs)"
+' _ "$DEV" "$DIR")"
+[[ "$got" == "1|2 3 4 5" ]] || { echo "ERROR: bcast lag_policy expected '1|2 3 4 5' got '$got'"; exit 29; }
+
+# пороги при insmod: порядок параметров не важен, неверная пара не грузится
+sudo rmmod "$MOD"
+sudo insmod "$KO" max_size=16 wm_low=4 wm_high=8 || { echo "ERROR: wm_low before wm_high rejected"; exit 30; }
+[[ "$(tr -d '\n' < "$DIR/wm_high") $(tr -d '\n' < "$DIR/wm_low")" == "8 4" ]] || { echo "ERROR: load-time watermarks expected '8 4'"; exit 31; }
 sudo rmmod "$MOD"
+if sudo insmod "$KO" max_size=16 wm_high=4 wm_low=4 2>/dev/null; then
+  echo "ERROR: wm_low == wm_high accepted"; exit 32
+fi
 echo "OK"
@@ -0,0 +1,302 @@
+// src/dev.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/eventfd.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include "dev.h"
+#include "fifo_ops.h"
+#include "kernel_fifo_uapi.h"
+
+#define FIFO_DEV_CHUNK 64      /* элементов за один copy_to_user */
+
+/*
+ * /dev/kernel_fifo — потребитель очереди: read() отдаёт int'ы в байтах
+ * хоста, сколько их есть (до count / 4), пачками через fifo_dequeue_bulk;
+ * в режиме приоритетов это старшие элементы по убыванию приоритета. Без
+ * O_NONBLOCK на очереди без объявленной партии блокируется; с O_NONBLOCK
+ * отдаёт что есть или -EAGAIN. Будят читателей и eventfd'ы только
+ * объявления партий (fifo_ops.c).
+ * write() кладёт int'ы пачкой, как bpf_kfifo_enqueue_bulk.
+ *
+ * При mode=bcast файл, открытый на чтение, — подписчик: read() идёт своим
+ * курсором и ничего не забирает у других, mmap отдаёт кольцо без копий,
+ * ioctl'ы BCAST_* — позиция курсора и подтверждение прочитанного.
+ */
+struct fifo_dev_file {
+    struct fifo_listener l;
+    struct fifo_cursor cur;
+    struct mutex cur_lock;      /* курсор двигают по одному */
+    bool sub;                   /* курсор подписан */
+};
+
+static int fifo_dev_open(struct inode *inode, struct file *file)
+{
+    struct fifo_dev_file *f = kzalloc(sizeof(*f), GFP_KERNEL);
+
+    if (!f)
+        return -ENOMEM;
+
+    INIT_LIST_HEAD(&f->l.node);
+    INIT_LIST_HEAD(&f->cur.node);
+    mutex_init(&f->cur_lock);
+
+    /* писателю курсор не нужен: он только держал бы кольцо */
+    if (fifo_get_mode() == FIFO_MODE_BCAST && (file->f_mode & FMODE_READ)) {
+        if (fifo_cursor_attach(&f->cur) != FIFO_OK) {
+            kfree(f);
+            return -ENODEV;
+        }
+        f->sub = true;
+    }
+
+    file->private_data = f;
+    return 0;
+}
+
+static void fifo_dev_drop_eventfd(struct fifo_listener *l)
+{
+    if (!l->efd)
+        return;
+
+    fifo_listener_del(l);
+    eventfd_ctx_put(l->efd);
+    l->efd = NULL;
+}
+
+static int fifo_dev_release(struct inode *inode, struct file *file)
+{
+    struct fifo_dev_file *f = file->private_data;
+
+    fifo_dev_drop_eventfd(&f->l);
+    if (f->sub)
+        fifo_cursor_detach(&f->cur);
+    kfree(f);
+    return 0;
+}
+
+/* ioctl'ы одного файла не пересекаются с release, но могут — между собой */
+static DEFINE_MUTEX(fifo_dev_ioctl_lock);
+
+static long fifo_dev_set_eventfd(struct fifo_dev_file *f, unsigned long arg)
+{
+    struct eventfd_ctx *efd = NULL;
+    s32 fd;
+
+    if (get_user(fd, (s32 __user *)arg))
+        return -EFAULT;
+
+    if (fd >= 0) {
+        efd = eventfd_ctx_fdget(fd);
+        if (IS_ERR(efd))
+            return PTR_ERR(efd);
+    } else if (fd != -1) {
+        return -EINVAL;
+    }
+
+    mutex_lock(&fifo_dev_ioctl_lock);
+    fifo_dev_drop_eventfd(&f->l);
+    if (efd) {
+        f->l.efd = efd;
+        fifo_listener_add(&f->l);
+    }
+    mutex_unlock(&fifo_dev_ioctl_lock);
+    return 0;
+}
+
+static long fifo_dev_bcast_info(struct fifo_dev_file *f, unsigned long arg)
+{
+    struct fifo_bcast_info info = {
+        .cap = fifo_size() + fifo_available(),
+    };
+
+    mutex_lock(&f->cur_lock);
+    info.pos = f->cur.pos;
+    info.lost = f->cur.lost;
+    mutex_unlock(&f->cur_lock);
+
+    return copy_to_user((void __user *)arg, &info, sizeof(info)) ? -EFAULT : 0;
+}
+
+/* возвращает, на сколько сдвинулся курсор (меньше n — столько не опубликовано) */
+static long fifo_dev_bcast_advance(struct fifo_dev_file *f, unsigned long arg)
+{
+    u32 n;
+    int ret;
+
+    if (get_user(n, (u32 __user *)arg))
+        return -EFAULT;
+
+    mutex_lock(&f->cur_lock);
+    ret = fifo_cursor_advance(&f->cur, n);
+    mutex_unlock(&f->cur_lock);
+
+    return ret < 0 ? -EINVAL : ret;
+}
+
+static long fifo_dev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct fifo_dev_file *f = file->private_data;
+
+    switch (cmd) {
+    case FIFO_IOC_SET_EVENTFD:
+        return fifo_dev_set_eventfd(f, arg);
+    case FIFO_IOC_BCAST_INFO:
+        return f->sub ? fifo_dev_bcast_info(f, arg) : -EINVAL;
+    case FIFO_IOC_BCAST_ADVANCE:
+        return f->sub ? fifo_dev_bcast_advance(f, arg) : -EINVAL;
+    default:
+        return -ENOTTY;
+    }
+}
+
+static bool fifo_dev_ready(struct fifo_dev_file *f)
+{
+    return f->sub ? fifo_cursor_ready(&f->cur) : fifo_has_ready();
+}
+
+static ssize_t fifo_dev_read(struct file *file, char __user *ubuf,
+                             size_t count, loff_t *ppos)
+{
+    struct fifo_dev_file *f = file->private_data;
+    int buf[FIFO_DEV_CHUNK];
+    size_t want = count / sizeof(int), done = 0;
+    int n, ret = 0;
+
+    if (!want)
+        return -EINVAL;
+    if (f->sub && mutex_lock_interruptible(&f->cur_lock))
+        return -ERESTARTSYS;
+
+    /* партию мог выбрать другой читатель: тогда ждём следующую */
+    while (!done) {
+        if (file->f_flags & O_NONBLOCK) {
+            if (!fifo_dev_ready(f)) {
+                ret = -EAGAIN;
+                break;
+            }
+        } else {
+            ret = f->sub ? fifo_cursor_wait(&f->cur) : fifo_wait_ready();
+            if (ret)
+                break;
+        }
+
+        while (done < want) {
+            n = min_t(size_t, want - done, FIFO_DEV_CHUNK);
+            n = f->sub ? fifo_cursor_read(&f->cur, buf, n) : fifo_dequeue_bulk(buf, n);
+            if (n <= 0)
+                break;
+            if (copy_to_user(ubuf + done * sizeof(int), buf, n * sizeof(int))) {
+                ret = -EFAULT;
+                break;
+            }
+            done += n;
+            if (n < FIFO_DEV_CHUNK)
+                break;
+        }
+        if (ret)
+            break;
+    }
+
+    if (f->sub)
+        mutex_unlock(&f->cur_lock);
+    return done ? done * sizeof(int) : ret;
+}
+
+static ssize_t fifo_dev_write(struct file *file, const char __user *ubuf,
+                              size_t count, loff_t *ppos)
+{
+    int buf[FIFO_DEV_CHUNK];
+    size_t want = count / sizeof(int), done = 0;
+    unsigned int n;
+    int ret;
+
+    if (!want)
+        return -EINVAL;
+
+    while (done < want) {
+        n = min_t(size_t, want - done, FIFO_DEV_CHUNK);
+        if (copy_from_user(buf, ubuf + done * sizeof(int), n * sizeof(int)))
+            return done ? done * sizeof(int) : -EFAULT;
+
+        ret = fifo_enqueue_bulk(buf, n);
+        if (ret == FIFO_FULL)
+            return done ? done * sizeof(int) : -EAGAIN;
+        if (ret < 0)
+            return done ? done * sizeof(int) : -EINVAL;
+
+        done += ret;
+        if ((unsigned int)ret < n)
+            break;
+    }
+
+    return done * sizeof(int);
+}
+
+static __poll_t fifo_dev_poll(struct file *file, poll_table *pt)
+{
+    struct fifo_dev_file *f = file->private_data;
+    __poll_t mask = 0;
+
+    fifo_poll_wait(file, pt);
+    if (f->sub ? fifo_cursor_ready(&f->cur) : fifo_batch_ready())
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (!fifo_is_full())
+        mask |= EPOLLOUT | EPOLLWRNORM;
+
+    return mask;
+}
+
+static int fifo_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct fifo_dev_file *f = file->private_data;
+
+    return f->sub ? fifo_bcast_mmap(vma) : -EINVAL;
+}
+
+static const struct file_operations fifo_dev_fops = {
+    .owner = THIS_MODULE,
+    .open = fifo_dev_open,
+    .release = fifo_dev_release,
+    .read = fifo_dev_read,
+    .write = fifo_dev_write,
+    .poll = fifo_dev_poll,
+    .mmap = fifo_dev_mmap,
+    .unlocked_ioctl = fifo_dev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice fifo_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = FIFO_DEV_NAME,
+    .fops = &fifo_dev_fops,
+    .mode = 0600,
+};
+
+int kernel_fifo_dev_init(void)
+{
+    int ret = misc_register(&fifo_misc);
+
+    if (ret) {
+        pr_err("misc_register failed: %d\n", ret);
+        return ret;
+    }
+
+    pr_info("dev: /dev/%s created\n", FIFO_DEV_NAME);
+    return 0;
+}
+
+void kernel_fifo_dev_exit(void)
+{
+    misc_deregister(&fifo_misc);
+    pr_info("dev removed\n");
+}
@@ -0,0 +1,8 @@
+#ifndef KERNEL_FIFO_DEV_H
+#define KERNEL_FIFO_DEV_H
+
+/* /dev/kernel_fifo (dev.c) */
+int kernel_fifo_dev_init(void);
+void kernel_fifo_dev_exit(void);
+
+#endif
@@ -0,0 +1,75 @@
+// src/fifo_bpf.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <linux/module.h>
+#include <linux/types.h>
+
+#include "fifo_ops.h"
+
+/*
+ * kfuncs очереди для BPF-программ: tracing (fentry/fexit/tp_btf), XDP и tc.
+ * Программа объявляет их как extern ... __ksym, libbpf находит их в BTF
+ * модуля (нужны CONFIG_DEBUG_INFO_BTF_MODULES и загруженный kernel_fifo).
+ *
+ * Все не спят и годятся для любого контекста, где работает BPF, включая
+ * NMI: enqueue в fifo_ops.c без локов. В режиме приоритетов очередь под
+ * raw-спинлоком, и из NMI enqueue может вернуть FIFO_BUSY. Коды возврата
+ * те же FIFO_*.
+ */
+
+__diag_push();
+__diag_ignore_all("-Wmissing-prototypes",
+                  "kfuncs are called from BPF programs only, prototypes are in BTF");
+
+noinline int bpf_kfifo_enqueue(int value)
+{
+    return fifo_enqueue(value);
+}
+
+/* vals__sz — размер буфера в байтах, верификатор проверяет его по памяти программы */
+noinline int bpf_kfifo_enqueue_bulk(const int *vals, u32 vals__sz)
+{
+    return fifo_enqueue_bulk(vals, vals__sz / sizeof(int));
+}
+
+/* только mode=prio, иначе FIFO_INVALID */
+noinline int bpf_kfifo_enqueue_prio(int prio, int value)
+{
+    return fifo_enqueue_prio(prio, value);
+}
+
+noinline int bpf_kfifo_size(void)
+{
+    return fifo_size();
+}
+
+__diag_pop();
+
+BTF_SET8_START(fifo_kfunc_ids)
+BTF_ID_FLAGS(func, bpf_kfifo_enqueue)
+BTF_ID_FLAGS(func, bpf_kfifo_enqueue_bulk)
+BTF_ID_FLAGS(func, bpf_kfifo_enqueue_prio)
+BTF_ID_FLAGS(func, bpf_kfifo_size)
+BTF_SET8_END(fifo_kfunc_ids)
+
+static const struct btf_kfunc_id_set fifo_kfunc_set = {
+    .owner = THIS_MODULE,
+    .set   = &fifo_kfunc_ids,
+};
+
+/* снимать регистрацию не нужно: набор уходит вместе с BTF модуля при rmmod */
+int fifo_bpf_register(void)
+{
+    int ret;
+
+    ret = register_btf_kfunc_id_set(BPF_PROG_TYPE_TRACING, &fifo_kfunc_set);
+    ret = ret ?: register_btf_kfunc_id_set(BPF_PROG_TYPE_XDP, &fifo_kfunc_set);
+    ret = ret ?: register_btf_kfunc_id_set(BPF_PROG_TYPE_SCHED_CLS, &fifo_kfunc_set);
+    if (ret)
+        pr_err("kfunc registration failed: %d\n", ret);
+
+    return ret;
+}
@@ -2,51 +2,378 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/kernel.h>
-#include <linux/kfifo.h>
+#include <linux/atomic.h>
+#include <linux/eventfd.h>
+#include <linux/hrtimer.h>
+#include <linux/irq_work.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
+#include <linux/timekeeping.h>
 #include <linux/types.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
-/* Ошибки как в задании (можно подстроить под ваши константы) */
-#define FIFO_OK       0
-#define FIFO_EMPTY   -1
-#define FIFO_FULL    -2
-#define FIFO_NOMEM   -3
-#define FIFO_INVALID -4
+#include "fifo_ops.h"
+#include "fifo_prio.h"
+#include "kernel_fifo_uapi.h"
 
+#define CREATE_TRACE_POINTS
+#include "fifo_trace.h"
+
+/*
+ * Кольцо на 2^k ячеек без лока у производителей (раньше был kfifo под
+ * спинлоком, и из NMI он мог заклинить на прерванном владельце).
+ *
+ * Производитель: резервирует позиции cmpxchg'ом на enq, пишет значение и
+ * публикует ячейку, записав в seq номер позиции + 1 (release). Никого не
+ * ждёт, не спит и не печатает — годится для IRQ, NMI и BPF.
+ * Потребители сериализованы cons_lock: проверяют seq головы (acquire),
+ * забирают значение и двигают deq (release) — после этого ячейку можно
+ * резервировать снова.
+ *
+ * Зарезервированная, но ещё не опубликованная голова (производителя
+ * прервали между cmpxchg и публикацией) для потребителя — EMPTY, даже если
+ * за ней уже есть готовые элементы; size() их при этом считает.
+ *
+ * В режиме FIFO_MODE_PRIO кольца нет: элементы лежат в куче fifo_prio.c,
+ * здесь остаются проверки, трассировка и уведомления партиями.
+ *
+ * В режиме FIFO_MODE_BCAST кольцо то же, но элементы не забирают: каждый
+ * подписчик идёт по нему своим курсором, deq — самый медленный из них
+ * (см. "Широковещание" ниже).
+ */
+struct fifo_cell {
+    u32 seq;
+    int value;
+};
+
+/* кольцо широковещания видно в userspace через mmap как fifo_bcast_cell[] */
+static_assert(sizeof(struct fifo_cell) == sizeof(struct fifo_bcast_cell));
+
+static void fifo_wake_fn(struct irq_work *work);
+
+/*
+ * Уведомление потребителей партиями. Очередь "взведена" (armed), пока
+ * партию не объявили: как только длина дошла до wm_high или истёк таймер
+ * партии (batch_ns с первого элемента), armed снимается, читатели
+ * /dev/kernel_fifo просыпаются, eventfd'ы получают +1. Снова взводит
+ * потребитель, когда выбрал очередь до wm_low. Между объявлениями
+ * производители ничего не будят — одно пробуждение на партию.
+ *
+ * По умолчанию wm_high = 1, wm_low = 0, таймера нет: пробуждение на
+ * первый элемент, как раньше.
+ */
+static struct {
+    u32 wm_high;
+    u32 wm_low;
+    u64 batch_ns;
+    int armed;              /* 1 — партию ещё не объявляли */
+    int notify_pending;     /* irq_work: объявить партию */
+    int timer_on;           /* таймер партии запрошен или идёт */
+    int timer_req;          /* irq_work: запустить таймер */
+    struct hrtimer timer;
+    atomic_long_t notifies;
+    spinlock_t ev_lock;     /* listeners: eventfd'ы открытых /dev/kernel_fifo */
+    struct list_head listeners;
+} wm = {
+    .wm_high = 1,
+    .armed = 1,
+    .notifies = ATOMIC_LONG_INIT(0),
+    .ev_lock = __SPIN_LOCK_UNLOCKED(wm.ev_lock),
+    .listeners = LIST_HEAD_INIT(wm.listeners),
+};
+
+static void fifo_reap_fn(struct work_struct *work);
+static void fifo_reap_schedule(void);
+
+/*
+ * Срок годности (TTL). Производитель кладёт рядом с элементом тик, после
+ * которого тот протухает: младшие 32 бита jiffies — самые дешёвые часы,
+ * читаются и из NMI, на элемент уходит 4 байта. У кольца сроки лежат в
+ * отдельном массиве stamps, чтобы ячейка осталась 8-байтной; у кучи — на
+ * месте выравнивания элемента.
+ *
+ * Потребители выбрасывают просроченные головы по пути (skipped), а
+ * чистильщик — delayed work раз в полсрока — снимает их пачками, даже
+ * если никто не читает (reaped). ttl действует на новые элементы, уже
+ * лежащие живут со своим сроком. Точность — тик.
+ */
+#define FIFO_REAP_BATCH     256                 /* элементов за один захват лока */
+#define FIFO_REAP_MIN_MS    10
+#define FIFO_TTL_MAX_MS     (24 * 3600 * 1000)  /* сутки: time_after32 хватает с запасом */
+
+static struct {
+    u32 ttl;                /* в jiffies, 0 — бессрочно */
+    unsigned int ttl_ms;
+    struct delayed_work reap;
+    atomic_long_t skipped;  /* выброшены потребителями */
+    atomic_long_t reaped;   /* сняты чистильщиком */
+} expiry = {
+    .reap = __DELAYED_WORK_INITIALIZER(expiry.reap, fifo_reap_fn, 0),
+    .skipped = ATOMIC_LONG_INIT(0),
+    .reaped = ATOMIC_LONG_INIT(0),
+};
+
+/*
+ * Подписчики широковещания: курсоры под lock, nr читают производители
+ * без лока. overwritten — сколько элементов затёрли производители.
+ */
 static struct {
-    struct kfifo fifo;      /* хранит байты */
     spinlock_t lock;
-    int max_size;           /* в элементах int */
+    struct list_head list;
+    u32 nr;
+    enum fifo_lag_policy policy;
+    atomic_long_t overwritten;
+} bc = {
+    .lock = __SPIN_LOCK_UNLOCKED(bc.lock),
+    .list = LIST_HEAD_INIT(bc.list),
+    .policy = FIFO_LAG_BLOCK,
+    .overwritten = ATOMIC_LONG_INIT(0),
+};
+
+/* лок, очередь ожидания и irq_work живут дольше кольца: init/free их не трогают */
+static struct {
+    struct fifo_cell *cells;
+    u32 *stamps;            /* сроки годности ячеек, параллельно cells */
+    u32 mask;               /* ёмкость - 1 */
+    u32 enq;                /* следующая позиция для резерва, cmpxchg */
+    u32 deq;                /* голова, пишут только под cons_lock */
+    spinlock_t cons_lock;
+    wait_queue_head_t wq;   /* читатели /dev/kernel_fifo */
+    struct irq_work wake_work;
+    int max_size;           /* запрошенная ёмкость в элементах int */
+    enum fifo_mode mode;    /* меняется только в init, пока !ready */
     bool ready;
-} g;
+} g = {
+    .cons_lock = __SPIN_LOCK_UNLOCKED(g.cons_lock),
+    .wq = __WAIT_QUEUE_HEAD_INITIALIZER(g.wq),
+    .wake_work = IRQ_WORK_INIT(fifo_wake_fn),
+};
+
+/*
+ * Время берём только при включённом событии: выключенный tracepoint — один nop.
+ * Часы fast: ktime_get_ns() на seqcount и из NMI может зависнуть.
+ */
+#define fifo_trace_start(ev) (trace_##ev##_enabled() ? ktime_get_mono_fast_ns() : 0)
+#define fifo_trace_ns(t0)    ((t0) ? ktime_get_mono_fast_ns() - (t0) : 0)
+
+/*
+ * deq читаем первым: enq не меньше любого прошлого deq. Пока читали,
+ * очередь могла успеть и опустеть, и заполниться снова — отсюда min.
+ */
+static inline u32 fifo_len(void)
+{
+    u32 deq;
+
+    if (g.mode == FIFO_MODE_PRIO)
+        return prio_len();
+
+    deq = smp_load_acquire(&g.deq);
+    return min(READ_ONCE(g.enq) - deq, g.mask + 1);
+}
+
+static inline u32 fifo_now(void)
+{
+    return (u32)jiffies;
+}
+
+/* срок для нового элемента; 0 занят под "бессрочный", такой сдвигаем на тик */
+static inline u32 fifo_stamp(void)
+{
+    u32 ttl = READ_ONCE(expiry.ttl);
+
+    return ttl ? (fifo_now() + ttl) ?: 1 : 0;
+}
+
+/* объявить партию: читатели и eventfd'ы; из irq_work или таймера */
+static void fifo_notify(void)
+{
+    struct fifo_listener *l;
+    unsigned long flags;
+
+    atomic_long_inc(&wm.notifies);
+    wake_up_interruptible(&g.wq);
+
+    spin_lock_irqsave(&wm.ev_lock, flags);
+    list_for_each_entry(l, &wm.listeners, node)
+        eventfd_signal(l->efd, 1);
+    spin_unlock_irqrestore(&wm.ev_lock, flags);
+}
+
+/*
+ * Производители не трогают ни таймер, ни очереди ожидания: wake_up и
+ * hrtimer_start берут локи, в NMI так нельзя. Просьбы копятся флагами,
+ * irq_work их выполняет; пока работа висит, повторный irq_work_queue
+ * ничего не делает.
+ */
+static void fifo_wake_fn(struct irq_work *work)
+{
+    if (xchg(&wm.notify_pending, 0))
+        fifo_notify();
+    else
+        wake_up_interruptible(&g.wq);
+
+    if (xchg(&wm.timer_req, 0))
+        hrtimer_start(&wm.timer, ns_to_ktime(READ_ONCE(wm.batch_ns)),
+                      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart fifo_batch_timer(struct hrtimer *t)
+{
+    WRITE_ONCE(wm.timer_on, 0);
+    /* партию могли объявить по wm_high раньше таймера — тогда armed == 0 */
+    if (fifo_len() && cmpxchg(&wm.armed, 1, 0) == 1)
+        fifo_notify();
+
+    return HRTIMER_NORESTART;
+}
 
-static inline int bytes_to_elems(unsigned int bytes)
+/*
+ * Некого будить — партию только считаем, без irq_work. Читатель, что как
+ * раз засыпает, после prepare_to_wait сам увидит armed == 0 (cmpxchg
+ * выше и барьер в wq_has_sleeper — пара к барьеру в prepare_to_wait).
+ */
+static inline void fifo_announce(void)
 {
-    return bytes / sizeof(int);
+    if (wq_has_sleeper(&g.wq) || !list_empty(&wm.listeners)) {
+        WRITE_ONCE(wm.notify_pending, 1);
+        irq_work_queue(&g.wake_work);
+    } else {
+        atomic_long_inc(&wm.notifies);
+    }
+}
+
+/*
+ * После публикации (и после взвода потребителем). enq менялся cmpxchg'ом,
+ * это полный барьер перед чтением armed: взвод со smp_mb в fifo_rearm либо
+ * увидит наш элемент в fifo_len, либо мы увидим armed == 1.
+ */
+static inline void fifo_kick(void)
+{
+    u32 len = fifo_len();
+
+    if (READ_ONCE(wm.armed)) {
+        if (len >= READ_ONCE(wm.wm_high)) {
+            if (cmpxchg(&wm.armed, 1, 0) == 1)
+                fifo_announce();
+        } else if (len && READ_ONCE(wm.batch_ns) && !READ_ONCE(wm.timer_on) &&
+                   cmpxchg(&wm.timer_on, 0, 1) == 0) {
+            WRITE_ONCE(wm.timer_req, 1);
+            irq_work_queue(&g.wake_work);
+        }
+        return;
+    }
+
+    /* партия уже объявлена: будим только уснувших на неопубликованной голове */
+    if (wq_has_sleeper(&g.wq))
+        irq_work_queue(&g.wake_work);
+}
+
+/* потребитель выбрал очередь до wm_low: следующая партия снова объявляется */
+static void fifo_rearm(void)
+{
+    if (READ_ONCE(wm.armed) || fifo_len() > READ_ONCE(wm.wm_low))
+        return;
+
+    WRITE_ONCE(wm.armed, 1);
+    smp_mb();
+    /* пока взводили, могли успеть дописать до wm_high */
+    fifo_kick();
 }
 
-int fifo_init(int max_size)
+/* кольцо широковещания отдаётся в mmap: vmalloc_user, целыми страницами */
+static int fifo_ring_init(u32 cap, bool user)
 {
+    u32 i;
+
+    if (user)
+        g.cells = vmalloc_user(PAGE_ALIGN((size_t)cap * sizeof(*g.cells)));
+    else
+        g.cells = kvcalloc(cap, sizeof(*g.cells), GFP_KERNEL);
+    if (!g.cells) {
+        pr_err("ring alloc failed: %u cells\n", cap);
+        return FIFO_NOMEM;
+    }
+
+    g.stamps = kvcalloc(cap, sizeof(*g.stamps), GFP_KERNEL);
+    if (!g.stamps) {
+        pr_err("ring alloc failed: %u stamps\n", cap);
+        kvfree(g.cells);
+        g.cells = NULL;
+        return FIFO_NOMEM;
+    }
+
+    /* ячейка i "опубликована на прошлом круге": seq != i + 1 */
+    for (i = 0; i < cap; i++)
+        g.cells[i].seq = i + 1 - cap;
+
+    return FIFO_OK;
+}
+
+static const char *const fifo_mode_names[] = {
+    [FIFO_MODE_FIFO] = "fifo",
+    [FIFO_MODE_PRIO] = "prio",
+    [FIFO_MODE_BCAST] = "bcast",
+};
+
+int fifo_init(int max_size, enum fifo_mode mode)
+{
+    struct fifo_cursor *c;
+    u32 cap;
     int ret;
-    unsigned int bytes;
 
-    if (max_size <= 0)
+    if (max_size <= 0 || max_size > (1 << 30))
+        return FIFO_INVALID;
+    if (mode >= ARRAY_SIZE(fifo_mode_names))
         return FIFO_INVALID;
 
-    spin_lock_init(&g.lock);
+    /*
+     * как у kfifo: ёмкость округляется вверх до степени двойки; куче это
+     * не нужно, но size/available во всех режимах считаются одинаково.
+     * Широковещанию нужно хотя бы 2 ячейки: см. fifo_publish.
+     */
+    cap = roundup_pow_of_two(max_size);
+    if (mode == FIFO_MODE_BCAST)
+        cap = max(cap, 2u);
+    ret = mode == FIFO_MODE_PRIO ? prio_init(cap)
+                                 : fifo_ring_init(cap, mode == FIFO_MODE_BCAST);
+    if (ret != FIFO_OK) {
+        g.ready = false;
+        return ret;
+    }
+
+    g.mode = mode;
+    g.mask = cap - 1;
+    g.enq = 0;
+    g.deq = 0;
     g.max_size = max_size;
-    bytes = (unsigned int)g.max_size * sizeof(int);
 
-    ret = kfifo_alloc(&g.fifo, bytes, GFP_KERNEL);
-    if (ret) {
-        pr_err("kfifo_alloc failed: %d\n", ret);
-        g.ready = false;
-        return FIFO_NOMEM;
+    /* подписчики, оставшиеся с прошлого кольца, начинают с начала */
+    spin_lock(&bc.lock);
+    list_for_each_entry(c, &bc.list, node)
+        WRITE_ONCE(c->pos, 0);
+    spin_unlock(&bc.lock);
+
+    /* пороги могли задать до init (параметры модуля) — не больше ёмкости */
+    if (wm.wm_high > cap) {
+        wm.wm_high = cap;
+        wm.wm_low = min(wm.wm_low, cap - 1);
     }
+    wm.armed = 1;
+    hrtimer_init(&wm.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    wm.timer.function = fifo_batch_timer;
 
-    g.ready = true;
-    pr_info("fifo init: capacity=%d elems\n", g.max_size);
+    smp_store_release(&g.ready, true);
+    fifo_reap_schedule();
+    pr_info("fifo init: capacity=%u elems mode=%s\n", cap, fifo_mode_names[mode]);
     return FIFO_OK;
 }
 
@@ -55,129 +382,769 @@ void fifo_free(void)
     if (!g.ready)
         return;
 
-    kfifo_free(&g.fifo);
-    g.ready = false;
+    WRITE_ONCE(g.ready, false);
+    /* разбудить читателей: они увидят !ready и уйдут с ошибкой */
+    wake_up_interruptible(&g.wq);
+    irq_work_sync(&g.wake_work);
+    hrtimer_cancel(&wm.timer);
+    WRITE_ONCE(wm.timer_on, 0);
+    WRITE_ONCE(wm.armed, 1);
+    cancel_delayed_work_sync(&expiry.reap);
+
+    if (g.mode == FIFO_MODE_PRIO)
+        prio_free();
+    kvfree(g.cells);
+    kvfree(g.stamps);
+    g.cells = NULL;
+    g.stamps = NULL;
     pr_info("fifo free\n");
 }
 
+enum fifo_mode fifo_get_mode(void)
+{
+    return g.mode;
+}
+
 int fifo_size(void)
 {
-    if (!g.ready)
+    if (!READ_ONCE(g.ready))
         return 0;
 
-    return bytes_to_elems(kfifo_len(&g.fifo));
+    return fifo_len();
 }
 
 int fifo_available(void)
 {
-    if (!g.ready)
+    if (!READ_ONCE(g.ready))
         return 0;
 
-    return bytes_to_elems(kfifo_avail(&g.fifo));
+    return g.mask + 1 - fifo_len();
 }
 
 int fifo_is_empty(void)
 {
-    if (!g.ready)
+    if (!READ_ONCE(g.ready))
         return 1;
 
-    return kfifo_is_empty(&g.fifo) ? 1 : 0;
+    return fifo_len() == 0 ? 1 : 0;
 }
 
 int fifo_is_full(void)
 {
-    if (!g.ready)
+    if (!READ_ONCE(g.ready))
         return 0;
 
-    /* “полна”, если не хватает места хотя бы на 1 int */
-    return (kfifo_avail(&g.fifo) < sizeof(int)) ? 1 : 0;
+    return fifo_len() > g.mask ? 1 : 0;
 }
 
-void fifo_clear(void)
+/* голова опубликована: dequeue сейчас отдаст элемент */
+bool fifo_has_ready(void)
 {
-    unsigned long flags;
+    u32 deq;
 
-    if (!g.ready)
-        return;
+    if (!READ_ONCE(g.ready))
+        return false;
+    if (g.mode == FIFO_MODE_PRIO)
+        return prio_len() != 0;
+
+    deq = READ_ONCE(g.deq);
+    return smp_load_acquire(&g.cells[deq & g.mask].seq) == deq + 1;
+}
+
+/* deq только вперёд: в широковещании его двигают и курсоры, и производители */
+static void fifo_deq_advance(u32 to)
+{
+    u32 deq = READ_ONCE(g.deq), old;
 
-    spin_lock_irqsave(&g.lock, flags);
-    kfifo_reset(&g.fifo);
-    spin_unlock_irqrestore(&g.lock, flags);
+    while ((s32)(to - deq) > 0) {
+        old = cmpxchg(&g.deq, deq, to);
+        if (old == deq)
+            break;
+        deq = old;
+    }
+}
+
+/*
+ * Широковещание, кольцо полно: затирать старейшее можно при FIFO_LAG_DROP
+ * или когда подписчиков нет вовсе (тогда кольцо хранит последние cap).
+ */
+static inline bool fifo_may_overwrite(void)
+{
+    return g.mode == FIFO_MODE_BCAST &&
+           (READ_ONCE(bc.policy) == FIFO_LAG_DROP || !READ_ONCE(bc.nr));
+}
 
-    pr_info("clear (size=%d)\n", fifo_size());
+/* отпустить старейший элемент; неопубликованный (производителя прервали) — нельзя */
+static bool fifo_drop_oldest(u32 deq)
+{
+    if (smp_load_acquire(&g.cells[deq & g.mask].seq) != deq + 1)
+        return READ_ONCE(g.deq) != deq;     /* снимок устарел — повторить */
+    if (cmpxchg(&g.deq, deq, deq + 1) == deq)
+        atomic_long_inc(&bc.overwritten);
+    return true;
 }
 
+/*
+ * Резерв до n позиций подряд; возвращает, сколько досталось (0 — полна),
+ * начало — в *pos. Цикл lock-free: cmpxchg проигрывает только тому, кто
+ * сам продвинулся. Снимок, где used > cap, — устаревший deq, перечитываем.
+ */
+static u32 fifo_reserve(u32 n, u32 *pos)
+{
+    u32 cap = g.mask + 1, deq, p, used, fit;
+
+    for (;;) {
+        deq = smp_load_acquire(&g.deq);
+        p = READ_ONCE(g.enq);
+        used = p - deq;
+        if (used > cap)
+            continue;
+
+        fit = min(n, cap - used);
+        if (fit < n && fit < cap && fifo_may_overwrite() && fifo_drop_oldest(deq))
+            continue;
+        if (!fit)
+            return 0;
+        if (cmpxchg(&g.enq, p, p + fit) == p)
+            break;
+    }
+
+    *pos = p;
+    return fit;
+}
+
+static inline void fifo_publish(u32 pos, int value, u32 stamp)
+{
+    struct fifo_cell *c = &g.cells[pos & g.mask];
+
+    /*
+     * Широковещание: ячейку прошлого круга может как раз читать отставший
+     * курсор или mmap. Сначала снимаем seq (pos не равно pos' + 1 ни для
+     * одной позиции этой ячейки, если ячеек не меньше двух), потом пишем.
+     */
+    if (g.mode == FIFO_MODE_BCAST) {
+        WRITE_ONCE(c->seq, pos);
+        smp_wmb();
+    }
+    WRITE_ONCE(c->value, value);
+    WRITE_ONCE(g.stamps[pos & g.mask], stamp);
+    smp_store_release(&c->seq, pos + 1);
+}
+
+/* в кучу: сколько легло (0 — полна) или FIFO_BUSY */
+static int fifo_heap_push(int prio, const int *vals, u32 n)
+{
+    int ret = prio_push(prio, vals, n, fifo_stamp());
+
+    if (ret > 0) {
+        /* unlock — только release; барьер перед armed, как cmpxchg у кольца */
+        smp_mb();
+        fifo_kick();
+    }
+    return ret;
+}
+
+static int fifo_put(int prio, int value)
+{
+    int ret = FIFO_OK;
+    u32 pos;
+
+    if (g.mode == FIFO_MODE_PRIO) {
+        ret = fifo_heap_push(prio, &value, 1);
+        return ret < 0 ? ret : (ret ? FIFO_OK : FIFO_FULL);
+    }
+
+    /* без вытеснения между резервом и публикацией: иначе голова висит квант */
+    preempt_disable();
+    if (fifo_reserve(1, &pos)) {
+        fifo_publish(pos, value, fifo_stamp());
+        fifo_kick();
+    } else {
+        ret = FIFO_FULL;
+    }
+    preempt_enable();
+
+    return ret;
+}
+
+/* размер для события — снимок после операции, под конкуренцией приблизительный */
 int fifo_enqueue(int value)
 {
-    unsigned long flags;
-    unsigned int written;
+    u64 t0 = fifo_trace_start(fifo_enqueue);
+    int ret;
 
-    if (!g.ready)
+    if (!READ_ONCE(g.ready))
+        return FIFO_INVALID;
+
+    ret = fifo_put(FIFO_PRIO_DEFAULT, value);
+
+    trace_fifo_enqueue(value, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
+
+int fifo_enqueue_prio(int prio, int value)
+{
+    u64 t0 = fifo_trace_start(fifo_enqueue_prio);
+    int ret;
+
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_PRIO)
+        return FIFO_INVALID;
+    if (prio < 0 || prio > FIFO_PRIO_MAX)
+        return FIFO_INVALID;
+
+    ret = fifo_put(prio, value);
+
+    trace_fifo_enqueue_prio(prio, value, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
+
+/*
+ * Один резерв на всю пачку: для BPF-программ, что копят события в буфере.
+ * Места меньше, чем n, — кладём префикс, остальное вызывающий решает сам.
+ */
+int fifo_enqueue_bulk(const int *vals, unsigned int n)
+{
+    u64 t0 = fifo_trace_start(fifo_enqueue_bulk);
+    u32 pos, fit, i, stamp;
+    int ret;
+
+    if (!READ_ONCE(g.ready) || (!vals && n))
         return FIFO_INVALID;
+    if (n > INT_MAX)
+        return FIFO_INVALID;
+
+    if (g.mode == FIFO_MODE_PRIO) {
+        ret = n ? fifo_heap_push(FIFO_PRIO_DEFAULT, vals, n) : 0;
+    } else {
+        preempt_disable();
+        fit = n ? fifo_reserve(n, &pos) : 0;
+        stamp = fifo_stamp();
+        for (i = 0; i < fit; i++)
+            fifo_publish(pos + i, vals[i], stamp);
+        if (fit)
+            fifo_kick();
+        preempt_enable();
+        ret = fit;
+    }
+
+    if (n && !ret)
+        ret = FIFO_FULL;
+    trace_fifo_enqueue_bulk(n, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
+
+/*
+ * Широковещание. Курсор читает ячейку pos, пока её seq == pos + 1; ячейку
+ * могут затереть прямо под ним (FIFO_LAG_DROP), поэтому seq сверяется до
+ * и после чтения, как у seqlock. Отставший курсор (deq ушёл вперёд)
+ * перескакивает на deq и считает потерянное в lost.
+ *
+ * deq — минимум курсоров: сдвигает его только тот, кто сам на нём стоял.
+ * Подписчиков нет — deq двигают производители, кольцо хранит последние
+ * cap элементов, и новый подписчик их увидит.
+ */
+static bool fifo_bcast_get(u32 pos, int *value, u32 *stamp)
+{
+    struct fifo_cell *c = &g.cells[pos & g.mask];
+
+    if (smp_load_acquire(&c->seq) != pos + 1)
+        return false;
+    *value = READ_ONCE(c->value);
+    *stamp = READ_ONCE(g.stamps[pos & g.mask]);
+    smp_rmb();
+    return READ_ONCE(c->seq) == pos + 1;
+}
+
+/*
+ * До n опубликованных элементов от курсора: копирует в out (если есть) и
+ * сдвигает курсор. ttl — пропускать просроченные, не считая их; для
+ * advance после mmap — нет: подписчик их уже видел.
+ */
+static u32 fifo_cursor_walk(struct fifo_cursor *c, int *out, u32 n, bool ttl)
+{
+    u32 pos = c->pos, now = fifo_now(), i = 0, expired = 0, deq, stamp;
+    int v;
+
+    /* clear и чистильщик сдвигают deq, не трогая ячеек: сверяемся сразу */
+    deq = smp_load_acquire(&g.deq);
+    if ((s32)(deq - pos) > 0) {
+        c->lost += deq - pos;
+        pos = deq;
+    }
+
+    while (i < n) {
+        if (fifo_bcast_get(pos, &v, &stamp)) {
+            pos++;
+            if (ttl && fifo_stamp_expired(stamp, now)) {
+                expired++;
+                continue;
+            }
+            if (out)
+                out[i] = v;
+            i++;
+            continue;
+        }
+
+        deq = smp_load_acquire(&g.deq);
+        if ((s32)(deq - pos) <= 0)
+            break;
+        c->lost += deq - pos;
+        pos = deq;
+    }
 
-    spin_lock_irqsave(&g.lock, flags);
+    if (expired)
+        atomic_long_add(expired, &expiry.skipped);
+    WRITE_ONCE(c->pos, pos);
+    return i;
+}
+
+/* под bc.lock: deq — к самому медленному курсору */
+static void fifo_cursor_reclaim_locked(void)
+{
+    struct fifo_cursor *c;
+    u32 min;
+
+    if (list_empty(&bc.list))
+        return;
 
-    if (kfifo_avail(&g.fifo) < sizeof(int)) {
-        spin_unlock_irqrestore(&g.lock, flags);
-        return FIFO_FULL;
+    min = READ_ONCE(list_first_entry(&bc.list, struct fifo_cursor, node)->pos);
+    list_for_each_entry(c, &bc.list, node) {
+        if ((s32)(READ_ONCE(c->pos) - min) < 0)
+            min = READ_ONCE(c->pos);
     }
+    fifo_deq_advance(min);
+}
+
+/* курсор ушёл с old; если он держал deq (или отстал), пересчитываем минимум */
+static void fifo_cursor_reclaim(u32 old)
+{
+    if ((s32)(old - READ_ONCE(g.deq)) > 0)
+        return;
+
+    spin_lock(&bc.lock);
+    fifo_cursor_reclaim_locked();
+    spin_unlock(&bc.lock);
+    fifo_rearm();
+}
+
+static int fifo_bcast_peek(int *out)
+{
+    struct fifo_cursor c = { .pos = smp_load_acquire(&g.deq) };
+
+    return fifo_cursor_walk(&c, out, 1, true) ? 1 : FIFO_EMPTY;
+}
 
-    written = kfifo_in(&g.fifo, &value, sizeof(value));
-    spin_unlock_irqrestore(&g.lock, flags);
+/* всё опубликованное — в прошлое; курсоры увидят это как потерю */
+static u32 fifo_bcast_clear(void)
+{
+    u32 deq = smp_load_acquire(&g.deq), pos = deq;
+
+    while (pos - deq <= g.mask &&
+           smp_load_acquire(&g.cells[pos & g.mask].seq) == pos + 1)
+        pos++;
+    fifo_deq_advance(pos);
 
-    if (written != sizeof(value))
+    return pos - deq;
+}
+
+int fifo_cursor_attach(struct fifo_cursor *c)
+{
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_BCAST)
         return FIFO_INVALID;
 
-    pr_info("enqueue %d (size=%d)\n", value, fifo_size());
+    c->lost = 0;
+    spin_lock(&bc.lock);
+    c->pos = READ_ONCE(g.deq);
+    list_add_tail(&c->node, &bc.list);
+    WRITE_ONCE(bc.nr, bc.nr + 1);
+    spin_unlock(&bc.lock);
+
     return FIFO_OK;
 }
 
-int fifo_dequeue(int *out)
+void fifo_cursor_detach(struct fifo_cursor *c)
 {
-    unsigned long flags;
-    unsigned int read;
+    spin_lock(&bc.lock);
+    list_del_init(&c->node);
+    WRITE_ONCE(bc.nr, bc.nr - 1);
+    fifo_cursor_reclaim_locked();
+    spin_unlock(&bc.lock);
+
+    if (READ_ONCE(g.ready))
+        fifo_rearm();
+}
 
-    if (!g.ready || !out)
+int fifo_cursor_read(struct fifo_cursor *c, int *out, unsigned int n)
+{
+    u64 t0 = fifo_trace_start(fifo_cursor_read);
+    u32 old = c->pos;
+    int ret;
+
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_BCAST || (!out && n))
         return FIFO_INVALID;
+    if (n > INT_MAX)
+        return FIFO_INVALID;
+
+    ret = fifo_cursor_walk(c, out, n, true);
+    if (n && !ret)
+        ret = FIFO_EMPTY;
+    fifo_cursor_reclaim(old);
+
+    trace_fifo_cursor_read(n, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
+
+/* подписчик прочёл n элементов сам (mmap): возвращает, на сколько сдвинулись */
+int fifo_cursor_advance(struct fifo_cursor *c, unsigned int n)
+{
+    u32 old = c->pos;
+    int ret;
+
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_BCAST || n > INT_MAX)
+        return FIFO_INVALID;
+
+    ret = fifo_cursor_walk(c, NULL, n, false);
+    fifo_cursor_reclaim(old);
+    return ret;
+}
 
-    spin_lock_irqsave(&g.lock, flags);
+bool fifo_cursor_ready(struct fifo_cursor *c)
+{
+    u32 pos = READ_ONCE(c->pos);
+
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_BCAST)
+        return false;
+
+    return smp_load_acquire(&g.cells[pos & g.mask].seq) == pos + 1 ||
+           (s32)(READ_ONCE(g.deq) - pos) > 0;
+}
+
+/* как fifo_wait_ready, но по своему курсору; партии и пороги те же */
+int fifo_cursor_wait(struct fifo_cursor *c)
+{
+    int ret = wait_event_interruptible(g.wq, fifo_cursor_ready(c) || !READ_ONCE(g.ready));
+
+    if (!ret && !READ_ONCE(g.ready))
+        return -ENODEV;
+    return ret;
+}
+
+/* кольцо только на чтение; fifo_free при открытом mmap бывает лишь в KUnit */
+int fifo_bcast_mmap(struct vm_area_struct *vma)
+{
+    if (!READ_ONCE(g.ready) || g.mode != FIFO_MODE_BCAST)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
 
-    if (kfifo_is_empty(&g.fifo)) {
-        spin_unlock_irqrestore(&g.lock, flags);
-        return FIFO_EMPTY;
+    vma->vm_flags &= ~VM_MAYWRITE;
+    return remap_vmalloc_range(vma, g.cells, vma->vm_pgoff);
+}
+
+void fifo_set_lag_policy(enum fifo_lag_policy policy)
+{
+    WRITE_ONCE(bc.policy, policy);
+}
+
+enum fifo_lag_policy fifo_get_lag_policy(void)
+{
+    return READ_ONCE(bc.policy);
+}
+
+unsigned long fifo_overwritten(void)
+{
+    return atomic_long_read(&bc.overwritten);
+}
+
+/*
+ * До n голов подряд под cons_lock; consume — забрать (dequeue) или только
+ * посмотреть (peek, n = 1). Возвращает число элементов или FIFO_EMPTY.
+ * Кольцо останавливается на первой неопубликованной ячейке, deq двигается
+ * один раз на всю пачку. Просроченные головы выбрасываются по пути, в
+ * том числе при peek: отдавать их всё равно некому.
+ */
+static int fifo_take(int *out, u32 n, bool consume)
+{
+    u32 now = fifo_now(), deq, idx, i = 0, expired = 0;
+    int ret;
+
+    if (g.mode == FIFO_MODE_PRIO) {
+        ret = prio_pop(out, n, consume, now, &expired);
+    } else if (g.mode == FIFO_MODE_BCAST) {
+        /* забирать у всех сразу нельзя, смотреть — можно */
+        ret = consume ? FIFO_INVALID : fifo_bcast_peek(out);
+    } else {
+        spin_lock(&g.cons_lock);
+        for (deq = g.deq; i < n; deq++) {
+            idx = deq & g.mask;
+            if (smp_load_acquire(&g.cells[idx].seq) != deq + 1)
+                break;
+            if (fifo_stamp_expired(g.stamps[idx], now)) {
+                expired++;
+                continue;
+            }
+            out[i++] = g.cells[idx].value;
+            if (!consume)
+                break;
+        }
+        if (deq != g.deq)
+            smp_store_release(&g.deq, deq);
+        spin_unlock(&g.cons_lock);
+        ret = i ? i : FIFO_EMPTY;
+    }
+
+    if (expired)
+        atomic_long_add(expired, &expiry.skipped);
+    return ret;
+}
+
+/* просроченные головы кольца, не больше budget; живая или неопубликованная — стоп */
+static u32 fifo_ring_reap(u32 now, u32 budget)
+{
+    u32 deq, idx, dropped = 0;
+
+    spin_lock(&g.cons_lock);
+    for (deq = g.deq; dropped < budget; deq++, dropped++) {
+        idx = deq & g.mask;
+        if (smp_load_acquire(&g.cells[idx].seq) != deq + 1 ||
+            !fifo_stamp_expired(g.stamps[idx], now))
+            break;
     }
+    if (dropped)
+        fifo_deq_advance(deq);
+    spin_unlock(&g.cons_lock);
 
-    read = kfifo_out(&g.fifo, out, sizeof(*out));
-    spin_unlock_irqrestore(&g.lock, flags);
+    return dropped;
+}
+
+/* пока срок задан и очередь есть — раз в полсрока, но не чаще FIFO_REAP_MIN_MS */
+static void fifo_reap_schedule(void)
+{
+    u32 ttl = READ_ONCE(expiry.ttl);
+
+    if (!ttl || !READ_ONCE(g.ready))
+        return;
+
+    mod_delayed_work(system_wq, &expiry.reap,
+                     max_t(u32, ttl / 2, msecs_to_jiffies(FIFO_REAP_MIN_MS)));
+}
+
+static void fifo_reap_fn(struct work_struct *work)
+{
+    u64 t0 = fifo_trace_start(fifo_reap);
+    u32 now = fifo_now(), dropped = 0, n;
 
-    if (read != sizeof(*out))
+    /* free ждёт нас в cancel_delayed_work_sync, но мог уже снять ready */
+    if (!READ_ONCE(g.ready))
+        return;
+
+    do {
+        n = g.mode == FIFO_MODE_PRIO ? prio_reap(now, FIFO_REAP_BATCH)
+                                     : fifo_ring_reap(now, FIFO_REAP_BATCH);
+        dropped += n;
+        cond_resched();
+    } while (n == FIFO_REAP_BATCH);
+
+    if (dropped) {
+        atomic_long_add(dropped, &expiry.reaped);
+        fifo_rearm();
+        trace_fifo_reap(dropped, fifo_trace_ns(t0));
+    }
+    fifo_reap_schedule();
+}
+
+void fifo_clear(void)
+{
+    u64 t0 = fifo_trace_start(fifo_clear);
+    int dropped = 0, v;
+
+    if (!READ_ONCE(g.ready))
+        return;
+
+    /*
+     * Сбросить enq/deq нельзя: производители работают без лока. Забираем
+     * всё опубликованное; что допишут параллельно — уже после clear.
+     * Куча под локом, её обнуляем сразу.
+     */
+    if (g.mode == FIFO_MODE_PRIO)
+        dropped = prio_clear();
+    else if (g.mode == FIFO_MODE_BCAST)
+        dropped = fifo_bcast_clear();
+    else
+        while (fifo_take(&v, 1, true) > 0)
+            dropped++;
+    fifo_rearm();
+
+    trace_fifo_clear(dropped, fifo_trace_ns(t0));
+}
+
+int fifo_dequeue(int *out)
+{
+    u64 t0 = fifo_trace_start(fifo_dequeue);
+    int value = 0, ret;
+
+    if (!READ_ONCE(g.ready) || !out)
         return FIFO_INVALID;
 
-    pr_info("dequeue -> %d (size=%d)\n", *out, fifo_size());
-    return FIFO_OK;
+    ret = fifo_take(&value, 1, true);
+    if (ret > 0) {
+        *out = value;
+        ret = FIFO_OK;
+    }
+    fifo_rearm();
+
+    trace_fifo_dequeue(value, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
+
+/* до n элементов за один захват лока; в режиме приоритетов — n старших по порядку */
+int fifo_dequeue_bulk(int *out, unsigned int n)
+{
+    u64 t0 = fifo_trace_start(fifo_dequeue_bulk);
+    int ret;
+
+    if (!READ_ONCE(g.ready) || (!out && n))
+        return FIFO_INVALID;
+    if (n > INT_MAX)
+        return FIFO_INVALID;
+
+    ret = n ? fifo_take(out, n, true) : 0;
+    fifo_rearm();
+
+    trace_fifo_dequeue_bulk(n, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
 }
 
 int fifo_peek(int *out)
 {
-    unsigned long flags;
-    unsigned int read;
+    u64 t0 = fifo_trace_start(fifo_peek);
+    int value = 0, ret;
 
-    if (!g.ready || !out)
+    if (!READ_ONCE(g.ready) || !out)
         return FIFO_INVALID;
 
-    spin_lock_irqsave(&g.lock, flags);
+    ret = fifo_take(&value, 1, false);
+    if (ret > 0) {
+        *out = value;
+        ret = FIFO_OK;
+    }
+    /* по пути могли выбросить просроченные */
+    fifo_rearm();
+
+    trace_fifo_peek(value, fifo_len(), ret, fifo_trace_ns(t0));
+    return ret;
+}
 
-    if (kfifo_is_empty(&g.fifo)) {
-        spin_unlock_irqrestore(&g.lock, flags);
-        return FIFO_EMPTY;
+/* партия объявлена и голова готова: блокирующему читателю пора просыпаться */
+bool fifo_batch_ready(void)
+{
+    return !READ_ONCE(wm.armed) && fifo_has_ready();
+}
+
+/* читатели /dev/kernel_fifo: ждать объявленную партию; -ENODEV, если очередь освободили */
+int fifo_wait_ready(void)
+{
+    int ret = wait_event_interruptible(g.wq, fifo_batch_ready() || !READ_ONCE(g.ready));
+
+    if (!ret && !READ_ONCE(g.ready))
+        return -ENODEV;
+    return ret;
+}
+
+void fifo_poll_wait(struct file *file, struct poll_table_struct *pt)
+{
+    poll_wait(file, &g.wq, pt);
+}
+
+/*
+ * Пороги партии: 1 <= high <= ёмкость, low < high; batch_us = 0 — без
+ * таймера. Новые значения сразу сверяются с текущей длиной. До fifo_init
+ * (параметры insmod) пара не сверяется: значения приходят по одному и в
+ * любом порядке, проверяет их kernel_fifo_init.
+ */
+int fifo_set_watermarks(unsigned int high, unsigned int low)
+{
+    if (!READ_ONCE(g.ready)) {
+        WRITE_ONCE(wm.wm_high, high);
+        WRITE_ONCE(wm.wm_low, low);
+        return FIFO_OK;
     }
+    if (!high || low >= high || high > g.mask + 1)
+        return FIFO_INVALID;
+
+    WRITE_ONCE(wm.wm_high, high);
+    WRITE_ONCE(wm.wm_low, low);
+    smp_mb();
+    if (READ_ONCE(g.ready)) {
+        fifo_rearm();
+        fifo_kick();
+    }
+    return FIFO_OK;
+}
+
+void fifo_get_watermarks(unsigned int *high, unsigned int *low)
+{
+    *high = READ_ONCE(wm.wm_high);
+    *low = READ_ONCE(wm.wm_low);
+}
+
+void fifo_set_batch_us(unsigned int us)
+{
+    WRITE_ONCE(wm.batch_ns, (u64)us * NSEC_PER_USEC);
+    smp_mb();
+    if (READ_ONCE(g.ready))
+        fifo_kick();
+}
+
+unsigned int fifo_get_batch_us(void)
+{
+    return div_u64(READ_ONCE(wm.batch_ns), NSEC_PER_USEC);
+}
 
-    read = kfifo_out_peek(&g.fifo, out, sizeof(*out));
-    spin_unlock_irqrestore(&g.lock, flags);
+/* сколько партий объявлено с загрузки: по нему видно, что пробуждения сливаются */
+unsigned long fifo_notifications(void)
+{
+    return atomic_long_read(&wm.notifies);
+}
+
+void fifo_listener_add(struct fifo_listener *l)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&wm.ev_lock, flags);
+    list_add_tail(&l->node, &wm.listeners);
+    spin_unlock_irqrestore(&wm.ev_lock, flags);
+}
+
+/* после возврата fifo_notify этот eventfd уже не тронет, его можно отпускать */
+void fifo_listener_del(struct fifo_listener *l)
+{
+    unsigned long flags;
 
-    if (read != sizeof(*out))
+    spin_lock_irqsave(&wm.ev_lock, flags);
+    list_del_init(&l->node);
+    spin_unlock_irqrestore(&wm.ev_lock, flags);
+}
+
+/* 0 — без срока; новый срок получают только новые элементы */
+int fifo_set_ttl_ms(unsigned int ms)
+{
+    if (ms > FIFO_TTL_MAX_MS)
         return FIFO_INVALID;
 
-    pr_info("peek -> %d (size=%d)\n", *out, fifo_size());
+    WRITE_ONCE(expiry.ttl_ms, ms);
+    WRITE_ONCE(expiry.ttl, msecs_to_jiffies(ms));
+    fifo_reap_schedule();
     return FIFO_OK;
 }
+
+unsigned int fifo_get_ttl_ms(void)
+{
+    return READ_ONCE(expiry.ttl_ms);
+}
+
+void fifo_expired(unsigned long *skipped, unsigned long *reaped)
+{
+    *skipped = atomic_long_read(&expiry.skipped);
+    *reaped = atomic_long_read(&expiry.reaped);
+}
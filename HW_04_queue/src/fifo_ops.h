@@ -0,0 +1,139 @@
+#ifndef KERNEL_FIFO_OPS_H
+#define KERNEL_FIFO_OPS_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+/* Ошибки как в задании (можно подстроить под ваши константы) */
+#define FIFO_OK       0
+#define FIFO_EMPTY   -1
+#define FIFO_FULL    -2
+#define FIFO_NOMEM   -3
+#define FIFO_INVALID -4
+#define FIFO_BUSY    -5     /* только режим приоритетов: enqueue из NMI не взял лок */
+
+/*
+ * режим задаётся при init: кольцо FIFO, куча по приоритетам или
+ * широковещательное кольцо (каждый подписчик читает всё своим курсором)
+ */
+enum fifo_mode {
+    FIFO_MODE_FIFO,
+    FIFO_MODE_PRIO,
+    FIFO_MODE_BCAST,
+};
+
+/* что делать с подписчиком, который отстал на всю ёмкость */
+enum fifo_lag_policy {
+    FIFO_LAG_BLOCK,         /* ждём его: производители получают FIFO_FULL */
+    FIFO_LAG_DROP,          /* затираем старейшее, подписчик его теряет */
+};
+
+/* приоритеты 0..FIFO_PRIO_MAX, больший выходит раньше; обычный enqueue — 0 */
+#define FIFO_PRIO_MAX     255
+#define FIFO_PRIO_DEFAULT 0
+
+struct eventfd_ctx;
+struct file;
+struct poll_table_struct;
+struct vm_area_struct;
+
+/* ёмкость в элементах int, округляется вверх до степени двойки */
+int fifo_init(int max_size, enum fifo_mode mode);
+void fifo_free(void);
+enum fifo_mode fifo_get_mode(void);
+
+/*
+ * enqueue без локов: не спит, не печатает и работает в любом контексте,
+ * включая NMI и BPF-программы. Читателей будит отложенно, через irq_work.
+ * bulk кладёт сколько влезло и возвращает число элементов (или код < 0).
+ * dequeue/peek/clear — из контекста процесса.
+ *
+ * В режиме приоритетов enqueue идёт под raw-спинлоком (из NMI — trylock,
+ * иначе FIFO_BUSY), обычный enqueue и bulk кладут с FIFO_PRIO_DEFAULT.
+ * dequeue отдаёт элемент с наибольшим приоритетом, при равных — первый
+ * пришедший; dequeue_bulk — до n таких подряд. enqueue_prio в режиме
+ * FIFO — FIFO_INVALID.
+ *
+ * В режиме широковещания элементы никто не забирает: dequeue и
+ * dequeue_bulk — FIFO_INVALID, читают через курсоры (ниже). peek — самый
+ * старый из хранимых, clear отбрасывает всё, size — сколько хранится.
+ */
+int fifo_enqueue(int value);
+int fifo_enqueue_prio(int prio, int value);
+int fifo_enqueue_bulk(const int *vals, unsigned int n);
+int fifo_dequeue(int *out);
+int fifo_dequeue_bulk(int *out, unsigned int n);
+int fifo_peek(int *out);
+int fifo_size(void);
+int fifo_available(void);
+int fifo_is_empty(void);
+int fifo_is_full(void);
+void fifo_clear(void);
+
+/*
+ * Уведомления партиями (см. fifo_ops.c): партия объявляется, когда длина
+ * дошла до high или истёк таймер batch_us с первого элемента; следующая —
+ * после того как потребители выбрали очередь до low.
+ */
+int fifo_set_watermarks(unsigned int high, unsigned int low);
+void fifo_get_watermarks(unsigned int *high, unsigned int *low);
+void fifo_set_batch_us(unsigned int us);
+unsigned int fifo_get_batch_us(void);
+unsigned long fifo_notifications(void);
+
+/*
+ * Срок годности (TTL) элементов, 0 — выкл. Просроченные выбрасываются
+ * при dequeue/peek (skipped) и чистильщиком в фоне (reaped); size их
+ * считает, пока их не выбросили.
+ */
+int fifo_set_ttl_ms(unsigned int ms);
+unsigned int fifo_get_ttl_ms(void);
+void fifo_expired(unsigned long *skipped, unsigned long *reaped);
+
+/* для /dev/kernel_fifo (dev.c): ожидание партии, poll и eventfd'ы */
+struct fifo_listener {
+    struct list_head node;
+    struct eventfd_ctx *efd;
+};
+
+/*
+ * Подписчики режима широковещания. Курсор — позиция следующего элемента
+ * для этого подписчика; хранится всё, что не прочли самые медленные.
+ * Новый курсор начинает с самого старого хранимого элемента. read
+ * копирует до n элементов, advance только сдвигает курсор (подписчик
+ * прочёл их сам через mmap кольца). Вызовы одного курсора вызывающий
+ * сериализует сам. lost — сколько элементов затёрли раньше, чем курсор
+ * до них дошёл (FIFO_LAG_DROP, clear, TTL).
+ */
+struct fifo_cursor {
+    struct list_head node;
+    u32 pos;
+    unsigned long lost;
+};
+
+int fifo_cursor_attach(struct fifo_cursor *c);
+void fifo_cursor_detach(struct fifo_cursor *c);
+int fifo_cursor_read(struct fifo_cursor *c, int *out, unsigned int n);
+int fifo_cursor_advance(struct fifo_cursor *c, unsigned int n);
+bool fifo_cursor_ready(struct fifo_cursor *c);
+int fifo_cursor_wait(struct fifo_cursor *c);
+int fifo_bcast_mmap(struct vm_area_struct *vma);
+void fifo_set_lag_policy(enum fifo_lag_policy policy);
+enum fifo_lag_policy fifo_get_lag_policy(void);
+unsigned long fifo_overwritten(void);
+
+bool fifo_has_ready(void);
+bool fifo_batch_ready(void);
+int fifo_wait_ready(void);
+void fifo_poll_wait(struct file *file, struct poll_table_struct *pt);
+void fifo_listener_add(struct fifo_listener *l);
+void fifo_listener_del(struct fifo_listener *l);
+
+/* kfuncs для BPF (src/fifo_bpf.c), без CONFIG_BPF_SYSCALL — пустышка */
+#if IS_ENABLED(CONFIG_BPF_SYSCALL)
+int fifo_bpf_register(void);
+#else
+static inline int fifo_bpf_register(void) { return 0; }
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+// src/fifo_prio.c
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/build_bug.h>
+#include <linux/hardirq.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+#include "fifo_ops.h"
+#include "fifo_prio.h"
+
+/*
+ * Режим приоритетов: 4-арная куча-минимум в массиве. Ключ — приоритет,
+ * перевёрнутый в старших 8 битах (больший приоритет — меньший ключ), и
+ * порядковый номер в младших 56: внутри уровня раньше выходит тот, кто
+ * раньше пришёл. 2^56 вставок не наберётся, номер не переполняется.
+ *
+ * Элемент — 16 байт, четверо детей узла — ровно одна строка кэша:
+ * массив сдвинут на три элемента от выровненного начала, и дети i
+ * (4i+1 .. 4i+4) начинаются на границе строки. Просеивание вниз читает
+ * одну строку на уровень, а уровней вдвое меньше, чем у двоичной кучи.
+ * Срок годности (TTL) лежит в том же элементе, на месте выравнивания.
+ *
+ * Без лока кучу не сделать: производители и потребители идут под
+ * raw-спинлоком с выключенными прерываниями. В NMI лок только пробуем —
+ * прерванный владелец мог остаться на этом же CPU; не вышло — FIFO_BUSY.
+ */
+#define PRIO_D          4
+#define PRIO_SEQ_BITS   56
+#define PRIO_SEQ_MASK   ((1ULL << PRIO_SEQ_BITS) - 1)
+#define PRIO_LINE       (PRIO_D * sizeof(struct prio_ent))
+
+struct prio_ent {
+    u64 key;
+    int value;
+    u32 stamp;              /* срок годности, см. fifo_stamp_expired */
+};
+
+static_assert(sizeof(struct prio_ent) == 16);
+
+static struct {
+    raw_spinlock_t lock;
+    struct prio_ent *heap;  /* heap[0] — вершина */
+    void *mem;              /* что вернул kvmalloc, для kvfree */
+    u32 cap;
+    u32 count;              /* пишут под локом, fifo_len читает без */
+    u64 seq;
+} p = {
+    .lock = __RAW_SPIN_LOCK_UNLOCKED(p.lock),
+};
+
+static inline u64 prio_key(int prio)
+{
+    return ((u64)(FIFO_PRIO_MAX - prio) << PRIO_SEQ_BITS) | (p.seq++ & PRIO_SEQ_MASK);
+}
+
+static bool prio_lock(unsigned long *flags)
+{
+    if (in_nmi())
+        return raw_spin_trylock_irqsave(&p.lock, *flags);
+
+    raw_spin_lock_irqsave(&p.lock, *flags);
+    return true;
+}
+
+/* дырка поднимается от i, пока родитель больше e */
+static void prio_sift_up(u32 i, struct prio_ent e)
+{
+    struct prio_ent *h = p.heap;
+    u32 parent;
+
+    while (i) {
+        parent = (i - 1) / PRIO_D;
+        if (h[parent].key <= e.key)
+            break;
+        h[i] = h[parent];
+        i = parent;
+    }
+    h[i] = e;
+}
+
+/* дырка опускается от i к меньшему из детей (одна строка кэша) */
+static void prio_sift_down(u32 i, struct prio_ent e)
+{
+    struct prio_ent *h = p.heap;
+    u32 c, end, j, best;
+
+    for (;;) {
+        c = i * PRIO_D + 1;
+        if (c >= p.count)
+            break;
+
+        end = min(c + PRIO_D, p.count);
+        best = c;
+        for (j = c + 1; j < end; j++) {
+            if (h[j].key < h[best].key)
+                best = j;
+        }
+        if (h[best].key >= e.key)
+            break;
+
+        h[i] = h[best];
+        i = best;
+    }
+    h[i] = e;
+}
+
+int prio_init(u32 cap)
+{
+    /* три элемента сдвига и запас на выравнивание */
+    size_t bytes = (size_t)(cap + PRIO_D - 1) * sizeof(struct prio_ent) + PRIO_LINE;
+
+    p.mem = kvmalloc(bytes, GFP_KERNEL);
+    if (!p.mem) {
+        pr_err("heap alloc failed: %u elems\n", cap);
+        return FIFO_NOMEM;
+    }
+
+    p.heap = (struct prio_ent *)PTR_ALIGN(p.mem, PRIO_LINE) + (PRIO_D - 1);
+    p.cap = cap;
+    p.count = 0;
+    p.seq = 0;
+    return FIFO_OK;
+}
+
+void prio_free(void)
+{
+    kvfree(p.mem);
+    p.mem = NULL;
+    p.heap = NULL;
+    p.cap = 0;
+    WRITE_ONCE(p.count, 0);
+}
+
+u32 prio_len(void)
+{
+    return READ_ONCE(p.count);
+}
+
+/* кладёт сколько влезло, все — с одним приоритетом и сроком; 0 — куча полна */
+int prio_push(int prio, const int *vals, u32 n, u32 stamp)
+{
+    struct prio_ent e = { .stamp = stamp };
+    unsigned long flags;
+    u32 i, fit;
+
+    if (!prio_lock(&flags))
+        return FIFO_BUSY;
+
+    fit = min(n, p.cap - p.count);
+    for (i = 0; i < fit; i++) {
+        e.key = prio_key(prio);
+        e.value = vals[i];
+        WRITE_ONCE(p.count, p.count + 1);
+        prio_sift_up(p.count - 1, e);
+    }
+    raw_spin_unlock_irqrestore(&p.lock, flags);
+
+    return fit;
+}
+
+/* под локом, куча не пуста */
+static void prio_remove_top(void)
+{
+    WRITE_ONCE(p.count, p.count - 1);
+    if (p.count)
+        prio_sift_down(0, p.heap[p.count]);
+}
+
+/*
+ * До n вершин по убыванию приоритета; consume == false — только первая,
+ * без изъятия (peek). Просроченные вершины по пути выбрасываются и в
+ * том, и в другом случае. Возвращает число элементов, пустая — FIFO_EMPTY.
+ */
+int prio_pop(int *out, u32 n, bool consume, u32 now, u32 *expired)
+{
+    unsigned long flags;
+    u32 i = 0, dropped = 0;
+
+    raw_spin_lock_irqsave(&p.lock, flags);
+    while (i < n && p.count) {
+        if (fifo_stamp_expired(p.heap[0].stamp, now)) {
+            dropped++;
+        } else {
+            out[i++] = p.heap[0].value;
+            if (!consume)
+                break;
+        }
+        prio_remove_top();
+    }
+    raw_spin_unlock_irqrestore(&p.lock, flags);
+
+    *expired = dropped;
+    return i ? i : FIFO_EMPTY;
+}
+
+/*
+ * Чистильщик: снимает просроченные вершины, пока не встретит живую, но
+ * не больше budget за один захват лока. Просроченные в глубине кучи
+ * дождутся, пока поднимутся наверх.
+ */
+u32 prio_reap(u32 now, u32 budget)
+{
+    unsigned long flags;
+    u32 dropped = 0;
+
+    raw_spin_lock_irqsave(&p.lock, flags);
+    while (dropped < budget && p.count &&
+           fifo_stamp_expired(p.heap[0].stamp, now)) {
+        prio_remove_top();
+        dropped++;
+    }
+    raw_spin_unlock_irqrestore(&p.lock, flags);
+
+    return dropped;
+}
+
+u32 prio_clear(void)
+{
+    unsigned long flags;
+    u32 dropped;
+
+    raw_spin_lock_irqsave(&p.lock, flags);
+    dropped = p.count;
+    WRITE_ONCE(p.count, 0);
+    raw_spin_unlock_irqrestore(&p.lock, flags);
+
+    return dropped;
+}
@@ -0,0 +1,30 @@
+#ifndef KERNEL_FIFO_PRIO_H
+#define KERNEL_FIFO_PRIO_H
+
+#include <linux/jiffies.h>
+#include <linux/types.h>
+
+/*
+ * Срок годности элемента — младшие 32 бита jiffies, когда он истекает;
+ * 0 — бессрочный. Общее для кольца и кучи.
+ */
+static inline bool fifo_stamp_expired(u32 stamp, u32 now)
+{
+    return stamp && time_after32(now, stamp);
+}
+
+/*
+ * Куча для режима приоритетов (fifo_prio.c); снаружи её зовёт только
+ * fifo_ops.c. Коды возврата — FIFO_*, push/pop из любого контекста.
+ * pop выбрасывает просроченные вершины по пути (их число — в *expired),
+ * reap снимает только их и возвращает, сколько снял.
+ */
+int prio_init(u32 cap);
+void prio_free(void);
+u32 prio_len(void);
+int prio_push(int prio, const int *vals, u32 n, u32 stamp);
+int prio_pop(int *out, u32 n, bool consume, u32 now, u32 *expired);
+u32 prio_reap(u32 now, u32 budget);
+u32 prio_clear(void);
+
+#endif
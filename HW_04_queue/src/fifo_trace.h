@@ -0,0 +1,150 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kernel_fifo
+
+#if !defined(FIFO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define FIFO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * События операций очереди (events/kernel_fifo/ в tracefs).
+ * ret — код FIFO_*, size — элементов после операции, ns — время вызова.
+ */
+DECLARE_EVENT_CLASS(fifo_op,
+
+    TP_PROTO(int value, int size, int ret, u64 ns),
+
+    TP_ARGS(value, size, ret, ns),
+
+    TP_STRUCT__entry(
+        __field(int, value)
+        __field(int, size)
+        __field(int, ret)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->value = value;
+        __entry->size = size;
+        __entry->ret = ret;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("value=%d size=%d ret=%d ns=%llu",
+              __entry->value, __entry->size, __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(fifo_op, fifo_enqueue,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+DEFINE_EVENT(fifo_op, fifo_dequeue,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+DEFINE_EVENT(fifo_op, fifo_peek,
+    TP_PROTO(int value, int size, int ret, u64 ns),
+    TP_ARGS(value, size, ret, ns));
+
+/* режим приоритетов: то же, что fifo_enqueue, плюс приоритет */
+TRACE_EVENT(fifo_enqueue_prio,
+
+    TP_PROTO(int prio, int value, int size, int ret, u64 ns),
+
+    TP_ARGS(prio, value, size, ret, ns),
+
+    TP_STRUCT__entry(
+        __field(int, prio)
+        __field(int, value)
+        __field(int, size)
+        __field(int, ret)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->prio = prio;
+        __entry->value = value;
+        __entry->size = size;
+        __entry->ret = ret;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("prio=%d value=%d size=%d ret=%d ns=%llu",
+              __entry->prio, __entry->value, __entry->size, __entry->ret,
+              __entry->ns)
+);
+
+/* ret — сколько элементов прошло (может быть меньше n) или код FIFO_* */
+DECLARE_EVENT_CLASS(fifo_bulk,
+
+    TP_PROTO(unsigned int n, int size, int ret, u64 ns),
+
+    TP_ARGS(n, size, ret, ns),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, n)
+        __field(int, size)
+        __field(int, ret)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->n = n;
+        __entry->size = size;
+        __entry->ret = ret;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("n=%u size=%d ret=%d ns=%llu",
+              __entry->n, __entry->size, __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(fifo_bulk, fifo_enqueue_bulk,
+    TP_PROTO(unsigned int n, int size, int ret, u64 ns),
+    TP_ARGS(n, size, ret, ns));
+
+DEFINE_EVENT(fifo_bulk, fifo_dequeue_bulk,
+    TP_PROTO(unsigned int n, int size, int ret, u64 ns),
+    TP_ARGS(n, size, ret, ns));
+
+/* широковещание: чтение одного подписчика, size — сколько хранится */
+DEFINE_EVENT(fifo_bulk, fifo_cursor_read,
+    TP_PROTO(unsigned int n, int size, int ret, u64 ns),
+    TP_ARGS(n, size, ret, ns));
+
+/* clear — всё содержимое, reap — просроченные головы (чистильщик TTL) */
+DECLARE_EVENT_CLASS(fifo_drop,
+
+    TP_PROTO(int dropped, u64 ns),
+
+    TP_ARGS(dropped, ns),
+
+    TP_STRUCT__entry(
+        __field(int, dropped)
+        __field(u64, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->dropped = dropped;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("dropped=%d ns=%llu", __entry->dropped, __entry->ns)
+);
+
+DEFINE_EVENT(fifo_drop, fifo_clear,
+    TP_PROTO(int dropped, u64 ns),
+    TP_ARGS(dropped, ns));
+
+DEFINE_EVENT(fifo_drop, fifo_reap,
+    TP_PROTO(int dropped, u64 ns),
+    TP_ARGS(dropped, ns));
+
+#endif
+
+/* заголовок лежит в src, он уже в путях поиска (см. Kbuild) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE fifo_trace
+#include <trace/define_trace.h>
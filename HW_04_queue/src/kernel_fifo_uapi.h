@@ -0,0 +1,46 @@
+#ifndef KERNEL_FIFO_UAPI_H
+#define KERNEL_FIFO_UAPI_H
+
+/* общий для модуля и userspace интерфейс /dev/kernel_fifo */
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define FIFO_DEV_NAME   "kernel_fifo"
+
+/*
+ * read()/write() — массивы int в байтах хоста. Блокирующий read ждёт
+ * объявленной партии (пороги — параметры wm_high/wm_low/batch_us), poll
+ * отдаёт EPOLLIN тогда же. При mode=prio read() отдаёт элементы по
+ * убыванию приоритета, write() кладёт их с приоритетом 0.
+ *
+ * FIFO_IOC_SET_EVENTFD: eventfd, который получает +1 на каждую партию,
+ * пока открыт этот файл; -1 — снять. Одному файлу — один eventfd.
+ *
+ * При mode=bcast каждый файл, открытый на чтение, — подписчик со своим
+ * курсором: read() отдаёт копии, не забирая элементы у других. Без копий:
+ * mmap(PROT_READ) отдаёт кольцо как fifo_bcast_cell[cap]. Элемент pos
+ * лежит в ячейке pos & (cap - 1) и готов, если seq == pos + 1; после
+ * чтения value seq нужно перечитать — не совпал, значит ячейку затёрли.
+ * Прочитанное подтверждается FIFO_IOC_BCAST_ADVANCE: пока курсор стоит,
+ * элементы хранятся (или затираются при lag_policy=drop, см. lost).
+ * Сроки годности (ttl_ms) через mmap не видны.
+ */
+#define FIFO_IOC_MAGIC          'q'
+#define FIFO_IOC_SET_EVENTFD    _IOW(FIFO_IOC_MAGIC, 1, __s32)
+
+struct fifo_bcast_cell {
+    __u32 seq;
+    __s32 value;
+};
+
+struct fifo_bcast_info {
+    __u32 cap;              /* ячеек в кольце, степень двойки */
+    __u32 pos;              /* следующий элемент курсора */
+    __u64 lost;             /* затёрто раньше, чем курсор до них дошёл */
+};
+
+#define FIFO_IOC_BCAST_INFO     _IOR(FIFO_IOC_MAGIC, 2, struct fifo_bcast_info)
+#define FIFO_IOC_BCAST_ADVANCE  _IOW(FIFO_IOC_MAGIC, 3, __u32)
+
+#endif
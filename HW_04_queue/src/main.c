@@ -4,26 +4,65 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 
-/* внешние функции из fifo_ops.c */
-int fifo_init(int max_size);
-void fifo_free(void);
-void fifo_clear(void);
+#include "dev.h"
+#include "fifo_ops.h"
 
 /* ёмкость FIFO (в элементах int), задаётся при загрузке */
 static int max_size = 16;
 module_param(max_size, int, 0444);
 MODULE_PARM_DESC(max_size, "FIFO capacity in int elements");
 
+/* порядок выдачи, задаётся при загрузке */
+static char *mode = "fifo";
+module_param(mode, charp, 0444);
+MODULE_PARM_DESC(mode, "Queue order: fifo (lock-free ring), prio (4-ary heap, enqueue_prio) or bcast (every reader of /dev/kernel_fifo sees every element)");
+
 static int __init kernel_fifo_init(void)
 {
-    int ret = fifo_init(max_size);
+    enum fifo_mode m;
+    unsigned int high, low;
+    int ret;
+
+    if (sysfs_streq(mode, "fifo")) {
+        m = FIFO_MODE_FIFO;
+    } else if (sysfs_streq(mode, "prio")) {
+        m = FIFO_MODE_PRIO;
+    } else if (sysfs_streq(mode, "bcast")) {
+        m = FIFO_MODE_BCAST;
+    } else {
+        pr_err("unknown mode '%s'\n", mode);
+        return -EINVAL;
+    }
+
+    /* wm_high/wm_low при insmod принимаются без сверки, пару проверяем здесь */
+    fifo_get_watermarks(&high, &low);
+    if (!high || low >= high) {
+        pr_err("wm_low=%u must be below wm_high=%u (>= 1)\n", low, high);
+        return -EINVAL;
+    }
 
+    ret = fifo_init(max_size, m);
     if (ret < 0) {
         pr_err("init failed: %d\n", ret);
         return -ENOMEM;
     }
 
+    ret = kernel_fifo_dev_init();
+    if (ret) {
+        fifo_free();
+        return ret;
+    }
+
+    /* после fifo_init: программа может позвать kfunc сразу после регистрации */
+    ret = fifo_bpf_register();
+    if (ret) {
+        kernel_fifo_dev_exit();
+        fifo_free();
+        return ret;
+    }
+
     pr_info("init\n");
     return 0;
 }
@@ -31,6 +70,7 @@ static int __init kernel_fifo_init(void)
 static void __exit kernel_fifo_exit(void)
 {
     //fifo_clear();
+    kernel_fifo_dev_exit();
     fifo_free();
     pr_info("exit\n");
 }
@@ -40,4 +80,4 @@ module_exit(kernel_fifo_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("you");
-MODULE_DESCRIPTION("kernel_fifo: FIFO via kfifo + module_param_cb");
+MODULE_DESCRIPTION("kernel_fifo: lock-free FIFO/broadcast ring or priority heap + module_param_cb + /dev/kernel_fifo");
@@ -6,22 +6,9 @@
 #include <linux/moduleparam.h>
 #include <linux/mm.h>
 #include <linux/errno.h>
+#include <linux/string.h>
 
-/* внешние функции из fifo_ops.c */
-int fifo_enqueue(int value);
-int fifo_dequeue(int *out);
-int fifo_peek(int *out);
-int fifo_size(void);
-int fifo_available(void);
-int fifo_is_empty(void);
-int fifo_is_full(void);
-void fifo_clear(void);
-
-/* те же коды, что и в fifo_ops.c */
-#define FIFO_OK       0
-#define FIFO_EMPTY   -1
-#define FIFO_FULL    -2
-#define FIFO_INVALID -4
+#include "fifo_ops.h"
 
 /* enqueue (write-only) */
 static int enqueue_set(const char *val, const struct kernel_param *kp)
@@ -49,6 +36,31 @@ static const struct kernel_param_ops enqueue_ops = {
 module_param_cb(enqueue, &enqueue_ops, NULL, 0220);
 MODULE_PARM_DESC(enqueue, "Write-only: enqueue int value");
 
+/* enqueue_prio (write-only): "приоритет значение", только в mode=prio */
+static int enqueue_prio_set(const char *val, const struct kernel_param *kp)
+{
+    int prio, v, ret;
+
+    if (sscanf(val, "%d %d", &prio, &v) != 2)
+        return -EINVAL;
+
+    ret = fifo_enqueue_prio(prio, v);
+    if (ret == FIFO_FULL)
+        return -ENOSPC;
+    if (ret != FIFO_OK)
+        return -EINVAL;
+
+    return 0;
+}
+
+static const struct kernel_param_ops enqueue_prio_ops = {
+    .set = enqueue_prio_set,
+    .get = NULL,
+};
+
+module_param_cb(enqueue_prio, &enqueue_prio_ops, NULL, 0220);
+MODULE_PARM_DESC(enqueue_prio, "Write-only: \"<prio> <value>\", prio 0..255, higher first (mode=prio)");
+
 /* dequeue (read-only): чтение делает pop */
 static int dequeue_get(char *buf, const struct kernel_param *kp)
 {
@@ -157,3 +169,161 @@ static const struct kernel_param_ops clear_ops = {
 
 module_param_cb(clear, &clear_ops, NULL, 0220);
 MODULE_PARM_DESC(clear, "Write-only: clear FIFO");
+
+/* wm_high / wm_low (read-write): пороги партии, см. fifo_set_watermarks */
+static int wm_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned int high, low, v;
+    int ret;
+
+    ret = kstrtouint(val, 10, &v);
+    if (ret)
+        return -EINVAL;
+
+    fifo_get_watermarks(&high, &low);
+    if (kp->arg)
+        high = v;
+    else
+        low = v;
+
+    return fifo_set_watermarks(high, low) == FIFO_OK ? 0 : -EINVAL;
+}
+
+static int wm_get(char *buf, const struct kernel_param *kp)
+{
+    unsigned int high, low;
+
+    fifo_get_watermarks(&high, &low);
+    return scnprintf(buf, PAGE_SIZE, "%u\n", kp->arg ? high : low);
+}
+
+static const struct kernel_param_ops wm_ops = {
+    .set = wm_set,
+    .get = wm_get,
+};
+
+/* arg != NULL отличает high от low */
+module_param_cb(wm_high, &wm_ops, (void *)1, 0644);
+MODULE_PARM_DESC(wm_high, "Announce a batch once size reaches this many elements (default 1)");
+module_param_cb(wm_low, &wm_ops, NULL, 0644);
+MODULE_PARM_DESC(wm_low, "Re-arm after consumers drain to this size, < wm_high (default 0)");
+
+/* batch_us (read-write): таймер партии с первого элемента, 0 — выкл. */
+static int batch_us_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned int us;
+
+    if (kstrtouint(val, 10, &us))
+        return -EINVAL;
+
+    fifo_set_batch_us(us);
+    return 0;
+}
+
+static int batch_us_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%u\n", fifo_get_batch_us());
+}
+
+static const struct kernel_param_ops batch_us_ops = {
+    .set = batch_us_set,
+    .get = batch_us_get,
+};
+
+module_param_cb(batch_us, &batch_us_ops, NULL, 0644);
+MODULE_PARM_DESC(batch_us, "Announce a batch this many us after its first element even below wm_high (0 = off)");
+
+/* notifications (read-only) */
+static int notifications_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%lu\n", fifo_notifications());
+}
+
+static const struct kernel_param_ops notifications_ops = {
+    .get = notifications_get,
+};
+
+module_param_cb(notifications, &notifications_ops, NULL, 0444);
+MODULE_PARM_DESC(notifications, "Read-only: batches announced since load");
+
+/* lag_policy (read-write): block | drop, см. enum fifo_lag_policy */
+static int lag_policy_set(const char *val, const struct kernel_param *kp)
+{
+    if (sysfs_streq(val, "block"))
+        fifo_set_lag_policy(FIFO_LAG_BLOCK);
+    else if (sysfs_streq(val, "drop"))
+        fifo_set_lag_policy(FIFO_LAG_DROP);
+    else
+        return -EINVAL;
+
+    return 0;
+}
+
+static int lag_policy_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%s\n",
+                     fifo_get_lag_policy() == FIFO_LAG_DROP ? "drop" : "block");
+}
+
+static const struct kernel_param_ops lag_policy_ops = {
+    .set = lag_policy_set,
+    .get = lag_policy_get,
+};
+
+module_param_cb(lag_policy, &lag_policy_ops, NULL, 0644);
+MODULE_PARM_DESC(lag_policy, "mode=bcast, ring full: block producers (block) or overwrite under slow readers (drop)");
+
+/* overwritten (read-only) */
+static int overwritten_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%lu\n", fifo_overwritten());
+}
+
+static const struct kernel_param_ops overwritten_ops = {
+    .get = overwritten_get,
+};
+
+module_param_cb(overwritten, &overwritten_ops, NULL, 0444);
+MODULE_PARM_DESC(overwritten, "Read-only: mode=bcast elements overwritten to make room (no readers, or lag_policy=drop)");
+
+/* ttl_ms (read-write): срок годности новых элементов, 0 — выкл. */
+static int ttl_ms_set(const char *val, const struct kernel_param *kp)
+{
+    unsigned int ms;
+
+    if (kstrtouint(val, 10, &ms))
+        return -EINVAL;
+
+    return fifo_set_ttl_ms(ms) == FIFO_OK ? 0 : -EINVAL;
+}
+
+static int ttl_ms_get(char *buf, const struct kernel_param *kp)
+{
+    return scnprintf(buf, PAGE_SIZE, "%u\n", fifo_get_ttl_ms());
+}
+
+static const struct kernel_param_ops ttl_ms_ops = {
+    .set = ttl_ms_set,
+    .get = ttl_ms_get,
+};
+
+module_param_cb(ttl_ms, &ttl_ms_ops, NULL, 0644);
+MODULE_PARM_DESC(ttl_ms, "Drop elements older than this many ms, up to one day (0 = off)");
+
+/* expired_skipped / expired_reaped (read-only): arg != NULL — reaped */
+static int expired_get(char *buf, const struct kernel_param *kp)
+{
+    unsigned long skipped, reaped;
+
+    fifo_expired(&skipped, &reaped);
+    return scnprintf(buf, PAGE_SIZE, "%lu\n", kp->arg ? reaped : skipped);
+}
+
+static const struct kernel_param_ops expired_ops = {
+    .get = expired_get,
+};
+
+module_param_cb(expired_skipped, &expired_ops, NULL, 0444);
+MODULE_PARM_DESC(expired_skipped, "Read-only: expired elements dropped by dequeue/peek");
+module_param_cb(expired_reaped, &expired_ops, (void *)1, 0444);
+MODULE_PARM_DESC(expired_reaped, "Read-only: expired elements dropped by the background reaper");
@@ -0,0 +1,761 @@
+// test/fifo_kunit.c
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/delay.h>
+#include <linux/cpumask.h>
+#include <linux/timekeeping.h>
+#include <linux/random.h>
+
+#include "fifo_ops.h"
+
+/*
+ * Наборы KUnit для src/fifo_ops.c. Собираются в модуль только с
+ * make kunit и выполняются при insmod, отчёт — KTAP в dmesg.
+ *
+ * Очередь у модуля одна, поэтому каждый тест пересоздаёт её с ёмкостью
+ * FIFO_TEST_CAP в режиме FIFO, а после теста возвращает прежние ёмкость
+ * и режим (содержимое при insmod всё равно пустое). Тесты режимов
+ * приоритетов и широковещания пересоздают её сами через fifo_reinit.
+ * Курсор, подключённый в тесте, отключается до выхода из него: после
+ * подключения — только EXPECT, ASSERT оставил бы курсор в списке.
+ */
+#define FIFO_TEST_CAP 8
+
+static int fifo_saved_cap;
+static enum fifo_mode fifo_saved_mode;
+static unsigned int fifo_saved_high, fifo_saved_low, fifo_saved_batch;
+static unsigned int fifo_saved_ttl;
+static enum fifo_lag_policy fifo_saved_policy;
+
+static int fifo_test_init(struct kunit *test)
+{
+    fifo_saved_cap = fifo_size() + fifo_available();
+    fifo_saved_mode = fifo_get_mode();
+    fifo_get_watermarks(&fifo_saved_high, &fifo_saved_low);
+    fifo_saved_batch = fifo_get_batch_us();
+    fifo_saved_ttl = fifo_get_ttl_ms();
+    fifo_saved_policy = fifo_get_lag_policy();
+
+    fifo_free();
+    if (fifo_init(FIFO_TEST_CAP, FIFO_MODE_FIFO) != FIFO_OK)
+        return -ENOMEM;
+
+    /* тесты рассчитаны на пробуждение с первого элемента */
+    fifo_set_watermarks(1, 0);
+    fifo_set_batch_us(0);
+    fifo_set_ttl_ms(0);
+    fifo_set_lag_policy(FIFO_LAG_BLOCK);
+    return 0;
+}
+
+static void fifo_test_exit(struct kunit *test)
+{
+    fifo_free();
+    fifo_set_lag_policy(fifo_saved_policy);
+    fifo_set_ttl_ms(fifo_saved_ttl);
+    fifo_set_batch_us(fifo_saved_batch);
+    fifo_set_watermarks(fifo_saved_high, fifo_saved_low);
+    if (fifo_saved_cap)
+        fifo_init(fifo_saved_cap, fifo_saved_mode);
+}
+
+static void fifo_test_order(struct kunit *test)
+{
+    int i, v;
+
+    for (i = 0; i < 5; i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue(i * 10), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 5);
+    KUNIT_EXPECT_EQ(test, fifo_available(), FIFO_TEST_CAP - 5);
+
+    for (i = 0; i < 5; i++) {
+        KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+        KUNIT_EXPECT_EQ(test, v, i * 10);
+    }
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+}
+
+static void fifo_test_full(struct kunit *test)
+{
+    int i, v;
+
+    for (i = 0; i < FIFO_TEST_CAP; i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue(i), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_is_full(), 1);
+    KUNIT_EXPECT_EQ(test, fifo_available(), 0);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(99), FIFO_FULL);
+    KUNIT_EXPECT_EQ(test, fifo_size(), FIFO_TEST_CAP);
+
+    /* отказ не портит содержимое: голова та же */
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 0);
+}
+
+static void fifo_test_empty(struct kunit *test)
+{
+    int v = 42;
+
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+    KUNIT_EXPECT_EQ(test, fifo_is_full(), 0);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_EMPTY);
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_EMPTY);
+    KUNIT_EXPECT_EQ(test, v, 42);
+}
+
+static void fifo_test_invalid(struct kunit *test)
+{
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(NULL), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_peek(NULL), FIFO_INVALID);
+
+    fifo_free();
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(1), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+    /* повторный free после free безопасен */
+    fifo_free();
+
+    KUNIT_EXPECT_EQ(test, fifo_init(0, FIFO_MODE_FIFO), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_init(-1, FIFO_MODE_FIFO), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_init(8, (enum fifo_mode)7), FIFO_INVALID);
+}
+
+static void fifo_test_rounding(struct kunit *test)
+{
+    /* ёмкость округляется вверх до степени двойки: 5 -> 8 мест */
+    fifo_free();
+    KUNIT_ASSERT_EQ(test, fifo_init(5, FIFO_MODE_FIFO), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_available(), 8);
+}
+
+static void fifo_test_wrap(struct kunit *test)
+{
+    int i, v, next = 0;
+
+    /* голова и хвост многократно проходят через конец кольца */
+    for (i = 0; i < FIFO_TEST_CAP * 50; i++) {
+        KUNIT_ASSERT_EQ(test, fifo_enqueue(i), FIFO_OK);
+        if (i % 3 != 2)
+            continue;
+        while (fifo_size() > 1) {
+            KUNIT_ASSERT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+            KUNIT_ASSERT_EQ(test, v, next++);
+        }
+    }
+    while (fifo_dequeue(&v) == FIFO_OK)
+        KUNIT_EXPECT_EQ(test, v, next++);
+    KUNIT_EXPECT_EQ(test, next, FIFO_TEST_CAP * 50);
+}
+
+static void fifo_test_clear(struct kunit *test)
+{
+    int v;
+
+    fifo_enqueue(1);
+    fifo_enqueue(2);
+    fifo_clear();
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    KUNIT_EXPECT_EQ(test, fifo_available(), FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(3), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 3);
+}
+
+static void fifo_test_bulk(struct kunit *test)
+{
+    int vals[FIFO_TEST_CAP + 4];
+    int i, v;
+
+    for (i = 0; i < ARRAY_SIZE(vals); i++)
+        vals[i] = 100 + i;
+
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk(vals, 0), 0);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk(NULL, 1), FIFO_INVALID);
+
+    /* места на 8: кладётся префикс, дальше — FULL */
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk(vals, 3), 3);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk(vals + 3, ARRAY_SIZE(vals) - 3),
+                    FIFO_TEST_CAP - 3);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk(vals, 1), FIFO_FULL);
+
+    for (i = 0; i < FIFO_TEST_CAP; i++) {
+        KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+        KUNIT_EXPECT_EQ(test, v, 100 + i);
+    }
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+}
+
+static void fifo_test_dequeue_bulk(struct kunit *test)
+{
+    int out[FIFO_TEST_CAP];
+    int i;
+
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 4), FIFO_EMPTY);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(NULL, 1), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 0), 0);
+
+    for (i = 0; i < 5; i++)
+        fifo_enqueue(i);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 3), 3);
+    for (i = 0; i < 3; i++)
+        KUNIT_EXPECT_EQ(test, out[i], i);
+
+    /* просят больше, чем есть: отдаёт остаток */
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, ARRAY_SIZE(out)), 2);
+    KUNIT_EXPECT_EQ(test, out[0], 3);
+    KUNIT_EXPECT_EQ(test, out[1], 4);
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+}
+
+/* другой режим на заданной ёмкости; exit вернёт прежний */
+static void fifo_reinit(struct kunit *test, int cap, enum fifo_mode mode)
+{
+    fifo_free();
+    KUNIT_ASSERT_EQ(test, fifo_init(cap, mode), FIFO_OK);
+    KUNIT_ASSERT_EQ(test, fifo_get_mode(), mode);
+}
+
+static void fifo_test_prio_order(struct kunit *test)
+{
+    static const int prio[] = { 1, 5, 1, 200, 5, 0, 200, 1 };
+    /* по убыванию приоритета, внутри уровня — по приходу (value = индекс) */
+    static const int want[] = { 3, 6, 1, 4, 0, 2, 7, 5 };
+    int i, v;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_PRIO);
+
+    for (i = 0; i < ARRAY_SIZE(prio); i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(prio[i], i), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_is_full(), 1);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(FIFO_PRIO_MAX, 99), FIFO_FULL);
+
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 3);
+    KUNIT_EXPECT_EQ(test, fifo_size(), FIFO_TEST_CAP);
+
+    for (i = 0; i < ARRAY_SIZE(want); i++) {
+        KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+        KUNIT_EXPECT_EQ(test, v, want[i]);
+    }
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_EMPTY);
+}
+
+static void fifo_test_prio_api(struct kunit *test)
+{
+    int out[4], v;
+
+    /* в режиме FIFO приоритет не к чему применить */
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(1, 1), FIFO_INVALID);
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_PRIO);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(-1, 1), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(FIFO_PRIO_MAX + 1, 1), FIFO_INVALID);
+
+    /* обычный enqueue и bulk — уровень FIFO_PRIO_DEFAULT, ниже любого другого */
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(10), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk((int[]){ 11, 12 }, 2), 2);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_prio(1, 20), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 4);
+    KUNIT_EXPECT_EQ(test, fifo_available(), FIFO_TEST_CAP - 4);
+
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 3), 3);
+    KUNIT_EXPECT_EQ(test, out[0], 20);
+    KUNIT_EXPECT_EQ(test, out[1], 10);
+    KUNIT_EXPECT_EQ(test, out[2], 11);
+
+    fifo_clear();
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    KUNIT_EXPECT_EQ(test, fifo_available(), FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_EMPTY);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 4), FIFO_EMPTY);
+}
+
+/*
+ * Куча на много уровней со случайными приоритетами и выборкой вперемешку:
+ * приоритеты не растут, а внутри уровня значения (номера вставки) идут
+ * по возрастанию.
+ */
+#define FIFO_PRIO_TEST_CAP 512
+
+static void fifo_test_prio_heap(struct kunit *test)
+{
+    int last_prio, last_val[4], out[16];
+    int i, j, n, v, seq = 0, taken = 0;
+
+    fifo_reinit(test, FIFO_PRIO_TEST_CAP, FIFO_MODE_PRIO);
+
+    for (i = 0; i < 8; i++) {
+        while (fifo_available()) {
+            /* value кодирует уровень (0..3) и номер вставки */
+            int p = get_random_u32() % 4;
+
+            KUNIT_ASSERT_EQ(test, fifo_enqueue_prio(p * 64, seq * 4 + p), FIFO_OK);
+            seq++;
+        }
+
+        last_prio = FIFO_PRIO_MAX;
+        for (j = 0; j < 4; j++)
+            last_val[j] = -1;
+
+        /* выбираем половину: по одному и пачками */
+        while (fifo_size() > FIFO_PRIO_TEST_CAP / 2) {
+            n = fifo_dequeue_bulk(out, 1 + get_random_u32() % ARRAY_SIZE(out));
+            KUNIT_ASSERT_GT(test, n, 0);
+            for (j = 0; j < n; j++) {
+                v = out[j];
+                KUNIT_ASSERT_LE(test, (v % 4) * 64, last_prio);
+                KUNIT_ASSERT_GT(test, v, last_val[v % 4]);
+                last_prio = (v % 4) * 64;
+                last_val[v % 4] = v;
+                taken++;
+            }
+        }
+    }
+
+    while (fifo_dequeue(&v) == FIFO_OK)
+        taken++;
+    KUNIT_EXPECT_EQ(test, taken, seq);
+}
+
+struct fifo_wait_ctx {
+    struct completion started;
+    struct completion done;
+    int ret;
+    int value;
+};
+
+static int fifo_wait_fn(void *arg)
+{
+    struct fifo_wait_ctx *c = arg;
+    int ret;
+
+    complete(&c->started);
+    ret = fifo_wait_ready();
+    if (!ret)
+        ret = fifo_dequeue(&c->value);
+    WRITE_ONCE(c->ret, ret);
+    complete(&c->done);
+    return 0;
+}
+
+/* читатель спит на пустой очереди, enqueue будит его через irq_work */
+static void fifo_test_wakeup(struct kunit *test)
+{
+    struct fifo_wait_ctx c = { .ret = 1 };
+
+    init_completion(&c.started);
+    init_completion(&c.done);
+    KUNIT_ASSERT_FALSE(test, IS_ERR(kthread_run(fifo_wait_fn, &c, "fifo_wait")));
+
+    wait_for_completion(&c.started);
+    msleep(20);
+    KUNIT_EXPECT_EQ(test, READ_ONCE(c.ret), 1);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(77), FIFO_OK);
+
+    if (!wait_for_completion_timeout(&c.done, HZ)) {
+        KUNIT_FAIL(test, "reader not woken after enqueue");
+        /* c на стеке: fifo_free будит читателя напрямую, дожидаемся его */
+        fifo_free();
+        wait_for_completion(&c.done);
+        return;
+    }
+    KUNIT_EXPECT_EQ(test, c.ret, FIFO_OK);
+    KUNIT_EXPECT_EQ(test, c.value, 77);
+}
+
+/* объявления идут с irq_work: даём ему отработать */
+static unsigned long fifo_notifies_settled(void)
+{
+    msleep(10);
+    return fifo_notifications();
+}
+
+static void fifo_test_watermarks(struct kunit *test)
+{
+    unsigned long n0;
+    int i, v;
+
+    KUNIT_EXPECT_EQ(test, fifo_set_watermarks(0, 0), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_set_watermarks(4, 4), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_set_watermarks(FIFO_TEST_CAP + 1, 0), FIFO_INVALID);
+    KUNIT_ASSERT_EQ(test, fifo_set_watermarks(4, 1), FIFO_OK);
+
+    n0 = fifo_notifies_settled();
+    for (i = 0; i < 3; i++)
+        fifo_enqueue(i);
+    KUNIT_EXPECT_EQ(test, fifo_notifies_settled(), n0);
+    KUNIT_EXPECT_FALSE(test, fifo_batch_ready());
+
+    /* 4-й объявляет партию, дальнейшие до выборки — уже нет */
+    for (i = 3; i < 7; i++)
+        fifo_enqueue(i);
+    KUNIT_EXPECT_EQ(test, fifo_notifies_settled(), n0 + 1);
+    KUNIT_EXPECT_TRUE(test, fifo_batch_ready());
+
+    /* выборка до 2 (> low) не взводит заново: партия всё ещё объявлена */
+    for (i = 0; i < 5; i++)
+        fifo_dequeue(&v);
+    KUNIT_EXPECT_TRUE(test, fifo_batch_ready());
+    fifo_dequeue(&v);
+    KUNIT_EXPECT_FALSE(test, fifo_batch_ready());
+
+    for (i = 0; i < 3; i++)
+        fifo_enqueue(i);
+    KUNIT_EXPECT_EQ(test, fifo_notifies_settled(), n0 + 2);
+}
+
+static void fifo_test_batch_timer(struct kunit *test)
+{
+    unsigned long n0;
+
+    KUNIT_ASSERT_EQ(test, fifo_set_watermarks(FIFO_TEST_CAP, 0), FIFO_OK);
+    fifo_set_batch_us(5000);
+
+    n0 = fifo_notifies_settled();
+    fifo_enqueue(1);
+    fifo_enqueue(2);
+    KUNIT_EXPECT_FALSE(test, fifo_batch_ready());
+    msleep(50);
+    KUNIT_EXPECT_EQ(test, fifo_notifications(), n0 + 1);
+    KUNIT_EXPECT_TRUE(test, fifo_batch_ready());
+}
+
+/* просроченных выбросили потребители или чистильщик — смотря кто успел */
+static unsigned long fifo_expired_total(void)
+{
+    unsigned long skipped, reaped;
+
+    fifo_expired(&skipped, &reaped);
+    return skipped + reaped;
+}
+
+#define FIFO_TEST_TTL_MS 20
+
+static void fifo_test_ttl(struct kunit *test)
+{
+    unsigned long e0 = fifo_expired_total();
+    int i, v;
+
+    KUNIT_EXPECT_EQ(test, fifo_set_ttl_ms(UINT_MAX), FIFO_INVALID);
+    KUNIT_ASSERT_EQ(test, fifo_set_ttl_ms(FIFO_TEST_TTL_MS), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_get_ttl_ms(), FIFO_TEST_TTL_MS);
+
+    for (i = 1; i <= 3; i++)
+        fifo_enqueue(i);
+    msleep(FIFO_TEST_TTL_MS * 3);
+
+    /* срок ставится при enqueue: после ttl = 0 элемент бессрочный */
+    fifo_set_ttl_ms(0);
+    fifo_enqueue(4);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 4);
+    KUNIT_EXPECT_EQ(test, fifo_expired_total(), e0 + 3);
+    KUNIT_EXPECT_EQ(test, fifo_is_empty(), 1);
+}
+
+/* никто не читает: просроченное снимает чистильщик */
+static void fifo_test_ttl_reaper(struct kunit *test)
+{
+    unsigned long skipped, r0, reaped;
+
+    fifo_expired(&skipped, &r0);
+    KUNIT_ASSERT_EQ(test, fifo_set_ttl_ms(FIFO_TEST_TTL_MS), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk((int[]){ 1, 2, 3 }, 3), 3);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 3);
+
+    msleep(FIFO_TEST_TTL_MS * 5);
+    fifo_expired(&skipped, &reaped);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    KUNIT_EXPECT_EQ(test, reaped, r0 + 3);
+}
+
+static void fifo_test_ttl_prio(struct kunit *test)
+{
+    unsigned long e0 = fifo_expired_total();
+    int v;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_PRIO);
+    KUNIT_ASSERT_EQ(test, fifo_set_ttl_ms(FIFO_TEST_TTL_MS), FIFO_OK);
+    fifo_enqueue_prio(FIFO_PRIO_MAX, 1);
+    fifo_enqueue_prio(1, 2);
+    msleep(FIFO_TEST_TTL_MS * 3);
+
+    fifo_set_ttl_ms(0);
+    fifo_enqueue_prio(0, 3);
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 3);
+    KUNIT_EXPECT_EQ(test, fifo_expired_total(), e0 + 2);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 1);
+}
+
+/* каждый подписчик видит все элементы; место освобождает самый медленный */
+static void fifo_test_bcast(struct kunit *test)
+{
+    struct fifo_cursor a = {}, b = {};
+    int out[4], v;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_BCAST);
+    KUNIT_ASSERT_EQ(test, fifo_cursor_attach(&a), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_cursor_attach(&b), FIFO_OK);
+
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk((int[]){ 1, 2, 3 }, 3), 3);
+    KUNIT_EXPECT_TRUE(test, fifo_cursor_ready(&a));
+
+    /* забрать у всех сразу нельзя, посмотреть — можно */
+    KUNIT_EXPECT_EQ(test, fifo_dequeue(&v), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_dequeue_bulk(out, 4), FIFO_INVALID);
+    KUNIT_EXPECT_EQ(test, fifo_peek(&v), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, v, 1);
+
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&a, out, 4), 3);
+    KUNIT_EXPECT_EQ(test, out[0], 1);
+    KUNIT_EXPECT_EQ(test, out[2], 3);
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&a, out, 4), FIFO_EMPTY);
+    KUNIT_EXPECT_FALSE(test, fifo_cursor_ready(&a));
+    KUNIT_EXPECT_EQ(test, fifo_size(), 3);
+
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&b, out, 2), 2);
+    KUNIT_EXPECT_EQ(test, out[1], 2);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 1);
+
+    /* ушёл последний отставший — его хвост больше никого не держит */
+    fifo_cursor_detach(&b);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    KUNIT_EXPECT_EQ(test, a.lost, 0UL);
+    fifo_cursor_detach(&a);
+
+    /* в других режимах курсоров нет */
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_FIFO);
+    KUNIT_EXPECT_EQ(test, fifo_cursor_attach(&a), FIFO_INVALID);
+}
+
+/* FIFO_LAG_BLOCK: отставший держит кольцо, производитель получает FULL */
+static void fifo_test_bcast_block(struct kunit *test)
+{
+    struct fifo_cursor c = {};
+    int out[FIFO_TEST_CAP], i;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_BCAST);
+    KUNIT_ASSERT_EQ(test, fifo_cursor_attach(&c), FIFO_OK);
+
+    for (i = 0; i < FIFO_TEST_CAP; i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue(i), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue(99), FIFO_FULL);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk((int[]){ 98, 99 }, 2), FIFO_FULL);
+
+    /* mmap-подписчик подтверждает прочитанное без копирования */
+    KUNIT_EXPECT_EQ(test, fifo_cursor_advance(&c, 3), 3);
+    KUNIT_EXPECT_EQ(test, fifo_available(), 3);
+    KUNIT_EXPECT_EQ(test, fifo_enqueue_bulk((int[]){ 8, 9, 10, 11 }, 4), 3);
+
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&c, out, FIFO_TEST_CAP), FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, out[0], 3);
+    KUNIT_EXPECT_EQ(test, out[FIFO_TEST_CAP - 1], 10);
+    KUNIT_EXPECT_EQ(test, fifo_cursor_advance(&c, 1), 0);
+    KUNIT_EXPECT_EQ(test, c.lost, 0UL);
+    fifo_cursor_detach(&c);
+}
+
+/* FIFO_LAG_DROP: затирается старейшее, отставший узнаёт об этом из lost */
+static void fifo_test_bcast_drop(struct kunit *test)
+{
+    unsigned long o0 = fifo_overwritten();
+    struct fifo_cursor c = {};
+    int out[FIFO_TEST_CAP], i;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_BCAST);
+    fifo_set_lag_policy(FIFO_LAG_DROP);
+    KUNIT_ASSERT_EQ(test, fifo_cursor_attach(&c), FIFO_OK);
+
+    for (i = 0; i < FIFO_TEST_CAP + 4; i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue(i), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_overwritten(), o0 + 4);
+    KUNIT_EXPECT_EQ(test, fifo_size(), FIFO_TEST_CAP);
+
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&c, out, FIFO_TEST_CAP), FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, out[0], 4);
+    KUNIT_EXPECT_EQ(test, out[FIFO_TEST_CAP - 1], FIFO_TEST_CAP + 3);
+    KUNIT_EXPECT_EQ(test, c.lost, 4UL);
+    fifo_cursor_detach(&c);
+}
+
+/* без подписчиков кольцо хранит последние cap, новый подписчик их видит */
+static void fifo_test_bcast_history(struct kunit *test)
+{
+    struct fifo_cursor c = {};
+    int out[FIFO_TEST_CAP], i;
+
+    fifo_reinit(test, FIFO_TEST_CAP, FIFO_MODE_BCAST);
+    for (i = 0; i < FIFO_TEST_CAP * 2; i++)
+        KUNIT_EXPECT_EQ(test, fifo_enqueue(i), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_size(), FIFO_TEST_CAP);
+
+    KUNIT_ASSERT_EQ(test, fifo_cursor_attach(&c), FIFO_OK);
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&c, out, FIFO_TEST_CAP), FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, out[0], FIFO_TEST_CAP);
+    KUNIT_EXPECT_EQ(test, c.lost, 0UL);
+
+    /* clear — для подписчика тоже потеря */
+    fifo_enqueue_bulk((int[]){ 1, 2 }, 2);
+    fifo_clear();
+    KUNIT_EXPECT_EQ(test, fifo_cursor_read(&c, out, 1), FIFO_EMPTY);
+    KUNIT_EXPECT_EQ(test, c.lost, 2UL);
+    fifo_cursor_detach(&c);
+}
+
+/* замеры: ns/op в одном потоке и под конкуренцией за спинлок очереди */
+#define FIFO_BENCH_OPS     200000
+#define FIFO_BENCH_THREADS 8
+
+static void fifo_bench_single(struct kunit *test)
+{
+    unsigned int i, fails = 0;
+    u64 t0, ns;
+    int v;
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < FIFO_BENCH_OPS; i++) {
+        if (fifo_enqueue(i) != FIFO_OK || fifo_dequeue(&v) != FIFO_OK)
+            fails++;
+    }
+    ns = ktime_get_ns() - t0;
+
+    KUNIT_EXPECT_EQ(test, fails, 0u);
+    kunit_info(test, "enqueue+dequeue %llu ns/pair\n",
+               div_u64(ns, FIFO_BENCH_OPS));
+}
+
+/* куча, заполненная наполовину: вставка и выборка идут через ~log4(n) уровней */
+static void fifo_bench_prio(struct kunit *test)
+{
+    unsigned int i, fails = 0;
+    u64 t0, ns;
+    int v;
+
+    fifo_reinit(test, FIFO_PRIO_TEST_CAP, FIFO_MODE_PRIO);
+    for (i = 0; i < FIFO_PRIO_TEST_CAP / 2; i++)
+        fifo_enqueue_prio(i % (FIFO_PRIO_MAX + 1), i);
+
+    t0 = ktime_get_ns();
+    for (i = 0; i < FIFO_BENCH_OPS; i++) {
+        if (fifo_enqueue_prio(i % (FIFO_PRIO_MAX + 1), i) != FIFO_OK ||
+            fifo_dequeue(&v) != FIFO_OK)
+            fails++;
+    }
+    ns = ktime_get_ns() - t0;
+
+    KUNIT_EXPECT_EQ(test, fails, 0u);
+    kunit_info(test, "prio enqueue+dequeue at %u elems: %llu ns/pair\n",
+               FIFO_PRIO_TEST_CAP / 2, div_u64(ns, FIFO_BENCH_OPS));
+}
+
+struct fifo_bench_ctx {
+    struct completion *go;
+    struct completion done;
+    unsigned int ops;
+    unsigned int fails;
+};
+
+/*
+ * Каждый поток кладёт элемент и сразу забирает один: в очереди не больше
+ * элементов, чем потоков (<= FIFO_TEST_CAP), так что FULL — ошибка.
+ * EMPTY бывает на миг: голову зарезервировал другой поток, но ещё не
+ * опубликовал (его прервали) — тогда пробуем снова.
+ */
+static int fifo_bench_fn(void *arg)
+{
+    struct fifo_bench_ctx *c = arg;
+    unsigned int i;
+    int v, ret;
+
+    wait_for_completion(c->go);
+    for (i = 0; i < c->ops; i++) {
+        if (fifo_enqueue(i) != FIFO_OK) {
+            c->fails++;
+            continue;
+        }
+        while ((ret = fifo_dequeue(&v)) == FIFO_EMPTY)
+            cpu_relax();
+        if (ret != FIFO_OK)
+            c->fails++;
+    }
+    complete(&c->done);
+    return 0;
+}
+
+static void fifo_bench_contended(struct kunit *test)
+{
+    unsigned int nr = clamp_t(unsigned int, num_online_cpus(), 2,
+                              min(FIFO_BENCH_THREADS, FIFO_TEST_CAP));
+    unsigned int per = FIFO_BENCH_OPS / nr, i, started, fails = 0;
+    struct fifo_bench_ctx *ctx;
+    DECLARE_COMPLETION_ONSTACK(go);
+    u64 t0, ns;
+
+    ctx = kunit_kcalloc(test, nr, sizeof(*ctx), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, ctx);
+
+    for (started = 0; started < nr; started++) {
+        struct fifo_bench_ctx *c = &ctx[started];
+
+        c->go = &go;
+        c->ops = per;
+        init_completion(&c->done);
+        if (IS_ERR(kthread_run(fifo_bench_fn, c, "fifo_bench/%u", started)))
+            break;
+    }
+
+    /* go на стеке: запущенные потоки дожидаемся при любом исходе */
+    t0 = ktime_get_ns();
+    complete_all(&go);
+    for (i = 0; i < started; i++) {
+        wait_for_completion(&ctx[i].done);
+        fails += ctx[i].fails;
+    }
+    ns = ktime_get_ns() - t0;
+
+    KUNIT_ASSERT_EQ(test, started, nr);
+    KUNIT_EXPECT_EQ(test, fails, 0u);
+    KUNIT_EXPECT_EQ(test, fifo_size(), 0);
+    kunit_info(test, "%u threads: %llu ns per enqueue+dequeue pair (wall / total)\n",
+               nr, div_u64(ns, per * nr));
+}
+
+static struct kunit_case fifo_test_cases[] = {
+    KUNIT_CASE(fifo_test_order),
+    KUNIT_CASE(fifo_test_full),
+    KUNIT_CASE(fifo_test_empty),
+    KUNIT_CASE(fifo_test_invalid),
+    KUNIT_CASE(fifo_test_rounding),
+    KUNIT_CASE(fifo_test_wrap),
+    KUNIT_CASE(fifo_test_clear),
+    KUNIT_CASE(fifo_test_bulk),
+    KUNIT_CASE(fifo_test_dequeue_bulk),
+    KUNIT_CASE(fifo_test_prio_order),
+    KUNIT_CASE(fifo_test_prio_api),
+    KUNIT_CASE(fifo_test_prio_heap),
+    KUNIT_CASE(fifo_test_wakeup),
+    KUNIT_CASE(fifo_test_watermarks),
+    KUNIT_CASE(fifo_test_batch_timer),
+    KUNIT_CASE(fifo_test_ttl),
+    KUNIT_CASE(fifo_test_ttl_reaper),
+    KUNIT_CASE(fifo_test_ttl_prio),
+    KUNIT_CASE(fifo_test_bcast),
+    KUNIT_CASE(fifo_test_bcast_block),
+    KUNIT_CASE(fifo_test_bcast_drop),
+    KUNIT_CASE(fifo_test_bcast_history),
+    KUNIT_CASE(fifo_bench_single),
+    KUNIT_CASE(fifo_bench_prio),
+    KUNIT_CASE(fifo_bench_contended),
+    {}
+};
+
+static struct kunit_suite fifo_test_suite = {
+    .name = "kernel_fifo",
+    .init = fifo_test_init,
+    .exit = fifo_test_exit,
+    .test_cases = fifo_test_cases,
+};
+
+kunit_test_suite(fifo_test_suite);